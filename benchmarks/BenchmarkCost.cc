@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: Apache-2.0
+//
+// Copyright (c) 2023 Yago Lizarribar
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include <boost/program_options.hpp>
+#include <Eigen/Dense>
+
+#include "../include/Receiver.hh"
+#include "../include/TdoaLocator.hh"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+namespace po = boost::program_options;
+
+struct options {
+    int fixes = 200;
+    double sigma = 0.05;
+    unsigned int seed = 42;
+};
+
+int parse_commandline(int argc, char **argv, options &opt) {
+
+    po::options_description desc("BenchmarkCost. Compares the NLLS cost functions against the number of receivers.\n"
+                                 "Allowed options:");
+    desc.add_options()
+            ("help,h", "Show this message")
+            ("fixes,f", po::value<int>(&opt.fixes)->default_value(200),
+             "Number of fixes solved for each receiver count. Default: 200")
+            ("sigma,s", po::value<double>(&opt.sigma)->default_value(0.05),
+             "Standard deviation of the TOA noise. Default: 0.05")
+            ("seed", po::value<unsigned int>(&opt.seed)->default_value(42),
+             "Seed for the random scenarios. Default: 42");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    // Help text
+    if (vm.count("help")) {
+        cout << desc << "\n";
+        return 1;
+    }
+
+    return 0;
+}
+
+// Average time per fix (µs) of the non-linear optimization with the given cost model
+double timeModel(const std::vector<std::vector<tdoapp::Receiver>> &scenarios,
+                 const std::vector<Eigen::Vector2d> &guesses,
+                 tdoapp::CostModel model) {
+    const auto start{std::chrono::high_resolution_clock::now()};
+    for (size_t i = 0; i < scenarios.size(); i++) {
+        auto result = tdoapp::nonlinearOptimization(scenarios[i], guesses[i], model);
+        if (!result.allFinite()) {
+            cerr << "Non-finite result in scenario " << i << endl;
+        }
+    }
+    const auto end{std::chrono::high_resolution_clock::now()};
+
+    return std::chrono::duration<double, std::micro>(end - start).count() / static_cast<double>(scenarios.size());
+}
+
+int main(int argc, char **argv) {
+    // Command line options
+    auto opt = std::make_unique<options>();
+    if (parse_commandline(argc, argv, *opt)) {
+        return 1;
+    }
+
+    std::mt19937 rng{opt->seed};
+    std::uniform_real_distribution<double> area{-10.0, 10.0};
+    std::normal_distribution<double> noise{0.0, opt->sigma};
+
+    cout << "receivers,autodiff_us,analytic_us,speedup,reference_us,reference_speedup,reference_deviation" << endl;
+    for (int R: {4, 6, 8, 12, 16, 20, 24, 32, 48, 64, 100}) {
+        // Random static deployment and emitters
+        std::vector<std::vector<tdoapp::Receiver>> scenarios;
+        std::vector<Eigen::Vector2d> guesses;
+        for (int i = 0; i < opt->fixes; i++) {
+            Eigen::Vector2d emitter{area(rng), area(rng)};
+            std::vector<tdoapp::Receiver> receivers;
+            for (int j = 0; j < R; j++) {
+                Eigen::Vector2d s{area(rng), area(rng)};
+                receivers.emplace_back(s[0], s[1], (emitter - s).norm() + noise(rng));
+            }
+            guesses.push_back(tdoapp::initialGuess(receivers));
+            scenarios.push_back(std::move(receivers));
+        }
+
+        auto autodiff = timeModel(scenarios, guesses, tdoapp::CostModel::AutoDiff);
+        auto analytic = timeModel(scenarios, guesses, tdoapp::CostModel::Analytic);
+        auto reference = timeModel(scenarios, guesses, tdoapp::CostModel::Reference);
+
+        // Largest distance between the all-pairs and the whitened reference solutions
+        double deviation = 0.0;
+        for (size_t i = 0; i < scenarios.size(); i++) {
+            auto pairs = tdoapp::nonlinearOptimization(scenarios[i], guesses[i], tdoapp::CostModel::Analytic);
+            auto whitened = tdoapp::nonlinearOptimization(scenarios[i], guesses[i], tdoapp::CostModel::Reference);
+            deviation = std::max(deviation, (pairs - whitened).norm());
+        }
+
+        cout << std::fixed << std::setprecision(3)
+             << R << "," << autodiff << "," << analytic << "," << autodiff / analytic << ","
+             << reference << "," << analytic / reference << "," << std::scientific << std::setprecision(2)
+             << deviation << endl;
+    }
+
+    return 0;
+}
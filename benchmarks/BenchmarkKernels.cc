@@ -0,0 +1,272 @@
+// SPDX-License-Identifier: Apache-2.0
+//
+// Copyright (c) 2023 Yago Lizarribar
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include <benchmark/benchmark.h>
+#include <Eigen/Dense>
+
+#include "../include/ExactBatch.hh"
+#include "../include/GridInitializer.hh"
+#include "../include/Receiver.hh"
+#include "../include/TdoaGeometry.hh"
+#include "../include/TdoaIndex.hh"
+#include "../include/TdoaLocator.hh"
+#include "../include/ToaFile.hh"
+
+// Microbenchmarks of the solver kernels. Every benchmark takes {receivers, noise} as arguments, with the noise as
+// the standard deviation of the TOAs in thousandths of a distance unit, and cycles through a pool of seeded scenarios.
+// The output is JSON by default; pass --benchmark_format=console for a table.
+
+namespace {
+    constexpr size_t kScenarios = 128;
+
+    struct Scenario {
+        std::vector<tdoapp::Receiver> receivers;
+        Eigen::Vector2d emitter;
+        Eigen::Vector2d guess; // initialGuess of the receivers, start of the non-linear optimization
+    };
+
+    // Random deployment and emitter in [-10, 10]^2, seeded by the arguments so every run sees the same data
+    std::vector<Scenario> makeScenarios(int R, int noise) {
+        std::mt19937 rng{static_cast<unsigned int>(1000 * R + noise)};
+        std::uniform_real_distribution<double> area{-10.0, 10.0};
+        std::normal_distribution<double> toaNoise{0.0, noise * 1e-3};
+
+        // ExactFrame::solve warns about ambiguous fixes on std::cerr; keep it out of the output
+        auto *cerr = std::cerr.rdbuf();
+        std::ostringstream discarded;
+        std::cerr.rdbuf(discarded.rdbuf());
+
+        std::vector<Scenario> scenarios;
+        while (scenarios.size() < kScenarios) {
+            Scenario scenario;
+            scenario.emitter = {area(rng), area(rng)};
+            for (int j = 0; j < R; j++) {
+                Eigen::Vector2d s{area(rng), area(rng)};
+                scenario.receivers.emplace_back(s[0], s[1], (scenario.emitter - s).norm() + toaNoise(rng));
+            }
+
+            // Only geometries with a real, unambiguous fix, so the exact solver never throws while timed
+            try {
+                scenario.guess = tdoapp::initialGuess(scenario.receivers);
+            } catch (const std::runtime_error &) {
+                continue;
+            }
+            if (!scenario.guess.allFinite() || discarded.tellp() > 0) {
+                discarded.str("");
+                continue;
+            }
+            scenarios.push_back(std::move(scenario));
+        }
+
+        std::cerr.rdbuf(cerr);
+        return scenarios;
+    }
+
+    const std::vector<Scenario> &scenarios(const benchmark::State &state) {
+        static std::map<std::pair<int, int>, std::vector<Scenario>> cache;
+        auto key = std::make_pair(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+        auto it = cache.find(key);
+        if (it == cache.end()) {
+            it = cache.emplace(key, makeScenarios(key.first, key.second)).first;
+        }
+        return it->second;
+    }
+
+    template<typename Kernel>
+    void run(benchmark::State &state, Kernel &&kernel) {
+        const auto &pool = scenarios(state);
+        size_t i = 0;
+        for (auto _: state) {
+            benchmark::DoNotOptimize(kernel(pool[i]));
+            i = (i + 1) % pool.size();
+        }
+        state.counters["receivers"] = static_cast<double>(state.range(0));
+        state.counters["sigma"] = static_cast<double>(state.range(1)) * 1e-3;
+        state.counters["fixes_per_s"] = benchmark::Counter(static_cast<double>(state.iterations()),
+                                                           benchmark::Counter::kIsRate);
+    }
+
+    void BM_ExactTDOA(benchmark::State &state) {
+        run(state, [](const Scenario &s) { return tdoapp::exactTDOA(s.receivers); });
+    }
+
+    // The whole scenario pool per iteration, at the instruction set given by the third argument
+    void BM_ExactBatch(benchmark::State &state) {
+        const auto level = static_cast<tdoapp::SimdLevel>(state.range(2));
+        if (level > tdoapp::simdLevel()) {
+            state.SkipWithError("Instruction set not available");
+            return;
+        }
+
+        tdoapp::ExactBatchColumns columns;
+        for (const auto &s: scenarios(state)) {
+            columns.push_back(s.receivers[0], s.receivers[1], s.receivers[2]);
+        }
+        tdoapp::ExactBatchResult result;
+        for (auto _: state) {
+            tdoapp::exactBatch(columns, result, true, level);
+            benchmark::DoNotOptimize(result.x.data());
+            benchmark::ClobberMemory();
+        }
+        state.SetLabel(tdoapp::toString(level));
+        state.counters["receivers"] = static_cast<double>(state.range(0));
+        state.counters["sigma"] = static_cast<double>(state.range(1)) * 1e-3;
+        state.counters["fixes_per_s"] = benchmark::Counter(static_cast<double>(state.iterations() * columns.size()),
+                                                           benchmark::Counter::kIsRate);
+    }
+
+    // Time and accuracy of each linear LS factorization (third argument, tdoapp::LinearSolver). Accuracy is the mean
+    // distance to the true emitter and the largest distance to the SVD solution over the scenario pool
+    void BM_LinearTDOA(benchmark::State &state) {
+        const auto solver = static_cast<tdoapp::LinearSolver>(state.range(2));
+        run(state, [solver](const Scenario &s) { return tdoapp::linearTDOA(s.receivers, solver); });
+
+        double error = 0.0, deviation = 0.0;
+        for (const auto &s: scenarios(state)) {
+            const Eigen::Vector2d position = tdoapp::linearTDOA(s.receivers, solver);
+            error += (position - s.emitter).norm();
+            const Eigen::Vector2d reference = tdoapp::linearTDOA(s.receivers, tdoapp::LinearSolver::Svd);
+            deviation = std::max(deviation, (position - reference).norm());
+        }
+        state.counters["error"] = error / static_cast<double>(scenarios(state).size());
+        state.counters["deviation"] = deviation;
+    }
+
+    void BM_InitialGuess(benchmark::State &state) {
+        run(state, [](const Scenario &s) { return tdoapp::initialGuess(s.receivers); });
+    }
+
+    void BM_NonlinearCeres(benchmark::State &state) {
+        run(state, [](const Scenario &s) {
+            return tdoapp::nonlinearOptimization(s.receivers, s.guess, tdoapp::NlsBackend::Ceres);
+        });
+    }
+
+    void BM_NonlinearLM(benchmark::State &state) {
+        run(state, [](const Scenario &s) {
+            return tdoapp::nonlinearOptimization(s.receivers, s.guess, tdoapp::NlsBackend::LevenbergMarquardt);
+        });
+    }
+
+    // Grid multi-start with the LM backend. Besides the time, compares over the scenario pool the mean LM iterations
+    // per fix (all starts added up) and the fraction of fixes farther than one unit from the emitter against a
+    // single start from initialGuess
+    void BM_MultiStart(benchmark::State &state) {
+        tdoapp::GridOptions options;
+        options.backend = tdoapp::NlsBackend::LevenbergMarquardt;
+        run(state, [&options](const Scenario &s) { return tdoapp::multiStartSolution(s.receivers, options); });
+
+        double iterations = 0.0, baselineIterations = 0.0, misses = 0.0, baselineMisses = 0.0;
+        for (const auto &s: scenarios(state)) {
+            const auto grid = tdoapp::multiStartSolution(s.receivers, options);
+            const auto single = tdoapp::nonlinearSolution(s.receivers, s.guess, options.backend);
+            iterations += grid.iterations;
+            baselineIterations += single.iterations;
+            misses += (grid.position - s.emitter).norm() > 1.0;
+            baselineMisses += (single.position - s.emitter).norm() > 1.0;
+        }
+        const auto count = static_cast<double>(scenarios(state).size());
+        state.counters["iterations"] = iterations / count;
+        state.counters["iterations_guess"] = baselineIterations / count;
+        state.counters["misses"] = misses / count;
+        state.counters["misses_guess"] = baselineMisses / count;
+    }
+
+    // Warm start lookups of an index over the deployment of the first scenario, with the emitters and noise of the
+    // whole pool. Reports the build time and size of the index, the mean distance of the starts to the emitters and
+    // the LM iterations from them against starting from initialGuess
+    void BM_IndexWarmStart(benchmark::State &state) {
+        const auto &pool = scenarios(state);
+        const auto receivers = pool.front().receivers;
+        std::mt19937 rng{static_cast<unsigned int>(state.range(1))};
+        std::normal_distribution<double> toaNoise{0.0, static_cast<double>(state.range(1)) * 1e-3};
+        tdoapp::ToaMatrix toas(static_cast<Eigen::Index>(pool.size()), static_cast<Eigen::Index>(receivers.size()));
+        for (size_t k = 0; k < pool.size(); k++) {
+            for (size_t i = 0; i < receivers.size(); i++) {
+                toas(k, i) = (pool[k].emitter - receivers[i].position()).norm() + toaNoise(rng);
+            }
+        }
+
+        const tdoapp::TdoaIndex index{receivers};
+        size_t k = 0;
+        for (auto _: state) {
+            benchmark::DoNotOptimize(index.warmStart(toas.row(static_cast<Eigen::Index>(k)).transpose()));
+            k = (k + 1) % pool.size();
+        }
+
+        const tdoapp::TdoaGeometry geometry{receivers};
+        double error = 0.0, iterations = 0.0, baselineIterations = 0.0;
+        for (Eigen::Index row = 0; row < toas.rows(); row++) {
+            const Eigen::VectorXd timestamps = toas.row(row).transpose();
+            const Eigen::Vector2d start = index.warmStart(timestamps);
+            error += (start - pool[row].emitter).norm();
+            const auto lm = tdoapp::NlsBackend::LevenbergMarquardt;
+            iterations += geometry.nonlinearSolution(timestamps, start, lm).iterations;
+            const auto guess = geometry.initialSolution(timestamps);
+            if (guess.usable()) {
+                baselineIterations += geometry.nonlinearSolution(timestamps, guess.position, lm).iterations;
+            }
+        }
+        const auto count = static_cast<double>(pool.size());
+        state.counters["receivers"] = static_cast<double>(state.range(0));
+        state.counters["sigma"] = static_cast<double>(state.range(1)) * 1e-3;
+        state.counters["fixes_per_s"] = benchmark::Counter(static_cast<double>(state.iterations()),
+                                                           benchmark::Counter::kIsRate);
+        state.counters["build_s"] = index.buildSeconds();
+        state.counters["memory_bytes"] = static_cast<double>(index.memoryBytes());
+        state.counters["error"] = error / count;
+        state.counters["iterations"] = iterations / count;
+        state.counters["iterations_guess"] = baselineIterations / count;
+    }
+
+    const std::vector<int64_t> kNoise = {0, 10, 100};
+
+    template<int From>
+    void receiverSweep(benchmark::internal::Benchmark *b) {
+        for (int R: {3, 4, 5, 8, 12, 16, 24, 32, 48, 64}) {
+            if (R < From) {
+                continue;
+            }
+            for (auto noise: kNoise) {
+                b->Args({R, noise});
+            }
+        }
+        b->ArgNames({"receivers", "noise"});
+    }
+}
+
+BENCHMARK(BM_ExactTDOA)->ArgsProduct({{3}, kNoise})->ArgNames({"receivers", "noise"});
+BENCHMARK(BM_ExactBatch)->ArgsProduct({{3}, kNoise, {0, 1, 2}})->ArgNames({"receivers", "noise", "simd"});
+BENCHMARK(BM_LinearTDOA)->ArgsProduct({{4, 5, 8, 16, 64}, kNoise, {0, 1, 2, 3}})
+        ->ArgNames({"receivers", "noise", "solver"});
+BENCHMARK(BM_InitialGuess)->Apply(receiverSweep<3>);
+BENCHMARK(BM_NonlinearCeres)->Apply(receiverSweep<3>)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_NonlinearLM)->Apply(receiverSweep<3>)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_IndexWarmStart)->ArgsProduct({{4, 8, 16, 64}, kNoise})->ArgNames({"receivers", "noise"});
+BENCHMARK(BM_MultiStart)->ArgsProduct({{4, 5, 8, 16, 64}, {0, 100, 1000}})->ArgNames({"receivers", "noise"})
+        ->Unit(benchmark::kMicrosecond);
+
+int main(int argc, char **argv) {
+    // JSON unless another format is requested: later flags override earlier ones
+    std::vector<char *> args{argv, argv + argc};
+    char json[] = "--benchmark_format=json";
+    args.insert(args.begin() + 1, json);
+    int count = static_cast<int>(args.size());
+
+    benchmark::Initialize(&count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(count, args.data())) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -6,13 +6,16 @@
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <optional>
 
 #include <boost/program_options.hpp>
 #include <Eigen/Dense>
 #include <nlohmann/json.hpp>
 
 #include "../include/Receiver.hh"
+#include "../include/SlidingWindowLocator.hh"
 #include "../include/TdoaLocator.hh"
+#include "../include/ToaFile.hh"
 
 using std::cout;
 using std::cerr;
@@ -26,6 +29,8 @@ struct options {
     int optimization_level = 1;
     int window_size = 1;
     int precision = 1;
+    tdoapp::WindowStatistic statistic = tdoapp::WindowStatistic::Mean;
+    double trim_fraction = 0.1;
     std::string receiver_file;
     std::string output;
 };
@@ -43,11 +48,15 @@ int parse_commandline(int argc, char **argv, options &opt) {
     po::options_description desc("TdoaCLI. Command-Line utility to solve TDOA problems.\nAllowed options:");
     desc.add_options()
             ("help,h", "Show this message")
-            ("receiver,r", po::value<std::string>(), "JSON file with receiver positions & timestamps")
+            ("receiver,r", po::value<std::string>(), "JSON or binary TOA file with receiver positions & timestamps")
             ("method,m", po::value<int>(&opt.optimization_level)->default_value(1),
              "Method to use. Options: (1: linear, 2: nonlinear). Default: 1")
             ("window-size,w", po::value<int>(&opt.window_size)->default_value(1),
              "Size of the averaging window. Default: 1")
+            ("statistic,s", po::value<std::string>()->default_value("mean"),
+             "How the TOAs of the window are combined. Options: (mean; median; trimmed). Default: mean")
+            ("trim-fraction,t", po::value<double>(&opt.trim_fraction)->default_value(0.1),
+             "Fraction of the window dropped at each end by the trimmed mean. Default: 0.1")
             ("precision,p", po::value<int>(&opt.precision)->default_value(1),
              "Size of the averaging window. Options: (0: ns; 1: µs; 2: ms). Default: 1 (µs).")
             ("output,o", po::value<std::string>(&opt.output)->default_value("stdout"),
@@ -84,6 +93,19 @@ int parse_commandline(int argc, char **argv, options &opt) {
         cout << "Window size was not set. Window size of 10 will be used" << endl;
     }
 
+    // Get the window statistic
+    auto statistic = vm["statistic"].as<std::string>();
+    if (statistic == "mean") {
+        opt.statistic = tdoapp::WindowStatistic::Mean;
+    } else if (statistic == "median") {
+        opt.statistic = tdoapp::WindowStatistic::Median;
+    } else if (statistic == "trimmed") {
+        opt.statistic = tdoapp::WindowStatistic::TrimmedMean;
+    } else {
+        cerr << "Unsupported window statistic: " << statistic << ". Options are: mean, median, trimmed" << endl;
+        return 1;
+    }
+
     // Get the time precision
     if (vm.count("precision")) {
         auto precision = vm["precision"].as<int>();
@@ -114,15 +136,10 @@ int parse_commandline(int argc, char **argv, options &opt) {
     return 0;
 }
 
-int main(int argc, char **argv) {
-    // Command line options
-    auto opt = std::make_unique<options>();
-    if (parse_commandline(argc, argv, *opt)) {
-        return 1;
-    }
-
+// Benchmark layout: {"receivers": {"0": [x, y], ...}, "measurements": [{"0": t, ...}]}
+int read_json(const std::string &filename, std::vector<tdoapp::Receiver> &receiver_array, tdoapp::ToaMatrix &toas) {
     // Get receivers information
-    std::ifstream ifs(opt->receiver_file);
+    std::ifstream ifs(filename);
     if (!ifs.is_open()) {
         cerr << "Error: Could not open receiver file" << endl;
         return 1;
@@ -132,7 +149,6 @@ int main(int argc, char **argv) {
     auto receivers = json::parse(ifs);
 
     // For this benchmark, we assume static receivers
-    std::vector<tdoapp::Receiver> receiver_array;
     if (!receivers.contains("receivers")) {
         cerr << "Error parsing receiver file. Could not find receivers field" << endl;
         return 1;
@@ -150,24 +166,14 @@ int main(int argc, char **argv) {
 
     // We get the number of receivers for later verification
     auto R = receiver_array.size();
-    auto W = opt->window_size;
 
-    // We get now all measurement members
-    unsigned  long N; // Number of total measurements
-    if (receivers.contains("measurements")) {
-        N = receivers["measurements"].size();
-        if (N < W) {
-            cerr << "Not enough measurements: " << N << " for the selected window size "
-                 << W << endl;
-            return 1;
-        }
-    } else {
+    if (!receivers.contains("measurements")) {
         cerr << "Error parsing receiver file. Could not find TOA values" << endl;
         return 1;
     }
 
     // Read the first all measurements and insert them in matrix
-    auto toas = Eigen::MatrixXd(N,R);
+    toas.resize(receivers["measurements"].size(), R);
     int row = 0;
     for (const auto &measurement: receivers["measurements"]) {
         // Verify that the number of TOA values is the same as receivers
@@ -186,29 +192,71 @@ int main(int argc, char **argv) {
         row += 1;
     }
 
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    // Command line options
+    auto opt = std::make_unique<options>();
+    if (parse_commandline(argc, argv, *opt)) {
+        return 1;
+    }
+
+    // Binary TOA files are mapped and read in place, JSON ones are parsed into a matrix
+    std::vector<tdoapp::Receiver> receiver_array;
+    std::optional<tdoapp::ToaFile> toa_file;
+    tdoapp::ToaMatrix json_toas;
+    if (tdoapp::isToaFile(opt->receiver_file)) {
+        try {
+            toa_file.emplace(opt->receiver_file);
+        } catch (const std::exception &e) {
+            cerr << "Error reading binary receiver file: " << e.what() << endl;
+            return 1;
+        }
+        receiver_array = toa_file->receivers();
+    } else if (read_json(opt->receiver_file, receiver_array, json_toas)) {
+        return 1;
+    }
+    const Eigen::Map<const tdoapp::ToaMatrix> toas =
+            toa_file ? toa_file->toas()
+                     : Eigen::Map<const tdoapp::ToaMatrix>(json_toas.data(), json_toas.rows(), json_toas.cols());
+
+    // We get now all measurement members
+    auto W = opt->window_size;
+    unsigned long N = toas.rows(); // Number of total measurements
+    if (W < 1) {
+        cerr << "The window size must be at least 1" << endl;
+        return 1;
+    }
+    if (N < static_cast<unsigned long>(W)) {
+        cerr << "Not enough measurements: " << N << " for the selected window size "
+             << W << endl;
+        return 1;
+    }
+
+    // Receivers are static: the locator computes their geometry once and keeps running window statistics
+    tdoapp::SlidingWindowOptions window_options;
+    window_options.windowSize = W;
+    window_options.statistic = opt->statistic;
+    window_options.trimFraction = opt->trim_fraction;
+    window_options.method = opt->optimization_level == 2 ? tdoapp::Method::Nonlinear : tdoapp::Method::Linear;
+    tdoapp::SlidingWindowLocator locator{receiver_array, window_options};
+
     // Benchmarking init
     std::vector<benchmarkResult> result;
     result.reserve(N-W+1);
-    for (int i = 0; i < N - W; i++) {
+    for (Eigen::Index i = 0; i < toas.rows(); i++) {
         // Start our timer
         const auto start{std::chrono::high_resolution_clock::now()};
 
-        // Core localization approach with window sizes
-        auto slice = toas(Eigen::seq(i,i+W-1),Eigen::all);
-        auto toas_mean = slice.colwise().mean();
-
-        // We collect the timestamps in the receiver array
-        for (int j = 0; j < R; j++){
-            receiver_array[j].timestamp = toas_mean[j];
-        }
+        // Core localization approach with window sizes: one new row per step
+        auto estimation = locator.push(toas.row(i).transpose());
 
-        // Position computation
-        auto estimation = tdoapp::initialGuess(receiver_array);
-        if (opt->optimization_level == 2) {
-            estimation = tdoapp::nonlinearOptimization(receiver_array, estimation);
-        }
         // End timer and collect
         const auto end{std::chrono::high_resolution_clock::now()};
+        if (!estimation) {
+            continue;
+        }
 
         long long t;
         switch (opt->precision) {
@@ -221,7 +269,7 @@ int main(int argc, char **argv) {
             case 2:
                 t = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
         }
-        result.emplace_back(t, estimation[0], estimation[1]);
+        result.emplace_back(t, (*estimation)[0], (*estimation)[1]);
     }
 
     // Write output to file or stdout
@@ -18,7 +18,7 @@ namespace tdoapp {
         return std::sqrt(std::pow(x, 2) + std::pow(y, 2));
     }
 
-    int sgn(double val) {
+    inline int sgn(double val) {
         return (double(0) < val) - (val < double(0));
     }
 }
@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#ifndef LIBTDOA_EXACTBATCH_HH
+#define LIBTDOA_EXACTBATCH_HH
+
+#include <cstddef>
+#include <vector>
+
+#include "Receiver.hh"
+#include "TdoaSolution.hh"
+
+namespace tdoapp {
+    // Instruction sets of the batched exact solver
+    enum class SimdLevel {
+        Scalar,
+        Avx2,  // 4 fixes per instruction
+        Avx512 // 8 fixes per instruction
+    };
+
+    // Widest level supported by both the build and the running CPU
+    SimdLevel simdLevel();
+
+    const char *toString(SimdLevel level);
+
+    // Three-receiver fixes in structure-of-arrays layout: element i of every column belongs to fix i.
+    // Every fix has its own receivers, so a batch can mix deployments
+    struct ExactBatchColumns {
+        std::vector<double> x0, y0, x1, y1, x2, y2; // Receiver positions
+        std::vector<double> t0, t1, t2;             // Times of arrival
+
+        void push_back(const Receiver &r0, const Receiver &r1, const Receiver &r2);
+
+        void clear();
+
+        void reserve(size_t n);
+
+        size_t size() const { return t0.size(); }
+    };
+
+    struct ExactBatchResult {
+        std::vector<double> x, y;   // Chosen root as in exactSolution, NaN when the status is not usable
+        std::vector<double> xp, yp; // Positive arm, NaN without real roots
+        std::vector<double> xm, ym; // Negative arm
+        std::vector<SolutionStatus> status;
+
+        size_t size() const { return status.size(); }
+    };
+
+    // Fang's exact solution for every fix of the batch, several fixes per instruction. Roots and sign disambiguation
+    // are computed without branches. Every fix gives exactly the same bits as exactSolution / ExactFrame::solution
+    // on its receivers, at every level: both use the same operations in the same order, all of them correctly
+    // rounded, and the library is built without floating-point contraction.
+    void exactBatch(const ExactBatchColumns &columns, ExactBatchResult &result, bool getPositive = true);
+
+    // Forces an instruction set (e.g. for benchmarks and tests). Throws std::invalid_argument when it is not
+    // supported by the build or the CPU
+    void exactBatch(const ExactBatchColumns &columns, ExactBatchResult &result, bool getPositive, SimdLevel level);
+}
+
+#endif //LIBTDOA_EXACTBATCH_HH
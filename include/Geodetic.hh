@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#ifndef LIBTDOA_GEODETIC_HH
+#define LIBTDOA_GEODETIC_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "Receiver.hh"
+
+namespace tdoapp {
+    // WGS-84 ellipsoid
+    constexpr double kWgs84SemiMajorAxis = 6'378'137.0;
+    constexpr double kWgs84Flattening = 1.0 / 298.257223563;
+
+    // Latitude and longitude in degrees, altitude in meters above the ellipsoid
+    struct GeodeticPosition {
+        double latitude = 0.0;
+        double longitude = 0.0;
+        double altitude = 0.0;
+    };
+
+    // Receiver reporting its WGS-84 position. The timestamp is in meters (seconds times kSPEEDOFLIGHT), the unit of
+    // the projected coordinates
+    struct GeodeticReceiver {
+        double latitude;
+        double longitude;
+        double altitude;
+        double timestamp;
+
+        GeodeticPosition position() const { return {latitude, longitude, altitude}; }
+    };
+
+    using GeodeticMeasurement = std::vector<GeodeticReceiver>;
+
+    // Earth-centered, earth-fixed coordinates, in meters
+    Eigen::Vector3d toEcef(const GeodeticPosition &position);
+
+    GeodeticPosition fromEcef(const Eigen::Vector3d &ecef);
+
+    // Local East-North-Up tangent frame at an origin
+    class EnuFrame {
+    public:
+        explicit EnuFrame(const GeodeticPosition &origin);
+
+        Eigen::Vector3d toEnu(const GeodeticPosition &position) const;
+
+        GeodeticPosition toGeodetic(const Eigen::Vector3d &enu) const;
+
+        const GeodeticPosition &origin() const { return origin_; }
+
+    private:
+        GeodeticPosition origin_;
+        Eigen::Vector3d originEcef_;
+        Eigen::Matrix3d rotation_; // ECEF to ENU
+    };
+
+    // Hash of the receiver coordinates, not of the timestamps: the same set in the same order always gets the same one
+    std::uint64_t geometryHash(const GeodeticMeasurement &receivers);
+
+    // Receiver set projected once to the East-North plane of an ENU frame at its centroid. Fixes only copy the
+    // projected coordinates next to their timestamps, with no trigonometry, and the small coordinates around the
+    // origin keep linearTDOA well-conditioned. The up component is dropped: the 2-D solvers assume the emitter and
+    // the receivers lie on the same plane. The ellipsoid falls below the tangent plane by about d^2 / 2R at a
+    // distance d from the origin (under 1 m at 3 km, about 8 m at 10 km, 70 m at 30 km), plus any difference in
+    // height, so the projection is meant for deployments a few kilometers across
+    class GeodeticProjection {
+    public:
+        // Throws std::invalid_argument with less than 3 receivers, non-finite coordinates or latitudes beyond 90
+        // degrees
+        explicit GeodeticProjection(const GeodeticMeasurement &receivers);
+
+        // Planar receivers with the timestamps of a measurement of the projected receivers, in the same order.
+        // Throws std::invalid_argument when the measurement has a different number of receivers
+        std::vector<Receiver> project(const GeodeticMeasurement &receivers) const;
+
+        // Position on the plane back to WGS-84, at the mean height of the receivers above it
+        GeodeticPosition toGeodetic(const Eigen::Vector2d &position) const;
+
+        // Whether the receivers have the projected coordinates, in the same order
+        bool matches(const GeodeticMeasurement &receivers) const;
+
+        const EnuFrame &frame() const { return frame_; }
+
+        // Projected receivers, with zero timestamps
+        const std::vector<Receiver> &receivers() const { return receivers_; }
+
+        std::uint64_t hash() const { return hash_; }
+
+    private:
+        GeodeticMeasurement geodetic_;
+        EnuFrame frame_;
+        std::vector<Receiver> receivers_;
+        double up_ = 0.0;
+        std::uint64_t hash_;
+    };
+
+    // Projections of the receiver sets seen last, by geometry hash. Safe to share between threads; the projections
+    // it hands out stay valid after they are evicted
+    class GeodeticCache {
+    public:
+        // Receiver sets kept, the least recently used is evicted first
+        explicit GeodeticCache(size_t capacity = 256);
+
+        // Cached projection of the receivers, built on a miss. Throws as the GeodeticProjection constructor
+        std::shared_ptr<const GeodeticProjection> projection(const GeodeticMeasurement &receivers);
+
+        size_t size() const;
+
+        size_t hits() const;
+
+        size_t misses() const;
+
+    private:
+        using Entry = std::shared_ptr<const GeodeticProjection>;
+
+        size_t capacity_;
+        mutable std::mutex mutex_;
+        std::list<Entry> entries_; // Most recently used first
+        std::unordered_map<std::uint64_t, std::list<Entry>::iterator> byHash_;
+        size_t hits_ = 0;
+        size_t misses_ = 0;
+    };
+}
+
+#endif //LIBTDOA_GEODETIC_HH
@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#ifndef LIBTDOA_GRIDINITIALIZER_HH
+#define LIBTDOA_GRIDINITIALIZER_HH
+
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "Receiver.hh"
+#include "TdoaLocator.hh"
+#include "TdoaSolution.hh"
+
+namespace tdoapp {
+    struct GridOptions {
+        int resolution = 32;  // Points per side of the coarse grid
+        double margin = 0.5;  // The coarse grid covers the receivers' bounding box grown by this fraction per side
+        int levels = 3;       // Refinements of every candidate, each one with a 9x9 grid 4 times finer
+        int candidates = 2;   // Best local minima of the coarse grid, refined and handed to the NLLS step
+        // NLLS only starts from the other candidates when their refined cost is within this factor of the best one,
+        // i.e. when the grid cannot tell the minima apart
+        double ambiguity = 4.0;
+        NlsBackend backend = NlsBackend::Ceres;
+    };
+
+    struct GridCandidate {
+        Eigen::Vector2d position;
+        double cost; // TDOA cost at position
+    };
+
+    // Coarse-to-fine search of the all-pairs TDOA cost sum_ij ((t_i - t_j) - (|p - s_i| - |p - s_j|))^2, evaluated
+    // in O(N) per point as N times the variance of t_i - |p - s_i|, for a whole grid at once with array expressions.
+    // Returns the best local minima of the coarse grid after the refinement, best first (empty without at least 3
+    // finite receivers)
+    std::vector<GridCandidate> gridCandidates(const std::vector<Receiver> &receivers, const GridOptions &options = {});
+
+    // NLLS from the best grid candidate and from the ambiguous ones, keeping the lowest residual. iterations adds up
+    // all the starts
+    TdoaSolution multiStartSolution(const std::vector<Receiver> &receivers, const GridOptions &options = {});
+}
+
+#endif //LIBTDOA_GRIDINITIALIZER_HH
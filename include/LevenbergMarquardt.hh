@@ -0,0 +1,220 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#ifndef LIBTDOA_LEVENBERGMARQUARDT_HH
+#define LIBTDOA_LEVENBERGMARQUARDT_HH
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "Receiver.hh"
+
+namespace tdoapp {
+    struct LevenbergMarquardtOptions {
+        int maxIterations = 50;
+        double functionTolerance = 1e-10;  // Relative cost decrease
+        double gradientTolerance = 1e-12;  // Max-norm of the gradient
+        double parameterTolerance = 1e-10; // Step size relative to the position norm
+        double initialDamping = 1e-4;
+    };
+
+    template<int Dim>
+    struct LevenbergMarquardtSummaryT {
+        Eigen::Matrix<double, Dim, 1> position;
+        double cost;    // 0.5 * sum of the squared pair residuals (same as ceres)
+        int iterations;
+        bool converged;
+        Eigen::Matrix<double, Dim, Dim> gaussNewton; // J^T J at position, as evaluated by the last accepted step
+    };
+
+    using LevenbergMarquardtSummary = LevenbergMarquardtSummaryT<2>;
+
+    // Largest receiver count that gets its own fixed-size solver
+    constexpr int kMaxFixedReceivers = 12;
+
+    // Levenberg-Marquardt for the all-pairs TDOA problem, templated on the number of receivers and on the
+    // dimension (2 or 3). With a compile-time N all the temporaries are fixed-size, so solving never touches the
+    // heap. Eigen::Dynamic is the fallback for any other count: its workspace is only resized when the number of
+    // receivers changes.
+    //
+    // Every pair residual (ti - tj) - (di - dj) is the difference e_i - e_j with e_i = ti - di, which collapses the
+    // cost, gradient and Gauss-Newton matrix of the N(N-1)/2 pairs into O(N) sums around the means of e and grad(d).
+    template<int N = Eigen::Dynamic, int Dim = 2>
+    class TdoaLevenbergMarquardt {
+        static constexpr double epsilon = 1e-8; // Same regularization of the distances as TdoaError
+
+        using Vector = Eigen::Matrix<double, Dim, 1>;
+        using Matrix = Eigen::Matrix<double, Dim, Dim>;
+
+        LevenbergMarquardtOptions options_;
+        Eigen::Matrix<double, 1, N> e_;
+        Eigen::Array<double, 1, N> d_;
+        Eigen::Matrix<double, Dim, N> u_;
+
+    public:
+        using Summary = LevenbergMarquardtSummaryT<Dim>;
+
+        explicit TdoaLevenbergMarquardt(const LevenbergMarquardtOptions &options = {}) : options_{options} {}
+
+        // positions is DimxN and timestamps has N elements, both in receiver order
+        template<typename Positions, typename Timestamps>
+        Summary solve(const Eigen::MatrixBase<Positions> &positions,
+                      const Eigen::MatrixBase<Timestamps> &timestamps,
+                      const Vector &initialGuess) {
+            e_.resize(1, positions.cols());
+            d_.resize(1, positions.cols());
+            u_.resize(Dim, positions.cols());
+
+            Summary summary{initialGuess, 0.0, 0, false, Matrix::Zero()};
+            Vector g, gCandidate;
+            Matrix H, HCandidate;
+            double cost = evaluate(positions, timestamps, summary.position, g, H);
+
+            double lambda = options_.initialDamping;
+            double nu = 2.0;
+            while (summary.iterations < options_.maxIterations) {
+                if (g.template lpNorm<Eigen::Infinity>() <= options_.gradientTolerance) {
+                    summary.converged = true;
+                    break;
+                }
+                summary.iterations++;
+
+                // Marquardt scaling, floored so that a flat direction still gets damped
+                Matrix A = H;
+                A.diagonal() += lambda * H.diagonal().cwiseMax(1e-12);
+                Vector step = -A.ldlt().solve(g);
+
+                if (step.norm() <= options_.parameterTolerance *
+                                   (summary.position.norm() + options_.parameterTolerance)) {
+                    summary.converged = true;
+                    break;
+                }
+
+                Vector candidate = summary.position + step;
+                double candidateCost = evaluate(positions, timestamps, candidate, gCandidate, HCandidate);
+
+                if (candidateCost < cost) {
+                    // Nielsen's update of the damping from the gain ratio
+                    double predicted = -(g.dot(step) + 0.5 * step.dot(H * step));
+                    double rho = predicted > 0.0 ? (cost - candidateCost) / predicted : 1.0;
+                    lambda *= std::max(1.0 / 3.0, 1.0 - std::pow(2.0 * rho - 1.0, 3));
+                    nu = 2.0;
+
+                    bool stalled = (cost - candidateCost) <= options_.functionTolerance * cost;
+                    summary.position = candidate;
+                    cost = candidateCost;
+                    g = gCandidate;
+                    H = HCandidate;
+                    if (stalled) {
+                        summary.converged = true;
+                        break;
+                    }
+                } else {
+                    lambda *= nu;
+                    nu *= 2.0;
+                }
+            }
+
+            summary.cost = cost;
+            summary.gaussNewton = H;
+            return summary;
+        }
+
+    private:
+        // Cost at p, with gradient g = J^T r and Gauss-Newton matrix H = J^T J
+        template<typename Positions, typename Timestamps>
+        double evaluate(const Eigen::MatrixBase<Positions> &positions, const Eigen::MatrixBase<Timestamps> &timestamps,
+                        const Vector &p, Vector &g, Matrix &H) {
+            const auto n = static_cast<double>(positions.cols());
+
+            u_ = (-positions).colwise() + p;
+            d_ = (u_.colwise().squaredNorm().array() + epsilon).sqrt();
+            e_ = timestamps.transpose() - d_.matrix();
+            u_.array().rowwise() /= d_;
+
+            // Centering keeps the O(N) sums as accurate as the explicit pairs
+            e_.array() -= e_.mean();
+            u_.colwise() -= u_.rowwise().mean();
+
+            g.noalias() = -n * (u_ * e_.transpose());
+            H.noalias() = n * (u_ * u_.transpose());
+            return 0.5 * n * e_.squaredNorm();
+        }
+    };
+
+    namespace detail {
+        // Calls fixed(std::integral_constant<int, n>) when n has a fixed-size solver, dynamic() otherwise
+        template<int N, typename Fixed, typename Dynamic>
+        auto dispatchReceiverCount(Eigen::Index n, const Fixed &fixed, const Dynamic &dynamic) -> decltype(dynamic()) {
+            if constexpr (N > kMaxFixedReceivers) {
+                return dynamic();
+            } else {
+                if (n == N) {
+                    return fixed(std::integral_constant<int, N>{});
+                }
+                return dispatchReceiverCount<N + 1>(n, fixed, dynamic);
+            }
+        }
+    }
+
+    template<int Dim>
+    LevenbergMarquardtSummaryT<Dim> levenbergMarquardt(const std::vector<ReceiverT<Dim>> &receivers,
+                                                       const Eigen::Matrix<double, Dim, 1> &initialGuess,
+                                                       const LevenbergMarquardtOptions &options = {}) {
+        auto fill = [&receivers](auto &positions, auto &timestamps) {
+            for (Eigen::Index i = 0; i < positions.cols(); i++) {
+                const auto &r = receivers[static_cast<size_t>(i)];
+                positions.col(i) = r.position();
+                timestamps[i] = r.timestamp;
+            }
+        };
+
+        return detail::dispatchReceiverCount<3>(
+                static_cast<Eigen::Index>(receivers.size()),
+                [&](auto size) {
+                    constexpr int R = decltype(size)::value;
+                    Eigen::Matrix<double, Dim, R> positions;
+                    Eigen::Matrix<double, R, 1> timestamps;
+                    fill(positions, timestamps);
+                    return TdoaLevenbergMarquardt<R, Dim>{options}.solve(positions, timestamps, initialGuess);
+                },
+                [&]() {
+                    Eigen::Matrix<double, Dim, Eigen::Dynamic> positions(Dim, receivers.size());
+                    Eigen::VectorXd timestamps(receivers.size());
+                    fill(positions, timestamps);
+                    return TdoaLevenbergMarquardt<Eigen::Dynamic, Dim>{options}.solve(positions, timestamps,
+                                                                                      initialGuess);
+                });
+    }
+
+    inline LevenbergMarquardtSummary levenbergMarquardt(const std::vector<Receiver> &receivers,
+                                                        const Eigen::Vector2d &initialGuess,
+                                                        const LevenbergMarquardtOptions &options = {}) {
+        return levenbergMarquardt<2>(receivers, initialGuess, options);
+    }
+
+    inline LevenbergMarquardtSummary levenbergMarquardt(const Eigen::Ref<const Eigen::Matrix2Xd> &positions,
+                                                        const Eigen::Ref<const Eigen::VectorXd> &timestamps,
+                                                        const Eigen::Vector2d &initialGuess,
+                                                        const LevenbergMarquardtOptions &options = {}) {
+        return detail::dispatchReceiverCount<3>(
+                positions.cols(),
+                [&](auto size) {
+                    constexpr int R = decltype(size)::value;
+                    Eigen::Matrix<double, 2, R> p = positions;
+                    Eigen::Matrix<double, R, 1> t = timestamps;
+                    return TdoaLevenbergMarquardt<R>{options}.solve(p, t, initialGuess);
+                },
+                [&]() {
+                    return TdoaLevenbergMarquardt<>{options}.solve(positions, timestamps, initialGuess);
+                });
+    }
+}
+
+#endif //LIBTDOA_LEVENBERGMARQUARDT_HH
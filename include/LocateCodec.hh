@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#ifndef LIBTDOA_LOCATECODEC_HH
+#define LIBTDOA_LOCATECODEC_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "Geodetic.hh"
+#include "Receiver.hh"
+#include "ToaFile.hh"
+
+namespace tdoapp {
+    // Binary encoding of the TdoaRest localization requests and responses, an alternative to JSON that is decoded
+    // straight into receiver arrays. All fields are little-endian and 8-byte aligned. Request:
+    //
+    //   offset 0          char[4]           magic "TDRQ"
+    //   offset 4          uint32            version (1)
+    //   offset 8          uint32            method (1 to 4, as in the JSON requests)
+    //   offset 12         uint32            flags: bit 0 geodetic receivers, bit 1 registered receiver set
+    //   offset 16         uint64            R, number of receivers of every measurement, at least 3
+    //   offset 24         uint64            N, number of measurements
+    //   offset 32         float64[N][R][V]  receivers, V = 3 (x, y, timestamp), or V = 4 (latitude, longitude,
+    //                                       altitude, timestamp) when geodetic
+    //
+    // With a registered receiver set, the receivers are replaced by its id and the TOAs:
+    //
+    //   offset 32         uint64            L, length of the id
+    //   offset 40         char[L]           id, zero-padded to a multiple of 8 bytes (P)
+    //   offset 40 + P     float64[N][R]     TOAs, one row per measurement
+    //
+    // Response:
+    //
+    //   offset 0          char[4]           magic "TDRS"
+    //   offset 4          uint32            version (1)
+    //   offset 8          uint32            method
+    //   offset 12         uint32            flags: bit 0 geodetic positions
+    //   offset 16         uint64            N, number of positions
+    //   offset 24         float64[N][V]     positions, V = 2 (x, y), or V = 3 (latitude, longitude, altitude)
+    constexpr char kLocateRequestMagic[4] = {'T', 'D', 'R', 'Q'};
+    constexpr char kLocateResponseMagic[4] = {'T', 'D', 'R', 'S'};
+    constexpr std::uint32_t kLocateCodecVersion = 1;
+    constexpr std::uint32_t kLocateGeodetic = 1u << 0;
+    constexpr std::uint32_t kLocateReceiverSet = 1u << 1;
+    constexpr char kLocateMediaType[] = "application/vnd.tdoapp.locate";
+
+    // Decoded request. Only one of measurements, geodetic and toas is filled, depending on the flags
+    struct LocateRequest {
+        int method = 1;
+        std::uint32_t flags = 0;
+        std::vector<std::vector<Receiver>> measurements; // Planar receivers
+        std::vector<GeodeticMeasurement> geodetic;       // WGS-84 receivers
+        std::string set;                                 // Id of the registered receiver set
+        ToaMatrix toas;                                  // NxR TOAs of the registered receiver set
+    };
+
+    // Throws std::invalid_argument when the data is not a valid request: wrong magic, version or flags, less than 3
+    // receivers, sizes that do not match its length, or non-finite values
+    LocateRequest decodeLocateRequest(std::string_view data);
+
+    // Throws std::invalid_argument when the measurements have different numbers of receivers, or less than 3
+    std::string encodeLocateRequest(const LocateRequest &request);
+
+    // Responses with planar and WGS-84 positions. Positions without a fix are NaN
+    std::string encodeLocateResponse(int method, const std::vector<Eigen::Vector2d> &positions);
+
+    std::string encodeLocateResponse(int method, const std::vector<GeodeticPosition> &positions);
+
+    // Positions of a response, with 2 (planar) or 3 (geodetic) rows. Throws std::invalid_argument when the data is
+    // not a valid response
+    Eigen::MatrixXd decodeLocateResponse(std::string_view data, int *method = nullptr, bool *geodetic = nullptr);
+}
+
+#endif //LIBTDOA_LOCATECODEC_HH
@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#ifndef LIBTDOA_NLSCONTEXT_HH
+#define LIBTDOA_NLSCONTEXT_HH
+
+#include <vector>
+
+#include <Eigen/Dense>
+#include <ceres/ceres.h>
+
+#include "Receiver.hh"
+#include "TdoaCostFunction.hh"
+#include "TdoaGeometry.hh"
+
+namespace tdoapp {
+    // Solver settings for the 2-parameter TDOA problem
+    struct NlsOptions {
+        int maxIterations = 50;
+        double functionTolerance = 1e-10;
+        double gradientTolerance = 1e-12;
+        double parameterTolerance = 1e-10;
+        bool warmStart = true; // Start from the previous fix of an NlsContext
+        // Reference keeps the cost of a fix linear in the number of receivers, with the same solution (see
+        // TdoaCostFunction)
+        ResidualTopology topology = ResidualTopology::AllPairs;
+    };
+
+    // ceres options for a tiny dense problem: dense QR, single thread and no logging
+    ceres::Solver::Options ceresOptions(const NlsOptions &options);
+
+    // Non-linear refinement for a fixed receiver set that is solved over and over (e.g. tracking feeds).
+    // The ceres::Problem and its cost function are built once; every fix only swaps the timestamps and, with warm
+    // starts, begins at the previous solution. Not thread-safe: use one context per thread.
+    class NlsContext {
+    public:
+        explicit NlsContext(const std::vector<Receiver> &receivers, const NlsOptions &options = {});
+
+        NlsContext(const NlsContext &) = delete;
+
+        NlsContext &operator=(const NlsContext &) = delete;
+
+        // Starts from the previous fix, or from the geometry's initial guess when there is none (or warm
+        // starts are disabled)
+        Eigen::Vector2d solve(const Eigen::Ref<const Eigen::VectorXd> &timestamps);
+
+        Eigen::Vector2d solve(const Eigen::Ref<const Eigen::VectorXd> &timestamps, const Eigen::Vector2d &initialGuess);
+
+        // Forget the previous fix, so the next solve starts cold
+        void reset() { hasFix_ = false; }
+
+        const ceres::Solver::Summary &summary() const { return summary_; }
+
+        const TdoaGeometry &geometry() const { return geometry_; }
+
+    private:
+        TdoaGeometry geometry_;
+        ceres::Solver::Options solverOptions_;
+        ceres::Solver::Summary summary_;
+        ceres::Problem problem_;
+        TdoaCostFunction *cost_; // Owned by problem_
+        double xy_[2] = {0.0, 0.0};
+        bool warmStart_;
+        bool hasFix_ = false;
+    };
+}
+
+#endif //LIBTDOA_NLSCONTEXT_HH
@@ -6,18 +6,45 @@
 #ifndef LIBDTDOA_RECEIVER_H
 #define LIBDTDOA_RECEIVER_H
 
+#include <Eigen/Core>
+
 namespace tdoapp {
 
     const double kSPEEDOFLIGHT = 299'792'458.0;
 
-    class Receiver {
+    // Receiver position and time of arrival, for Dim = 2 (x, y) or Dim = 3 (x, y, z)
+    template<int Dim>
+    class ReceiverT;
+
+    template<>
+    class ReceiverT<2> {
     public:
-        Receiver(const double x, const double y, const double t) : x{x}, y{y}, timestamp{t} {}
-        Receiver(const double x, const double y) : x{x}, y{y}, timestamp{0.0} {}
+        static constexpr int dimension = 2;
+
+        ReceiverT(const double x, const double y, const double t) : x{x}, y{y}, timestamp{t} {}
+        ReceiverT(const double x, const double y) : x{x}, y{y}, timestamp{0.0} {}
+
+        Eigen::Vector2d position() const { return {x, y}; }
 
         double x, y;
         double timestamp;
     };
+
+    template<>
+    class ReceiverT<3> {
+    public:
+        static constexpr int dimension = 3;
+
+        ReceiverT(const double x, const double y, const double z, const double t) : x{x}, y{y}, z{z}, timestamp{t} {}
+
+        Eigen::Vector3d position() const { return {x, y, z}; }
+
+        double x, y, z;
+        double timestamp;
+    };
+
+    using Receiver = ReceiverT<2>;
+    using Receiver3d = ReceiverT<3>;
 }
 
 #endif //LIBDTDOA_RECEIVER_H
@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#ifndef LIBTDOA_ROBUSTLOCATOR_HH
+#define LIBTDOA_ROBUSTLOCATOR_HH
+
+#include <chrono>
+#include <vector>
+
+#include "Receiver.hh"
+#include "TdoaLocator.hh"
+#include "TdoaSolution.hh"
+#include "ThreadPool.hh"
+
+namespace tdoapp {
+    struct RansacOptions {
+        // A receiver supports a hypothesis when its TOA is within this distance of the one the hypothesis predicts
+        double inlierThreshold = 1.0;
+        // Probability of having drawn at least one outlier-free triple before stopping early
+        double confidence = 0.99;
+        size_t maxHypotheses = 1000;
+        // Hard limit per fix, 0 (the default) for none. Hypotheses stop once it is spent and the refinement is
+        // skipped if nothing is left for it; the solution is then reported as SolutionStatus::TimedOut
+        std::chrono::nanoseconds budget{0};
+        // Hypotheses are scored on the pool, in rounds of a few per thread, from this many receivers on
+        ThreadPool *pool = nullptr;
+        size_t parallelReceivers = 32;
+        NlsBackend backend = NlsBackend::LevenbergMarquardt;
+        unsigned seed = 0;
+    };
+
+    struct RobustSolution {
+        TdoaSolution solution;     // NLLS on the inliers, or the best hypothesis when the budget ran out
+        std::vector<bool> inliers; // Per receiver, in the input order
+        size_t hypotheses = 0;     // Scored hypotheses
+        bool timedOut = false;     // The budget stopped the search or skipped the refinement
+    };
+
+    // RANSAC with Fang's exact solution as the minimal solver: every triple of receivers gives up to two candidate
+    // positions, scored at once against all the receivers by their truncated squared TOA residuals (MSAC). The
+    // search stops when the best consensus makes the confidence target met, or at maxHypotheses or the budget, and
+    // the best candidate is refined with NLLS over its inliers. With few receivers every triple is tried, in random
+    // order. Needs at least 4 receivers to reject anything; 3 are solved exactly and refined
+    RobustSolution robustSolution(const std::vector<Receiver> &receivers, const RansacOptions &options = {});
+}
+
+#endif //LIBTDOA_ROBUSTLOCATOR_HH
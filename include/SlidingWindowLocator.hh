@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#ifndef LIBTDOA_SLIDINGWINDOWLOCATOR_HH
+#define LIBTDOA_SLIDINGWINDOWLOCATOR_HH
+
+#include <optional>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "Receiver.hh"
+#include "TdoaGeometry.hh"
+#include "TdoaLocator.hh"
+#include "ToaFile.hh"
+
+namespace tdoapp {
+    // How the TOAs of every receiver are combined over the window
+    enum class WindowStatistic {
+        Mean,
+        Median,
+        TrimmedMean
+    };
+
+    struct SlidingWindowOptions {
+        size_t windowSize = 1;
+        WindowStatistic statistic = WindowStatistic::Mean;
+        double trimFraction = 0.1; // Fraction of the window dropped at each end for TrimmedMean
+        Method method = Method::Linear; // Linear or Nonlinear: the others need receivers, not the combined TOAs
+    };
+
+    // Streaming localization over a sliding window of TOA rows from a static deployment.
+    // The window lives in a ring buffer. The mean is kept as a running sum, so a step costs O(R) no matter the
+    // window size. The median and the trimmed mean keep every receiver's window sorted, updated in place with a
+    // binary search and a single shift per step instead of being sorted again; the trimmed mean also keeps a running
+    // sum of the retained band, so it needs no pass over the window either.
+    class SlidingWindowLocator {
+    public:
+        // Throws std::invalid_argument for an empty window, a trim fraction outside [0, 0.5) or another method than
+        // Linear or Nonlinear
+        SlidingWindowLocator(const std::vector<Receiver> &receivers, const SlidingWindowOptions &options = {});
+
+        // Adds one TOA per receiver. Once the window is full every call returns the fix for the current window.
+        // Throws std::invalid_argument for a wrong size or non-finite TOAs, and whatever the solver throws
+        std::optional<Eigen::Vector2d> push(const Eigen::Ref<const Eigen::VectorXd> &toas);
+
+        // Combined TOAs of the current window (only meaningful once full)
+        const Eigen::VectorXd &windowToas() const { return statistic_; }
+
+        bool full() const { return count_ == options_.windowSize; }
+
+        // Forgets the window, keeping the geometry
+        void reset();
+
+        const TdoaGeometry &geometry() const { return geometry_; }
+
+    private:
+        void updateStatistic();
+
+        TdoaGeometry geometry_;
+        SlidingWindowOptions options_;
+        size_t trim_ = 0; // Values dropped at each end of the sorted window
+
+        ToaMatrix ring_;       // W x R, oldest row at head_ once full
+        size_t head_ = 0;
+        size_t count_ = 0;
+        Eigen::VectorXd sum_;
+        Eigen::VectorXd bandSum_; // Per receiver, sum of the sorted window over [trim_, W - trim_) (TrimmedMean only)
+
+        ToaMatrix sorted_;     // R x W, receiver j's window sorted in row j (order statistics only)
+        Eigen::VectorXd statistic_;
+    };
+}
+
+#endif //LIBTDOA_SLIDINGWINDOWLOCATOR_HH
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#ifndef LIBTDOA_TDOABATCH_HH
+#define LIBTDOA_TDOABATCH_HH
+
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "Receiver.hh"
+#include "TdoaGeometry.hh"
+#include "TdoaIndex.hh"
+#include "TdoaLocator.hh"
+#include "ThreadPool.hh"
+#include "ToaFile.hh"
+
+namespace tdoapp {
+    // One fix: receiver positions with their timestamps
+    using Measurement = std::vector<Receiver>;
+
+    // Solves independent measurements in parallel. Results keep the input order; a measurement that cannot be
+    // solved (any TdoaSolution that is not usable, e.g. no real solution for 3 receivers) yields NaN coordinates
+    // instead of aborting the batch. No exception is thrown or caught per measurement.
+    std::vector<Eigen::Vector2d> locateBatch(const std::vector<Measurement> &measurements, Method method,
+                                             ThreadPool &pool);
+
+    // Same as above with a pool that only lives for this call. 0 threads uses all the hardware threads
+    std::vector<Eigen::Vector2d> locateBatch(const std::vector<Measurement> &measurements, Method method,
+                                             unsigned threads = 0);
+
+    // Solves a batch on the calling thread. Measurements with the same receiver positions (in the same order) share
+    // one TdoaGeometry, so its factorization is paid once per deployment instead of once per fix; three-receiver
+    // fixes go through the vectorized exactBatch. Same ordering and failure handling as above
+    std::vector<Eigen::Vector2d> locateGrouped(const std::vector<Measurement> &measurements, Method method);
+
+    // Solves every row of an NxR TOA matrix (e.g. ToaFile::toas()) for a static deployment. Rows are read in
+    // place, so a memory-mapped file is never copied. Non-linear fixes start from the index instead of the initial
+    // guess when one is given; it must match the geometry (std::invalid_argument otherwise). Same ordering and
+    // failure handling as above
+    std::vector<Eigen::Vector2d> locateBatch(const TdoaGeometry &geometry, const Eigen::Ref<const ToaMatrix> &toas,
+                                             Method method, ThreadPool &pool, const TdoaIndex *index = nullptr);
+}
+
+#endif //LIBTDOA_TDOABATCH_HH
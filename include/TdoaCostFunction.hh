@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#ifndef LIBTDOA_TDOACOSTFUNCTION_HH
+#define LIBTDOA_TDOACOSTFUNCTION_HH
+
+#include <vector>
+
+#include <Eigen/Dense>
+#include <ceres/ceres.h>
+
+#include "Receiver.hh"
+
+namespace tdoapp {
+    // Which TDOAs become residuals
+    enum class ResidualTopology {
+        AllPairs, // N(N-1)/2 pairs (i < j), as TdoaError
+        Reference // N-1 TDOAs against a reference receiver, whitened with their covariance
+    };
+
+    // Picks the receiver with the earliest timestamp as reference
+    constexpr int kAutoReference = -1;
+
+    // TDOA residuals in a single residual block, with a hand-derived Jacobian. The only parameter block is the 2D
+    // position {x, y}.
+    //
+    // AllPairs: residual k follows the (i < j) ordering of the pairs.
+    // Reference: with i.i.d. TOA noise of variance s^2, the TDOAs r_i against the reference have covariance
+    // s^2 (I + 1 1^T), whose information matrix I - 1 1^T / N factors as W^T W with W = I - a 1 1^T,
+    // a = (1 - 1/sqrt(N)) / (N - 1). The residuals are sqrt(N) W r, in receiver order without the reference. The
+    // factor makes their squared norm, gradient and Gauss-Newton matrix those of all the pairs, for any reference,
+    // so the solver takes the same steps while evaluating O(N) residuals instead of O(N^2).
+    class TdoaCostFunction : public ceres::CostFunction {
+    public:
+        // Receiver positions (2 x N, any column stride) and timestamps read in place
+        using Positions = Eigen::Map<const Eigen::Matrix2Xd, 0, Eigen::OuterStride<>>;
+        using Timestamps = Eigen::Map<const Eigen::VectorXd>;
+
+    private:
+        // Either owned, or those of the caller (see the constructors)
+        Eigen::Matrix2Xd ownedPositions_;
+        Eigen::VectorXd ownedTimestamps_;
+        Positions positions_;
+        Timestamps timestamps_;
+        ResidualTopology topology_;
+        int reference_;
+        static constexpr double epsilon = 1e-8;
+
+        // Evaluate keeps its scratch on the stack up to this many receivers and allocates it past them. Nothing is
+        // shared between calls, so one instance can back residual blocks evaluated concurrently
+        static constexpr int kStackReceivers = 32;
+
+        void setSizes();
+
+        bool evaluate(const Eigen::Vector2d &p, Eigen::Ref<Eigen::Matrix2Xd> diff, Eigen::Ref<Eigen::RowVectorXd> d,
+                      double *residuals, double **jacobians) const;
+
+        bool evaluateReference(const Eigen::Ref<const Eigen::Matrix2Xd> &unit,
+                               const Eigen::Ref<const Eigen::RowVectorXd> &d, double *residuals,
+                               double **jacobians) const;
+
+    public:
+        explicit TdoaCostFunction(const std::vector<Receiver> &receivers,
+                                  ResidualTopology topology = ResidualTopology::AllPairs,
+                                  int reference = kAutoReference);
+
+        // Receiver positions and timestamps in receiver order, used in place without copying them: the memory they
+        // map has to outlive the cost function
+        TdoaCostFunction(const Positions &positions, const Timestamps &timestamps,
+                         ResidualTopology topology = ResidualTopology::AllPairs, int reference = kAutoReference);
+
+        // Replace the timestamps (in receiver order) while keeping the geometry. They are copied
+        void setTimestamps(const Eigen::Ref<const Eigen::VectorXd> &timestamps);
+
+        bool Evaluate(double const *const *parameters, double *residuals, double **jacobians) const override;
+    };
+}
+
+#endif //LIBTDOA_TDOACOSTFUNCTION_HH
@@ -11,12 +11,37 @@
 #include "Algebra.hh"
 
 namespace tdoapp {
-    class TdoaError {
-        const Receiver r1_, r2_;
+    // Residual of the TDOA between two receivers, for a single parameter block with the Dim coordinates
+    template<int Dim>
+    class TdoaErrorT {
+    protected:
+        const ReceiverT<Dim> r1_, r2_;
         static constexpr double epsilon = 1e-8;
 
     public:
-        TdoaError(const Receiver &r1, const Receiver &r2) : r1_(r1), r2_(r2) {}
+        TdoaErrorT(const ReceiverT<Dim> &r1, const ReceiverT<Dim> &r2) : r1_(r1), r2_(r2) {}
+
+        template<typename T>
+        bool operator()(const T *position, T *residual) const {
+            const Eigen::Matrix<double, Dim, 1> s1 = r1_.position();
+            const Eigen::Matrix<double, Dim, 1> s2 = r2_.position();
+
+            T sq1 = T(epsilon), sq2 = T(epsilon);
+            for (int k = 0; k < Dim; k++) {
+                sq1 += (s1[k] - position[k]) * (s1[k] - position[k]);
+                sq2 += (s2[k] - position[k]) * (s2[k] - position[k]);
+            }
+
+            residual[0] = (r1_.timestamp - r2_.timestamp) - (ceres::sqrt(sq1) - ceres::sqrt(sq2));
+            return true;
+        }
+    };
+
+    // 2-D residual, which also takes x and y as separate parameter blocks
+    class TdoaError : public TdoaErrorT<2> {
+    public:
+        using TdoaErrorT<2>::TdoaErrorT;
+        using TdoaErrorT<2>::operator();
 
         template<typename T>
         bool operator()(const T *x, const T *y, T *residual) const {
@@ -27,6 +52,8 @@ namespace tdoapp {
             return true;
         };
     };
+
+    using TdoaError3d = TdoaErrorT<3>;
 }
 
 #endif //LIBTDOA_TDOAERROR_HH
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#ifndef LIBTDOA_TDOAGEOMETRY_HH
+#define LIBTDOA_TDOAGEOMETRY_HH
+
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "Receiver.hh"
+#include "TdoaLocator.hh"
+
+namespace tdoapp {
+    // Position-only terms of Fang's exact solution for receivers s0, s1 and s2
+    class ExactFrame {
+    public:
+        ExactFrame(const Receiver &r0, const Receiver &r1, const Receiver &r2);
+
+        // tau_01 = t0 - t1, tau_02 = t0 - t2. Both roots and the one that agrees with the TDOAs, without I/O
+        TdoaSolution solution(double tau_01, double tau_02, bool getPositive = true) const;
+
+        // Legacy interface: warns on std::cerr about ambiguous fixes and throws when there is no real solution
+        Eigen::Vector2d solve(double tau_01, double tau_02, bool getPositive = true) const;
+
+    private:
+        Eigen::Vector2d s0_, s1_;
+        double cos_, sin_; // Rotation of the frame
+        double b_, cx_, cy_, c_;
+    };
+
+    // Localization for a static receiver deployment.
+    // Everything that only depends on the receiver positions is computed once at construction, so every fix
+    // only pays for the timestamp-dependent terms. Timestamps are given in the same order as the receivers.
+    class TdoaGeometry {
+    public:
+        explicit TdoaGeometry(const std::vector<Receiver> &receivers);
+
+        Eigen::Vector2d initialGuess(const Eigen::Ref<const Eigen::VectorXd> &timestamps) const;
+
+        Eigen::Vector2d linearTDOA(const Eigen::Ref<const Eigen::VectorXd> &timestamps) const;
+
+        Eigen::Vector2d exactTDOA(const Eigen::Ref<const Eigen::VectorXd> &timestamps, bool getPositive = true) const;
+
+        Eigen::Vector2d nonlinearOptimization(const Eigen::Ref<const Eigen::VectorXd> &timestamps,
+                                              const Eigen::Vector2d &initialGuess,
+                                              CostModel model = CostModel::Analytic) const;
+
+        Eigen::Vector2d nonlinearOptimization(const Eigen::Ref<const Eigen::VectorXd> &timestamps,
+                                              const Eigen::Vector2d &initialGuess,
+                                              NlsBackend backend) const;
+
+        // Exception-free counterparts of the solvers above (see TdoaSolution). covariance as in the free functions
+        TdoaSolution initialSolution(const Eigen::Ref<const Eigen::VectorXd> &timestamps) const;
+
+        TdoaSolution linearSolution(const Eigen::Ref<const Eigen::VectorXd> &timestamps,
+                                    bool covariance = false) const;
+
+        TdoaSolution exactSolution(const Eigen::Ref<const Eigen::VectorXd> &timestamps, bool getPositive = true) const;
+
+        TdoaSolution nonlinearSolution(const Eigen::Ref<const Eigen::VectorXd> &timestamps,
+                                       const Eigen::Vector2d &initialGuess,
+                                       NlsBackend backend = NlsBackend::Ceres,
+                                       ceres::Solver::Summary *summary = nullptr,
+                                       bool covariance = false) const;
+
+        size_t size() const { return receivers_.size(); }
+
+        const std::vector<Receiver> &receivers() const { return receivers_; }
+
+    private:
+        void checkSize(const Eigen::Ref<const Eigen::VectorXd> &timestamps) const;
+
+        // Matching size and finite values
+        bool validTimestamps(const Eigen::Ref<const Eigen::VectorXd> &timestamps) const;
+
+        std::vector<Receiver> receivers_;
+        Eigen::Matrix2Xd positions_;
+        ExactFrame exact_;
+
+        // Linear LS system A * [r0, x, y] = b. Columns 1-2 of A (s0 - si) are fixed and factorized here,
+        // b only needs the time term added to 0.5 * (|s0|^2 - |si|^2)
+        Eigen::HouseholderQR<Eigen::MatrixX2d> geometryQr_;
+        Eigen::Matrix2Xd geometryBasis_; // Q1^T: first two columns of Q, transposed
+        Eigen::VectorXd bGeometry_;
+        bool rankDeficient_;             // Singular R (collinear receivers)
+    };
+}
+
+#endif //LIBTDOA_TDOAGEOMETRY_HH
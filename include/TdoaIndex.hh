@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#ifndef LIBTDOA_TDOAINDEX_HH
+#define LIBTDOA_TDOAINDEX_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "Receiver.hh"
+
+namespace tdoapp {
+    struct TdoaIndexOptions {
+        int resolution = 128; // Points per side of the tabulated grid
+        double margin = 0.5;  // The grid covers the receivers' bounding box grown by this fraction per side
+    };
+
+    // Binary index file. All fields are little-endian, R receivers, M grid points, D = R - 1, G x G cells:
+    //
+    //   offset 0              char[4]          magic "TDIX"
+    //   offset 4              uint32           version (2)
+    //   offset 8              uint64           R
+    //   offset 16             uint64           M
+    //   offset 24             uint64           G
+    //   offset 32             float64[R][2]    receiver positions (x, y)
+    //   then                  float64[D]       mean of the expected TDOAs
+    //   then                  float64[D][2]    projection of the TDOAs on the plane of the cells
+    //   then                  float64[2][2]    lowest corner and size of the cells
+    //   then                  float64[M][2]    grid positions, in cell order
+    //   then                  float64[M][D]    expected TDOAs |p - s_i| - |p - s_0|, i = 1..D, in cell order
+    //   then                  uint32[G * G + 1] first grid point of every cell, and M
+    constexpr char kTdoaIndexMagic[4] = {'T', 'D', 'I', 'X'};
+    constexpr std::uint32_t kTdoaIndexVersion = 2;
+
+    // Precomputed warm starts for a static receiver deployment. The expected TDOAs of a grid of positions lie on a
+    // 2-D surface, which is projected on its two principal directions and hashed into a grid of cells of about one
+    // point each. A fix projects its TDOAs, scans the cells around them and starts at the grid position whose TDOAs
+    // are closest to the measured ones. The projection never lengthens distances, so the scan stops as soon as the
+    // next ring of cells can not hold a closer point: the answer is the exact nearest point, in time independent of
+    // the grid size for queries near the surface. It replaces initialGuess: no factorization per fix, and the start
+    // is never far off, even where the linear solution degrades
+    class TdoaIndex {
+    public:
+        // Tabulates the grid. Throws std::invalid_argument with less than 3 receivers, non-finite positions or a
+        // resolution outside [2, 65535]
+        explicit TdoaIndex(const std::vector<Receiver> &receivers, const TdoaIndexOptions &options = {});
+
+        // Throws std::runtime_error when the file can not be read or is not a valid index file
+        static TdoaIndex load(const std::string &path);
+
+        // Throws std::runtime_error on I/O errors
+        void save(const std::string &path) const;
+
+        // Whether the receivers have the indexed positions, in the same order
+        bool matches(const std::vector<Receiver> &receivers) const;
+
+        // Grid position closest to the TDOAs of the timestamps, given in the order of the receivers. NaN when they
+        // do not match the receivers in number or are not finite
+        Eigen::Vector2d warmStart(const Eigen::Ref<const Eigen::VectorXd> &timestamps) const;
+
+        // Same, with the timestamps of a measurement of the indexed receivers
+        Eigen::Vector2d warmStart(const std::vector<Receiver> &receivers) const;
+
+        const std::vector<Receiver> &receivers() const { return receivers_; }
+
+        // Grid points
+        size_t size() const { return positions_.size() / 2; }
+
+        // Bytes taken by the tables
+        size_t memoryBytes() const;
+
+        // Seconds taken to build the index, or to load it from a file
+        double buildSeconds() const { return buildSeconds_; }
+
+    private:
+        TdoaIndex() = default;
+
+        // Cell of a projected point, clamped to the grid
+        Eigen::Array2i cellOf(const Eigen::Vector2d &projected) const;
+
+        std::vector<Receiver> receivers_;
+        size_t dims_ = 0;
+        size_t cells_ = 0;               // Cells per side
+        Eigen::VectorXd mean_;           // D
+        Eigen::MatrixX2d basis_;         // D x 2, orthonormal columns
+        Eigen::Vector2d low_, cellSize_; // Lowest corner and size of the cells, on the projection
+        std::vector<double> positions_;  // M x 2, row-major
+        std::vector<double> keys_;       // M x D, row-major
+        std::vector<std::uint32_t> cellStart_;
+        double buildSeconds_ = 0.0;
+    };
+}
+
+#endif //LIBTDOA_TDOAINDEX_HH
@@ -13,17 +13,118 @@
 
 #include "Receiver.hh"
 #include "TdoaError.hh"
+#include "TdoaCostFunction.hh"
+#include "LevenbergMarquardt.hh"
+#include "TdoaSolution.hh"
 
 namespace tdoapp {
+    // Factorization of the linear Least Squares problem. None of them allocates
+    enum class LinearSolver {
+        Auto,            // NormalEquations, or Svd when they are ill-conditioned
+        NormalEquations, // Cholesky (LDLT) of A^T A, accumulated in one pass. Fastest, squares the condition number
+        Givens,          // Incremental QR of A, one row at a time. Svd only if A is (nearly) rank-deficient
+        Svd              // Incremental QR followed by the SVD of its triangular factor. Slowest, minimum-norm
+    };
+
+    // Auto falls back to Svd when the reciprocal condition number of A^T A is below this, i.e. when solving the
+    // normal equations could lose about half of the digits
+    constexpr double kNormalEquationsRcond = 1.4901161193847656e-08; // sqrt(machine epsilon)
+
     // Linearized TDOA equations
     Eigen::Vector2d initialGuess(const std::vector<Receiver> &receivers);
 
-    Eigen::Vector2d linearTDOA(const std::vector<Receiver> &receivers);
+    // Needs at least 4 receivers
+    Eigen::Vector2d linearTDOA(const std::vector<Receiver> &receivers, LinearSolver solver = LinearSolver::Auto);
 
     Eigen::Vector2d exactTDOA(const std::vector<Receiver> &receivers, bool getPositive = true);
 
-    // Non-linear optimization for TDOA equations
-    Eigen::Vector2d nonlinearOptimization(const std::vector<Receiver> &receivers, const Eigen::Vector2d &initialGuess);
+    // Cost function used for the non-linear optimization
+    enum class CostModel {
+        Analytic,  // All pairs in a single block with hand-derived Jacobian (TdoaCostFunction)
+        AutoDiff,  // One automatic differentiation block per pair (TdoaError). Kept as reference
+        Reference  // N-1 whitened TDOAs against the earliest receiver (ResidualTopology::Reference). Same cost as
+                   // Analytic, evaluated in O(N) instead of O(N^2), for large receiver sets
+    };
+
+    // Solver used for the non-linear optimization
+    enum class NlsBackend {
+        Ceres,             // ceres::Solve with the analytic cost function
+        LevenbergMarquardt // Header-only, allocation-free solver (LevenbergMarquardt.hh)
+    };
+
+    // Non-linear optimization for TDOA equations. If summary is given, it receives the Ceres solver summary
+    // (iterations, termination type) of the solve
+    Eigen::Vector2d nonlinearOptimization(const std::vector<Receiver> &receivers, const Eigen::Vector2d &initialGuess,
+                                          CostModel model = CostModel::Analytic,
+                                          ceres::Solver::Summary *summary = nullptr);
+
+    Eigen::Vector2d nonlinearOptimization(const std::vector<Receiver> &receivers, const Eigen::Vector2d &initialGuess,
+                                          NlsBackend backend);
+
+    // Same on receiver positions (2 x N) and timestamps in receiver order, as TdoaGeometry keeps them, so that a fix
+    // does not have to build receivers
+    Eigen::Vector2d nonlinearOptimization(const Eigen::Ref<const Eigen::Matrix2Xd> &positions,
+                                          const Eigen::Ref<const Eigen::VectorXd> &timestamps,
+                                          const Eigen::Vector2d &initialGuess, CostModel model = CostModel::Analytic,
+                                          ceres::Solver::Summary *summary = nullptr);
+
+    // Localization methods exposed by the executables
+    enum class Method {
+        Linear = 1,    // initialGuess only
+        Nonlinear = 2, // initialGuess refined with nonlinearOptimization
+        Robust = 3,    // RANSAC over exact 3-receiver fixes, refined on the inliers (robustSolution, default options)
+        MultiStart = 4 // Coarse-to-fine grid search, NLLS from its best minima (multiStartSolution, default options)
+    };
+
+    Eigen::Vector2d locate(const std::vector<Receiver> &receivers, Method method);
+
+    // Exception-free counterparts of the solvers above: failures are reported in TdoaSolution::status and nothing
+    // is written to the standard streams. With covariance set, a usable solution also gets TdoaSolution::covariance:
+    // from the Gauss-Newton matrix of the last step with the LevenbergMarquardt backend, in closed form from the
+    // geometry at the position otherwise (positionCovariance). Neither solves again, and nothing is computed
+    // without it
+    TdoaSolution initialSolution(const std::vector<Receiver> &receivers);
+
+    TdoaSolution linearSolution(const std::vector<Receiver> &receivers, LinearSolver solver = LinearSolver::Auto,
+                                bool covariance = false);
+
+    TdoaSolution exactSolution(const std::vector<Receiver> &receivers, bool getPositive = true);
+
+    TdoaSolution nonlinearSolution(const std::vector<Receiver> &receivers, const Eigen::Vector2d &initialGuess,
+                                   NlsBackend backend = NlsBackend::Ceres, ceres::Solver::Summary *summary = nullptr,
+                                   bool covariance = false);
+
+    // Ceres with the given cost function
+    TdoaSolution nonlinearSolution(const std::vector<Receiver> &receivers, const Eigen::Vector2d &initialGuess,
+                                   CostModel model, ceres::Solver::Summary *summary = nullptr,
+                                   bool covariance = false);
+
+    TdoaSolution nonlinearSolution(const Eigen::Ref<const Eigen::Matrix2Xd> &positions,
+                                   const Eigen::Ref<const Eigen::VectorXd> &timestamps,
+                                   const Eigen::Vector2d &initialGuess, CostModel model = CostModel::Analytic,
+                                   ceres::Solver::Summary *summary = nullptr, bool covariance = false);
+
+    TdoaSolution locateSolution(const std::vector<Receiver> &receivers, Method method, bool covariance = false);
+
+    // Dimension-generic solvers, instantiated for Dim = 2 and Dim = 3. Everything in them is fixed-size, so a
+    // solve does not allocate (for up to kMaxFixedReceivers receivers in the non-linear case). The 2-D overloads
+    // above remain the default path: they are preferred by overload resolution for std::vector<Receiver>
+    template<int Dim>
+    using PositionT = Eigen::Matrix<double, Dim, 1>;
+
+    // Least Squares over the unknowns [r0, position]. Needs Dim + 2 receivers
+    template<int Dim>
+    PositionT<Dim> linearTDOA(const std::vector<ReceiverT<Dim>> &receivers, LinearSolver solver = LinearSolver::Auto);
+
+    // Refinement with the fixed-size Levenberg-Marquardt solver (LevenbergMarquardt.hh)
+    template<int Dim>
+    PositionT<Dim> nonlinearOptimization(const std::vector<ReceiverT<Dim>> &receivers,
+                                         const PositionT<Dim> &initialGuess);
+
+    extern template PositionT<2> linearTDOA<2>(const std::vector<ReceiverT<2>> &, LinearSolver);
+    extern template PositionT<3> linearTDOA<3>(const std::vector<ReceiverT<3>> &, LinearSolver);
+    extern template PositionT<2> nonlinearOptimization<2>(const std::vector<ReceiverT<2>> &, const PositionT<2> &);
+    extern template PositionT<3> nonlinearOptimization<3>(const std::vector<ReceiverT<3>> &, const PositionT<3> &);
 }
 
 #endif //LIBDTDOA_TDOALOCATOR_H
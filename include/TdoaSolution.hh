@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#ifndef LIBTDOA_TDOASOLUTION_HH
+#define LIBTDOA_TDOASOLUTION_HH
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "Receiver.hh"
+
+namespace tdoapp {
+    enum class SolutionStatus {
+        Ok,
+        Ambiguous,          // Both exact roots agree with the TDOAs; position holds the requested arm
+        NoConvergence,      // Iteration limit reached; position is the last iterate
+        TimedOut,           // Time budget spent; position is the best estimate found so far, NaN if there was none
+        NoRealSolution,     // Negative discriminant in the exact solution
+        NoConsistentRoot,   // No exact root agrees with the sign of the TDOA
+        NotEnoughReceivers,
+        InvalidInput,       // Wrong number of timestamps or non-finite values
+        SolverFailure       // Non-finite result or failed non-linear solve
+    };
+
+    enum class SolutionMethod {
+        Exact,
+        LinearLeastSquares,
+        NonlinearLeastSquares
+    };
+
+    // Outcome of a solver. Failures are reported in status instead of being thrown or printed, so callers on
+    // batch and server threads can handle them without unwinding or taking the stream locks.
+    struct TdoaSolution {
+        Eigen::Vector2d position = Eigen::Vector2d::Constant(std::numeric_limits<double>::quiet_NaN());
+
+        // Positive and negative arm of the exact solution (NaN for the other methods or a missing root)
+        std::array<Eigen::Vector2d, 2> roots = {Eigen::Vector2d::Constant(std::numeric_limits<double>::quiet_NaN()),
+                                                Eigen::Vector2d::Constant(std::numeric_limits<double>::quiet_NaN())};
+
+        SolutionStatus status = SolutionStatus::InvalidInput;
+        SolutionMethod method = SolutionMethod::Exact;
+        double residualNorm = std::numeric_limits<double>::quiet_NaN(); // TDOA residuals at position (see below)
+        int iterations = 0; // Non-linear iterations, 0 for the closed-form methods
+
+        // Position covariance per unit variance of the timestamps (see positionCovariance). Only filled when the
+        // solver is asked for it, NaN otherwise. Scale by the variance of the timestamps for an error ellipse
+        Eigen::Matrix2d covariance = Eigen::Matrix2d::Constant(std::numeric_limits<double>::quiet_NaN());
+
+        // Whether position holds an estimate
+        bool usable() const {
+            return status == SolutionStatus::Ok || status == SolutionStatus::Ambiguous ||
+                   status == SolutionStatus::NoConvergence ||
+                   (status == SolutionStatus::TimedOut && position.allFinite());
+        }
+
+        // Geometric dilution of precision: position RMS error per unit standard deviation of the timestamps
+        double gdop() const { return std::sqrt(covariance.trace()); }
+    };
+
+    const char *toString(SolutionStatus status);
+
+    const char *toString(SolutionMethod method);
+
+    // Norm of the residuals (t0 - ti) - (|p - s0| - |p - si|) of every receiver against receiver 0
+    double residualNorm(const Eigen::Ref<const Eigen::Matrix2Xd> &positions,
+                        const Eigen::Ref<const Eigen::VectorXd> &timestamps, const Eigen::Vector2d &position);
+
+    double residualNorm(const std::vector<Receiver> &receivers, const Eigen::Vector2d &position);
+
+    // Cramer-Rao bound of the position for i.i.d. TOA noise of unit variance, in closed form from the geometry:
+    // the inverse of sum_i (u_i - mean(u)) (u_i - mean(u))^T, with u_i the unit vector from receiver i to the
+    // position. O(N) and independent of the timestamps. Infinite when the geometry does not fix the position
+    // (e.g. collinear receivers)
+    Eigen::Matrix2d positionCovariance(const Eigen::Ref<const Eigen::Matrix2Xd> &positions,
+                                       const Eigen::Vector2d &position);
+
+    Eigen::Matrix2d positionCovariance(const std::vector<Receiver> &receivers, const Eigen::Vector2d &position);
+
+    // Same bound from the Gauss-Newton matrix J^T J of the all-pairs cost of n receivers, which is n times its
+    // inverse, e.g. the one a non-linear solver already evaluated at convergence
+    Eigen::Matrix2d covarianceFromGaussNewton(const Eigen::Matrix2d &gaussNewton, size_t n);
+}
+
+#endif //LIBTDOA_TDOASOLUTION_HH
@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#ifndef LIBTDOA_TDOATRACKER_HH
+#define LIBTDOA_TDOATRACKER_HH
+
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "Receiver.hh"
+#include "TdoaGeometry.hh"
+#include "TdoaLocator.hh"
+
+namespace tdoapp {
+    struct TrackerOptions {
+        double processNoise = 1.0;       // White acceleration spectral density (distance^2 / time^3)
+        double measurementSigma = 1.0;   // Standard deviation of every TOA (distance units)
+        double initialSpeedSigma = 10.0; // Velocity uncertainty when a track starts (distance / time)
+        // Normalized innovation squared, per degree of freedom, above which the fix is refined with NLLS
+        // instead of a plain EKF update. Its expected value is 1 when the track follows the model
+        double gate = 5.0;
+        NlsBackend backend = NlsBackend::Ceres;
+    };
+
+    struct TrackerUpdate {
+        Eigen::Vector2d position;
+        Eigen::Vector2d velocity;
+        double nis;   // Normalized innovation squared of the prediction (per degree of freedom), 0 on a new track
+        bool refined; // Whether the nonlinear refinement ran
+    };
+
+    // Extended Kalman filter tracking one emitter with a constant-velocity model over a static deployment.
+    // Measurements are the TDOAs against receiver 0; with independent TOA noise their covariance is
+    // sigma^2 (I + 1 1^T). Every update predicts the state and scores the TDOAs of the predicted position: while
+    // the innovation stays inside the gate only the cheap EKF update runs. Otherwise the nonlinear refinement is
+    // started from the prediction and its fix is fused as a position measurement.
+    class TdoaTracker {
+    public:
+        explicit TdoaTracker(const std::vector<Receiver> &receivers, const TrackerOptions &options = {});
+
+        // New TOAs, dt time units after the previous ones (ignored for the first update)
+        TrackerUpdate update(double dt, const Eigen::Ref<const Eigen::VectorXd> &toas);
+
+        bool initialized() const { return initialized_; }
+
+        // Starts a new track on the next update
+        void reset() { initialized_ = false; }
+
+        // [x, y, vx, vy] and its covariance
+        const Eigen::Vector4d &state() const { return x_; }
+
+        const Eigen::Matrix4d &covariance() const { return P_; }
+
+        const TdoaGeometry &geometry() const { return geometry_; }
+
+    private:
+        void predict(double dt);
+
+        // Predicted TDOAs of position p in h_ and their Jacobian in H_
+        void measure(const Eigen::Vector2d &p);
+
+        // Covariance of a position fix from the Fisher information of the TDOAs at p
+        Eigen::Matrix2d fixCovariance(const Eigen::Vector2d &p);
+
+        void fusePosition(const Eigen::Vector2d &fix, const Eigen::Matrix2d &covariance);
+
+        TdoaGeometry geometry_;
+        TrackerOptions options_;
+        Eigen::Matrix2Xd positions_;
+
+        bool initialized_ = false;
+        Eigen::Vector4d x_;
+        Eigen::Matrix4d P_;
+
+        // Workspace for the N - 1 TDOAs
+        Eigen::VectorXd z_, h_;
+        Eigen::MatrixX2d H_;
+        Eigen::MatrixXd S_;
+    };
+}
+
+#endif //LIBTDOA_TDOATRACKER_HH
@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#ifndef LIBTDOA_THREADPOOL_HH
+#define LIBTDOA_THREADPOOL_HH
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tdoapp {
+    // Persistent workers for data-parallel loops over independent items.
+    // parallelFor splits the range into one contiguous block per thread. Every thread takes chunks from the front
+    // of its own block and, once it runs dry, steals chunks from the blocks of the others, so uneven solve times
+    // are balanced without a shared queue. The calling thread takes part in the work.
+    class ThreadPool {
+    public:
+        // 0 uses all the hardware threads
+        explicit ThreadPool(unsigned threads = 0);
+
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        // Total number of threads working on a loop (including the caller)
+        unsigned size() const { return static_cast<unsigned>(ranges_.size()); }
+
+        // Runs fn(i) for every i in [0, n) and waits for all of them. The first exception thrown by fn is
+        // rethrown here once the loop has finished. Concurrent calls are serialized.
+        void parallelFor(size_t n, const std::function<void(size_t)> &fn, size_t grain = 1);
+
+    private:
+        struct alignas(64) Range {
+            std::atomic<size_t> next{0};
+            size_t end = 0;
+        };
+
+        void workerLoop(unsigned id);
+
+        void runChunks(unsigned id, const std::function<void(size_t)> &fn, size_t grain);
+
+        std::vector<Range> ranges_;
+        std::vector<std::thread> workers_;
+
+        std::mutex loopMutex_; // One parallelFor at a time
+        std::mutex mutex_;
+        std::condition_variable start_;
+        std::condition_variable done_;
+        const std::function<void(size_t)> *fn_ = nullptr;
+        size_t grain_ = 1;
+        unsigned long generation_ = 0;
+        unsigned pending_ = 0;
+        bool stop_ = false;
+        std::exception_ptr error_;
+    };
+}
+
+#endif //LIBTDOA_THREADPOOL_HH
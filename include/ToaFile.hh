@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#ifndef LIBTDOA_TOAFILE_HH
+#define LIBTDOA_TOAFILE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "Receiver.hh"
+
+namespace tdoapp {
+    // Binary TOA file for a static receiver deployment. All fields are little-endian and 8-byte aligned:
+    //
+    //   offset 0          char[4]        magic "TDOA"
+    //   offset 4          uint32         version (1)
+    //   offset 8          uint64         R, number of receivers
+    //   offset 16         uint64         N, number of measurements
+    //   offset 24         uint64         reserved (0)
+    //   offset 32         float64[R][2]  receiver positions (x, y)
+    //   offset 32 + 16R   float64[N][R]  TOA matrix, one row per measurement
+    constexpr char kToaFileMagic[4] = {'T', 'D', 'O', 'A'};
+    constexpr std::uint32_t kToaFileVersion = 1;
+    constexpr size_t kToaFileHeaderSize = 32;
+
+    using ToaMatrix = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+    // Whether the file at path starts with the TOA file magic
+    bool isToaFile(const std::string &path);
+
+    // Read-only memory mapping of a TOA file. Positions and TOAs are views on the mapping, so they stay valid as
+    // long as the ToaFile does and a row of toas() can be passed to TdoaGeometry without copying.
+    class ToaFile {
+    public:
+        // Throws std::runtime_error when the file can not be mapped or is not a valid TOA file
+        explicit ToaFile(const std::string &path);
+
+        ~ToaFile();
+
+        ToaFile(ToaFile &&other) noexcept;
+
+        ToaFile &operator=(ToaFile &&other) noexcept;
+
+        ToaFile(const ToaFile &) = delete;
+
+        ToaFile &operator=(const ToaFile &) = delete;
+
+        size_t receiverCount() const { return receiverCount_; }
+
+        size_t measurementCount() const { return measurementCount_; }
+
+        // 2xR receiver positions
+        Eigen::Map<const Eigen::Matrix2Xd> positions() const;
+
+        // NxR TOA values
+        Eigen::Map<const ToaMatrix> toas() const;
+
+        // Receivers with their positions (timestamps set to 0), e.g. to build a TdoaGeometry
+        std::vector<Receiver> receivers() const;
+
+    private:
+        void unmap();
+
+        void *data_ = nullptr;
+        size_t size_ = 0;
+        size_t receiverCount_ = 0;
+        size_t measurementCount_ = 0;
+    };
+
+    // Writes receiver positions and an NxR TOA matrix to path. Throws std::runtime_error on I/O errors
+    void writeToaFile(const std::string &path, const std::vector<Receiver> &receivers,
+                      const Eigen::Ref<const ToaMatrix> &toas);
+}
+
+#endif //LIBTDOA_TOAFILE_HH
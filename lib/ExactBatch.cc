@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "../include/ExactBatch.hh"
+#include "ExactBatchKernel.hh"
+
+namespace tdoapp {
+    namespace {
+        // One fix at a time, for the CPUs without vector units and the tail of a batch
+        struct ScalarLanes {
+            using V = double;
+            using M = bool;
+            static constexpr int width = 1;
+
+            static V load(const double *p) { return *p; }
+
+            static void store(double *p, V v) { *p = v; }
+
+            static V set1(double v) { return v; }
+
+            static V nan() { return std::numeric_limits<double>::quiet_NaN(); }
+
+            static V add(V a, V b) { return a + b; }
+
+            static V sub(V a, V b) { return a - b; }
+
+            static V mul(V a, V b) { return a * b; }
+
+            static V div(V a, V b) { return a / b; }
+
+            static V neg(V a) { return -a; }
+
+            static V sqrt(V a) { return std::sqrt(a); }
+
+            static M lt(V a, V b) { return a < b; }
+
+            static M gt(V a, V b) { return a > b; }
+
+            static M eq(V a, V b) { return a == b; }
+
+            static M unordered(V a, V b) { return std::isnan(a) || std::isnan(b); }
+
+            static M andMask(M a, M b) { return a && b; }
+
+            static M xorMask(M a, M b) { return a != b; }
+
+            static M notMask(M a) { return !a; }
+
+            static V select(M m, V a, V b) { return m ? a : b; }
+
+            static unsigned bits(M m) { return m ? 1u : 0u; }
+        };
+
+        bool cpuSupports(SimdLevel level) {
+#if defined(TDOAPP_X86_SIMD)
+            switch (level) {
+                case SimdLevel::Avx2:
+                    return __builtin_cpu_supports("avx2");
+                case SimdLevel::Avx512:
+                    return __builtin_cpu_supports("avx512f");
+                default:
+                    return true;
+            }
+#else
+            return level == SimdLevel::Scalar;
+#endif
+        }
+
+        SolutionStatus statusOf(unsigned char flags) {
+            using namespace detail;
+            if (flags & kInvalid) {
+                return SolutionStatus::InvalidInput;
+            }
+            if (!(flags & kRealRoots)) {
+                return SolutionStatus::NoRealSolution;
+            }
+            switch (flags & (kPositiveConsistent | kNegativeConsistent)) {
+                case kPositiveConsistent | kNegativeConsistent:
+                    return SolutionStatus::Ambiguous;
+                case 0:
+                    return SolutionStatus::NoConsistentRoot;
+                default:
+                    return SolutionStatus::Ok;
+            }
+        }
+    }
+
+    SimdLevel simdLevel() {
+        static const SimdLevel level = cpuSupports(SimdLevel::Avx512) ? SimdLevel::Avx512
+                                       : cpuSupports(SimdLevel::Avx2) ? SimdLevel::Avx2 : SimdLevel::Scalar;
+        return level;
+    }
+
+    const char *toString(SimdLevel level) {
+        switch (level) {
+            case SimdLevel::Avx2:
+                return "avx2";
+            case SimdLevel::Avx512:
+                return "avx512";
+            default:
+                return "scalar";
+        }
+    }
+
+    void ExactBatchColumns::push_back(const Receiver &r0, const Receiver &r1, const Receiver &r2) {
+        x0.push_back(r0.x);
+        y0.push_back(r0.y);
+        x1.push_back(r1.x);
+        y1.push_back(r1.y);
+        x2.push_back(r2.x);
+        y2.push_back(r2.y);
+        t0.push_back(r0.timestamp);
+        t1.push_back(r1.timestamp);
+        t2.push_back(r2.timestamp);
+    }
+
+    void ExactBatchColumns::clear() {
+        for (auto *column: {&x0, &y0, &x1, &y1, &x2, &y2, &t0, &t1, &t2}) {
+            column->clear();
+        }
+    }
+
+    void ExactBatchColumns::reserve(size_t n) {
+        for (auto *column: {&x0, &y0, &x1, &y1, &x2, &y2, &t0, &t1, &t2}) {
+            column->reserve(n);
+        }
+    }
+
+    void exactBatch(const ExactBatchColumns &columns, ExactBatchResult &result, bool getPositive) {
+        exactBatch(columns, result, getPositive, simdLevel());
+    }
+
+    void exactBatch(const ExactBatchColumns &columns, ExactBatchResult &result, bool getPositive, SimdLevel level) {
+        if (!cpuSupports(level)) {
+            throw std::invalid_argument(std::string{"Instruction set not available: "} + toString(level));
+        }
+
+        const size_t n = columns.size();
+        for (const auto *column: {&columns.x0, &columns.y0, &columns.x1, &columns.y1, &columns.x2, &columns.y2,
+                                  &columns.t1, &columns.t2}) {
+            if (column->size() != n) {
+                throw std::invalid_argument("All the columns of the batch must have the same size");
+            }
+        }
+
+        for (auto *column: {&result.x, &result.y, &result.xp, &result.yp, &result.xm, &result.ym}) {
+            column->resize(n);
+        }
+        std::vector<unsigned char> flags(n);
+
+        const detail::ExactLanesIn in{columns.x0.data(), columns.y0.data(), columns.x1.data(), columns.y1.data(),
+                                      columns.x2.data(), columns.y2.data(), columns.t0.data(), columns.t1.data(),
+                                      columns.t2.data()};
+        const detail::ExactLanesOut out{result.x.data(), result.y.data(), result.xp.data(), result.yp.data(),
+                                        result.xm.data(), result.ym.data(), flags.data()};
+
+        size_t done = 0;
+#if defined(TDOAPP_X86_SIMD)
+        if (level == SimdLevel::Avx512) {
+            done = detail::exactKernelAvx512(in, out, done, n, getPositive);
+        }
+        if (level == SimdLevel::Avx512 || level == SimdLevel::Avx2) {
+            done = detail::exactKernelAvx2(in, out, done, n, getPositive);
+        }
+#endif
+        detail::exactKernel<ScalarLanes>(in, out, done, n, getPositive);
+
+        // Non-finite inputs are rejected up front by exactSolution, whatever the arithmetic would give
+        result.status.resize(n);
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        for (size_t i = 0; i < n; i++) {
+            const bool finite = std::isfinite(columns.x0[i]) && std::isfinite(columns.y0[i]) &&
+                                std::isfinite(columns.x1[i]) && std::isfinite(columns.y1[i]) &&
+                                std::isfinite(columns.x2[i]) && std::isfinite(columns.y2[i]) &&
+                                std::isfinite(columns.t0[i]) && std::isfinite(columns.t1[i]) &&
+                                std::isfinite(columns.t2[i]);
+            if (!finite) {
+                result.x[i] = result.y[i] = result.xp[i] = result.yp[i] = result.xm[i] = result.ym[i] = nan;
+                flags[i] = detail::kInvalid;
+            }
+            result.status[i] = statusOf(flags[i]);
+        }
+    }
+}
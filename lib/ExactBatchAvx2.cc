@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+// Built with -mavx2: only called after checking the CPU at runtime
+
+#include <limits>
+
+#include <immintrin.h>
+
+#include "ExactBatchKernel.hh"
+
+namespace tdoapp {
+    namespace {
+        struct Avx2Lanes {
+            using V = __m256d;
+            using M = __m256d;
+            static constexpr int width = 4;
+
+            static V load(const double *p) { return _mm256_loadu_pd(p); }
+
+            static void store(double *p, V v) { _mm256_storeu_pd(p, v); }
+
+            static V set1(double v) { return _mm256_set1_pd(v); }
+
+            static V nan() { return _mm256_set1_pd(std::numeric_limits<double>::quiet_NaN()); }
+
+            static V add(V a, V b) { return _mm256_add_pd(a, b); }
+
+            static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+
+            static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+
+            static V div(V a, V b) { return _mm256_div_pd(a, b); }
+
+            static V neg(V a) { return _mm256_xor_pd(a, _mm256_set1_pd(-0.0)); }
+
+            static V sqrt(V a) { return _mm256_sqrt_pd(a); }
+
+            static M lt(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+
+            static M gt(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+
+            static M eq(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+
+            static M unordered(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_UNORD_Q); }
+
+            static M andMask(M a, M b) { return _mm256_and_pd(a, b); }
+
+            static M xorMask(M a, M b) { return _mm256_xor_pd(a, b); }
+
+            static M notMask(M a) { return _mm256_xor_pd(a, _mm256_castsi256_pd(_mm256_set1_epi64x(-1))); }
+
+            static V select(M m, V a, V b) { return _mm256_blendv_pd(b, a, m); }
+
+            static unsigned bits(M m) { return static_cast<unsigned>(_mm256_movemask_pd(m)); }
+        };
+    }
+
+    namespace detail {
+        size_t exactKernelAvx2(const ExactLanesIn &in, const ExactLanesOut &out, size_t begin, size_t end,
+                               bool getPositive) {
+            return exactKernel<Avx2Lanes>(in, out, begin, end, getPositive);
+        }
+    }
+}
@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+// Built with -mavx512f: only called after checking the CPU at runtime
+
+#include <limits>
+
+#include <immintrin.h>
+
+#include "ExactBatchKernel.hh"
+
+namespace tdoapp {
+    namespace {
+        struct Avx512Lanes {
+            using V = __m512d;
+            using M = __mmask8;
+            static constexpr int width = 8;
+
+            static V load(const double *p) { return _mm512_loadu_pd(p); }
+
+            static void store(double *p, V v) { _mm512_storeu_pd(p, v); }
+
+            static V set1(double v) { return _mm512_set1_pd(v); }
+
+            static V nan() { return _mm512_set1_pd(std::numeric_limits<double>::quiet_NaN()); }
+
+            static V add(V a, V b) { return _mm512_add_pd(a, b); }
+
+            static V sub(V a, V b) { return _mm512_sub_pd(a, b); }
+
+            static V mul(V a, V b) { return _mm512_mul_pd(a, b); }
+
+            static V div(V a, V b) { return _mm512_div_pd(a, b); }
+
+            // Sign flip as -a does (0 - a would turn -0 into +0). _mm512_xor_pd needs AVX512DQ
+            static V neg(V a) {
+                return _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(a),
+                                                            _mm512_set1_epi64(static_cast<long long>(1ull << 63))));
+            }
+
+            // Zero-masked over all lanes: _mm512_sqrt_pd passes an undefined source that GCC 12 warns about
+            static V sqrt(V a) { return _mm512_maskz_sqrt_pd(0xFF, a); }
+
+            static M lt(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+
+            static M gt(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+
+            static M eq(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+
+            static M unordered(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_UNORD_Q); }
+
+            static M andMask(M a, M b) { return static_cast<M>(a & b); }
+
+            static M xorMask(M a, M b) { return static_cast<M>(a ^ b); }
+
+            static M notMask(M a) { return static_cast<M>(~a); }
+
+            static V select(M m, V a, V b) { return _mm512_mask_blend_pd(m, b, a); }
+
+            static unsigned bits(M m) { return m; }
+        };
+    }
+
+    namespace detail {
+        size_t exactKernelAvx512(const ExactLanesIn &in, const ExactLanesOut &out, size_t begin, size_t end,
+                                 bool getPositive) {
+            return exactKernel<Avx512Lanes>(in, out, begin, end, getPositive);
+        }
+    }
+}
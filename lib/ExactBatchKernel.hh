@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#ifndef LIBTDOA_EXACTBATCHKERNEL_HH
+#define LIBTDOA_EXACTBATCHKERNEL_HH
+
+#include <cstddef>
+
+// Lane kernel of the batched exact solution, shared by the scalar, AVX2 and AVX-512 translation units. It is
+// instantiated with a set of vector traits in each of them, so it must not depend on anything else: an inline
+// function from another header compiled with -mavx2 could be picked by the linker for the whole library.
+//
+// The arithmetic is ExactFrame::solution operation by operation (same order, no fused multiply-add), which is what
+// makes every lane bit-identical to the scalar solver.
+
+namespace tdoapp {
+    namespace detail {
+        struct ExactLanesIn {
+            const double *x0, *y0, *x1, *y1, *x2, *y2;
+            const double *t0, *t1, *t2;
+        };
+
+        struct ExactLanesOut {
+            double *x, *y, *xp, *yp, *xm, *ym;
+            unsigned char *flags;
+        };
+
+        enum ExactFlags : unsigned char {
+            kPositiveConsistent = 1, // Positive arm agrees with the sign of tau_01
+            kNegativeConsistent = 2,
+            kRealRoots = 4,          // Non-negative discriminant
+            kInvalid = 8             // NaN discriminant
+        };
+
+        // Traits S provide: V (vector), M (mask), width, load, store, set1, nan, add, sub, mul, div, neg, sqrt, lt,
+        // gt, eq, unordered, andMask, xorMask, notMask, select(mask, a, b) and bits(mask) (one bit per lane)
+        template<typename S>
+        inline void exactLanes(const ExactLanesIn &in, const ExactLanesOut &out, size_t i, bool getPositive) {
+            using V = typename S::V;
+            using M = typename S::M;
+
+            const V x0 = S::load(in.x0 + i), y0 = S::load(in.y0 + i);
+            const V x1 = S::load(in.x1 + i), y1 = S::load(in.y1 + i);
+            const V x2 = S::load(in.x2 + i), y2 = S::load(in.y2 + i);
+            const V t0 = S::load(in.t0 + i);
+            const V zero = S::set1(0.0), one = S::set1(1.0), two = S::set1(2.0), four = S::set1(4.0);
+
+            // Frame with receiver 1 on the positive x axis: the rotation is the normalized baseline
+            const V dx = S::sub(x1, x0), dy = S::sub(y1, y0);
+            const V length = S::sqrt(S::add(S::mul(dx, dx), S::mul(dy, dy)));
+            const M degenerate = S::eq(length, zero);
+            const V c = S::select(degenerate, one, S::div(dx, length));
+            const V s = S::select(degenerate, zero, S::div(dy, length));
+            const V ms = S::neg(s);
+
+            const V b = S::add(S::mul(c, dx), S::mul(s, dy));
+            const V wx = S::sub(x2, x0), wy = S::sub(y2, y0);
+            const V cx = S::add(S::mul(c, wx), S::mul(s, wy));
+            const V cy = S::add(S::mul(ms, wx), S::mul(c, wy));
+            const V cc = S::sqrt(S::add(S::mul(cx, cx), S::mul(cy, cy)));
+
+            const V tau01 = S::sub(t0, S::load(in.t1 + i));
+            const V tau02 = S::sub(t0, S::load(in.t2 + i));
+
+            // Quadratic in x of the rotated frame
+            const V q = S::div(b, tau01);
+            const V k = S::sub(one, S::mul(q, q));
+            const V g = S::div(S::sub(S::mul(S::div(tau02, tau01), b), cx), cy);
+            const V h = S::div(S::add(S::sub(S::mul(cc, cc), S::mul(tau02, tau02)), S::mul(S::mul(tau01, tau02), k)),
+                               S::mul(two, cy));
+            const V d = S::neg(S::sub(S::add(one, S::mul(g, g)), S::mul(q, q)));
+            const V e = S::sub(S::mul(b, k), S::mul(S::mul(two, g), h));
+            const V f = S::sub(S::mul(S::div(S::mul(tau01, tau01), four), S::mul(k, k)), S::mul(h, h));
+            const V discriminant = S::sub(S::mul(e, e), S::mul(S::mul(four, d), f));
+
+            const M invalid = S::unordered(discriminant, discriminant);
+            const M real = S::notMask(S::lt(discriminant, zero));
+            const V root = S::sqrt(discriminant);
+            const V me = S::neg(e), d2 = S::mul(two, d);
+            const V xpr = S::div(S::add(me, root), d2), ypr = S::add(S::mul(g, xpr), h);
+            const V xmr = S::div(S::sub(me, root), d2), ymr = S::add(S::mul(g, xmr), h);
+
+            // Back to absolute coordinates
+            const V xp = S::add(S::add(S::mul(c, xpr), S::mul(ms, ypr)), x0);
+            const V yp = S::add(S::add(S::mul(s, xpr), S::mul(c, ypr)), y0);
+            const V xm = S::add(S::add(S::mul(c, xmr), S::mul(ms, ymr)), x0);
+            const V ym = S::add(S::add(S::mul(s, xmr), S::mul(c, ymr)), y0);
+
+            // sgn(|r - s0| - |r - s1|) == sgn(tau_01), as two mask comparisons
+            const M tauPositive = S::gt(tau01, zero), tauNegative = S::lt(tau01, zero);
+            auto consistent = [&](const V &x, const V &y) {
+                const V ax = S::sub(x, x0), ay = S::sub(y, y0);
+                const V bx = S::sub(x, x1), by = S::sub(y, y1);
+                const V n = S::sub(S::sqrt(S::add(S::mul(ax, ax), S::mul(ay, ay))),
+                                   S::sqrt(S::add(S::mul(bx, bx), S::mul(by, by))));
+                return S::andMask(S::notMask(S::xorMask(S::gt(n, zero), tauPositive)),
+                                  S::notMask(S::xorMask(S::lt(n, zero), tauNegative)));
+            };
+            const M valid = S::andMask(real, S::notMask(invalid));
+            const M positive = S::andMask(valid, consistent(xp, yp));
+            const M negative = S::andMask(valid, consistent(xm, ym));
+
+            // Positive arm unless only the negative one agrees, or both do and the negative one was requested
+            const M takePositive = getPositive ? positive : S::andMask(positive, S::notMask(negative));
+            const M takeNegative = S::andMask(negative, S::notMask(takePositive));
+            const V nan = S::nan();
+
+            S::store(out.x + i, S::select(takePositive, xp, S::select(takeNegative, xm, nan)));
+            S::store(out.y + i, S::select(takePositive, yp, S::select(takeNegative, ym, nan)));
+            S::store(out.xp + i, S::select(valid, xp, nan));
+            S::store(out.yp + i, S::select(valid, yp, nan));
+            S::store(out.xm + i, S::select(valid, xm, nan));
+            S::store(out.ym + i, S::select(valid, ym, nan));
+
+            const unsigned p = S::bits(positive), n = S::bits(negative), r = S::bits(real), v = S::bits(invalid);
+            for (int j = 0; j < S::width; j++) {
+                out.flags[i + j] = static_cast<unsigned char>(((p >> j) & 1u) * kPositiveConsistent |
+                                                              ((n >> j) & 1u) * kNegativeConsistent |
+                                                              ((r >> j) & 1u) * kRealRoots |
+                                                              ((v >> j) & 1u) * kInvalid);
+            }
+        }
+
+        // Runs the lanes of [begin, end) in steps of the vector width; returns where it stopped
+        template<typename S>
+        size_t exactKernel(const ExactLanesIn &in, const ExactLanesOut &out, size_t begin, size_t end,
+                           bool getPositive) {
+            size_t i = begin;
+            for (; i + S::width <= end; i += S::width) {
+                exactLanes<S>(in, out, i, getPositive);
+            }
+            return i;
+        }
+
+        // Vector entry points (ExactBatchAvx2.cc, ExactBatchAvx512.cc), only built on x86
+        size_t exactKernelAvx2(const ExactLanesIn &in, const ExactLanesOut &out, size_t begin, size_t end,
+                               bool getPositive);
+
+        size_t exactKernelAvx512(const ExactLanesIn &in, const ExactLanesOut &out, size_t begin, size_t end,
+                                 bool getPositive);
+    }
+}
+
+#endif //LIBTDOA_EXACTBATCHKERNEL_HH
@@ -0,0 +1,202 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "../include/Geodetic.hh"
+
+namespace tdoapp {
+    namespace {
+        constexpr double kEccentricity2 = kWgs84Flattening * (2.0 - kWgs84Flattening);
+        constexpr double kDegrees = 3.14159265358979323846 / 180.0; // Radians per degree
+
+        // Radius of curvature in the prime vertical
+        double primeVertical(double sinLatitude) {
+            return kWgs84SemiMajorAxis / std::sqrt(1.0 - kEccentricity2 * sinLatitude * sinLatitude);
+        }
+
+        bool validPosition(const GeodeticPosition &p) {
+            return std::isfinite(p.latitude) && std::isfinite(p.longitude) && std::isfinite(p.altitude) &&
+                   std::abs(p.latitude) <= 90.0;
+        }
+
+        // Mean of the ECEF positions back on the ellipsoid, so that it is also right across the antimeridian, at
+        // the mean altitude
+        GeodeticPosition centroid(const GeodeticMeasurement &receivers) {
+            Eigen::Vector3d ecef = Eigen::Vector3d::Zero();
+            double altitude = 0.0;
+            for (const auto &r: receivers) {
+                ecef += toEcef(r.position());
+                altitude += r.altitude;
+            }
+            auto origin = fromEcef(ecef / static_cast<double>(receivers.size()));
+            origin.altitude = altitude / static_cast<double>(receivers.size());
+            return origin;
+        }
+
+        const GeodeticMeasurement &checked(const GeodeticMeasurement &receivers) {
+            if (receivers.size() < 3) {
+                throw std::invalid_argument("A receiver set needs at least 3 receivers");
+            }
+            for (const auto &r: receivers) {
+                if (!validPosition(r.position())) {
+                    throw std::invalid_argument("Receiver coordinates must be finite, with latitudes within 90 "
+                                                "degrees");
+                }
+            }
+            return receivers;
+        }
+    }
+
+    Eigen::Vector3d toEcef(const GeodeticPosition &position) {
+        const double latitude = position.latitude * kDegrees;
+        const double longitude = position.longitude * kDegrees;
+        const double n = primeVertical(std::sin(latitude));
+        const double horizontal = (n + position.altitude) * std::cos(latitude);
+        return {horizontal * std::cos(longitude), horizontal * std::sin(longitude),
+                (n * (1.0 - kEccentricity2) + position.altitude) * std::sin(latitude)};
+    }
+
+    GeodeticPosition fromEcef(const Eigen::Vector3d &ecef) {
+        // Fixed-point iteration on the latitude; every step gains about two orders of magnitude near the surface
+        const double p = std::hypot(ecef[0], ecef[1]);
+        double latitude = std::atan2(ecef[2], p * (1.0 - kEccentricity2));
+        double altitude = 0.0;
+        for (int i = 0; i < 6; i++) {
+            const double sinLatitude = std::sin(latitude);
+            const double n = primeVertical(sinLatitude);
+            // Valid at the poles too, where p / cos(latitude) is not
+            altitude = p * std::cos(latitude) + (ecef[2] + kEccentricity2 * n * sinLatitude) * sinLatitude - n;
+            latitude = std::atan2(ecef[2], p * (1.0 - kEccentricity2 * n / (n + altitude)));
+        }
+        return {latitude / kDegrees, std::atan2(ecef[1], ecef[0]) / kDegrees, altitude};
+    }
+
+    EnuFrame::EnuFrame(const GeodeticPosition &origin) : origin_{origin}, originEcef_{toEcef(origin)} {
+        const double sinLatitude = std::sin(origin.latitude * kDegrees);
+        const double cosLatitude = std::cos(origin.latitude * kDegrees);
+        const double sinLongitude = std::sin(origin.longitude * kDegrees);
+        const double cosLongitude = std::cos(origin.longitude * kDegrees);
+        rotation_ << -sinLongitude, cosLongitude, 0.0,
+                -sinLatitude * cosLongitude, -sinLatitude * sinLongitude, cosLatitude,
+                cosLatitude * cosLongitude, cosLatitude * sinLongitude, sinLatitude;
+    }
+
+    Eigen::Vector3d EnuFrame::toEnu(const GeodeticPosition &position) const {
+        return rotation_ * (toEcef(position) - originEcef_);
+    }
+
+    GeodeticPosition EnuFrame::toGeodetic(const Eigen::Vector3d &enu) const {
+        return fromEcef(originEcef_ + rotation_.transpose() * enu);
+    }
+
+    std::uint64_t geometryHash(const GeodeticMeasurement &receivers) {
+        // FNV-1a over the bits of the coordinates
+        std::uint64_t hash = 14695981039346656037ull;
+        auto mix = [&hash](double value) {
+            std::uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            for (int byte = 0; byte < 8; byte++) {
+                hash = (hash ^ ((bits >> (8 * byte)) & 0xff)) * 1099511628211ull;
+            }
+        };
+        for (const auto &r: receivers) {
+            mix(r.latitude);
+            mix(r.longitude);
+            mix(r.altitude);
+        }
+        return hash;
+    }
+
+    GeodeticProjection::GeodeticProjection(const GeodeticMeasurement &receivers)
+            : geodetic_{checked(receivers)}, frame_{centroid(receivers)}, hash_{geometryHash(receivers)} {
+        receivers_.reserve(receivers.size());
+        for (auto &r: geodetic_) {
+            const Eigen::Vector3d enu = frame_.toEnu(r.position());
+            receivers_.emplace_back(enu[0], enu[1]);
+            up_ += enu[2];
+            r.timestamp = 0.0;
+        }
+        up_ /= static_cast<double>(receivers.size());
+    }
+
+    std::vector<Receiver> GeodeticProjection::project(const GeodeticMeasurement &receivers) const {
+        if (receivers.size() != receivers_.size()) {
+            throw std::invalid_argument("The measurement does not have the receivers of the projection");
+        }
+        auto result = receivers_;
+        for (size_t i = 0; i < result.size(); i++) {
+            result[i].timestamp = receivers[i].timestamp;
+        }
+        return result;
+    }
+
+    GeodeticPosition GeodeticProjection::toGeodetic(const Eigen::Vector2d &position) const {
+        if (!position.allFinite()) {
+            const double nan = std::numeric_limits<double>::quiet_NaN();
+            return {nan, nan, nan};
+        }
+        return frame_.toGeodetic({position[0], position[1], up_});
+    }
+
+    bool GeodeticProjection::matches(const GeodeticMeasurement &receivers) const {
+        return std::equal(receivers.begin(), receivers.end(), geodetic_.begin(), geodetic_.end(),
+                          [](const GeodeticReceiver &a, const GeodeticReceiver &b) {
+                              return a.latitude == b.latitude && a.longitude == b.longitude &&
+                                     a.altitude == b.altitude;
+                          });
+    }
+
+    GeodeticCache::GeodeticCache(size_t capacity) : capacity_{std::max<size_t>(capacity, 1)} {}
+
+    std::shared_ptr<const GeodeticProjection> GeodeticCache::projection(const GeodeticMeasurement &receivers) {
+        const auto hash = geometryHash(receivers);
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            auto found = byHash_.find(hash);
+            if (found != byHash_.end() && (*found->second)->matches(receivers)) {
+                entries_.splice(entries_.begin(), entries_, found->second);
+                hits_++;
+                return entries_.front();
+            }
+            misses_++;
+        }
+
+        // Built outside the lock, so that other threads keep hitting the cache meanwhile
+        auto projection = std::make_shared<const GeodeticProjection>(receivers);
+
+        std::lock_guard<std::mutex> lock{mutex_};
+        auto found = byHash_.find(hash);
+        if (found != byHash_.end()) {
+            entries_.erase(found->second);
+            byHash_.erase(found);
+        }
+        entries_.push_front(projection);
+        byHash_[hash] = entries_.begin();
+        if (entries_.size() > capacity_) {
+            byHash_.erase(entries_.back()->hash());
+            entries_.pop_back();
+        }
+        return projection;
+    }
+
+    size_t GeodeticCache::size() const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return entries_.size();
+    }
+
+    size_t GeodeticCache::hits() const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return hits_;
+    }
+
+    size_t GeodeticCache::misses() const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return misses_;
+    }
+}
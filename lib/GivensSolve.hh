@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#ifndef LIBTDOA_GIVENSSOLVE_HH
+#define LIBTDOA_GIVENSSOLVE_HH
+
+#include <cmath>
+
+#include <Eigen/Dense>
+
+// Row-by-row QR of the linear TDOA systems, shared by linearTDOA (TdoaLocator.cc) and the fallback of TdoaGeometry
+// (TdoaGeometry.cc). Internal: not installed with the public headers.
+
+namespace tdoapp {
+    namespace detail {
+        // Every row of [A | b] is rotated into the triangular factor R and Q^T b as soon as it is built. Solving
+        // R x = Q^T b is equivalent to the full problem since Q is orthogonal, and so is the SVD of R: A and R
+        // share singular values and right singular vectors
+        template<int U>
+        struct GivensTriangle {
+            Eigen::Matrix<double, U, U> R = Eigen::Matrix<double, U, U>::Zero();
+            Eigen::Matrix<double, U, 1> qtb = Eigen::Matrix<double, U, 1>::Zero();
+
+            void add(Eigen::Matrix<double, 1, U> row, double rhs) {
+                for (int k = 0; k < U; k++) {
+                    if (row[k] == 0.0) {
+                        continue;
+                    }
+                    // Plain sqrt: std::hypot guards against overflow we cannot reach here and dominates the cost
+                    const double r = std::sqrt(R(k, k) * R(k, k) + row[k] * row[k]);
+                    const double c = R(k, k) / r;
+                    const double s = row[k] / r;
+                    for (int j = k; j < U; j++) {
+                        const double rkj = R(k, j);
+                        R(k, j) = c * rkj + s * row[j];
+                        row[j] = -s * rkj + c * row[j];
+                    }
+                    const double q = qtb[k];
+                    qtb[k] = c * q + s * rhs;
+                    rhs = -s * q + c * rhs;
+                }
+            }
+
+            // Minimum-norm solution, also for a (nearly) rank-deficient R
+            Eigen::Matrix<double, U, 1> svdSolve() const {
+                return Eigen::JacobiSVD<Eigen::Matrix<double, U, U>>(R, Eigen::ComputeFullU | Eigen::ComputeFullV)
+                        .solve(qtb);
+            }
+        };
+    }
+}
+
+#endif //LIBTDOA_GIVENSSOLVE_HH
@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "../include/GridInitializer.hh"
+
+namespace tdoapp {
+    namespace {
+        constexpr int kRefineResolution = 9; // Odd, so the previous best point is on the finer grid
+
+        // TDOA cost of many points at once. Offsets are taken against receiver 0, which keeps the accumulated
+        // values small near the solution
+        class CostField {
+        public:
+            explicit CostField(const std::vector<Receiver> &receivers) : receivers_{receivers} {}
+
+            void evaluate(const Eigen::ArrayXd &xs, const Eigen::ArrayXd &ys, Eigen::ArrayXd &cost) {
+                const auto &r0 = receivers_[0];
+                d0_ = ((xs - r0.x).square() + (ys - r0.y).square()).sqrt();
+                sum_.setZero(xs.size());
+                cost.setZero(xs.size());
+                for (size_t i = 1; i < receivers_.size(); i++) {
+                    const auto &ri = receivers_[i];
+                    offset_ = (ri.timestamp - r0.timestamp) -
+                              (((xs - ri.x).square() + (ys - ri.y).square()).sqrt() - d0_);
+                    sum_ += offset_;
+                    cost += offset_.square();
+                }
+                cost -= sum_.square() / static_cast<double>(receivers_.size());
+            }
+
+        private:
+            const std::vector<Receiver> &receivers_;
+            Eigen::ArrayXd d0_, sum_, offset_;
+        };
+
+        // size x size points centered at (cx, cy), spaced by step, row-major
+        void fillGrid(double cx, double cy, double step, int size, Eigen::ArrayXd &xs, Eigen::ArrayXd &ys) {
+            const double start = -0.5 * (size - 1) * step;
+            xs.resize(size * size);
+            ys.resize(size * size);
+            for (int j = 0; j < size; j++) {
+                for (int i = 0; i < size; i++) {
+                    xs[j * size + i] = cx + start + i * step;
+                    ys[j * size + i] = cy + start + j * step;
+                }
+            }
+        }
+
+        bool finiteReceivers(const std::vector<Receiver> &receivers) {
+            return std::all_of(receivers.begin(), receivers.end(), [](const Receiver &r) {
+                return std::isfinite(r.x) && std::isfinite(r.y) && std::isfinite(r.timestamp);
+            });
+        }
+    }
+
+    std::vector<GridCandidate> gridCandidates(const std::vector<Receiver> &receivers, const GridOptions &options) {
+        if (receivers.size() < 3 || !finiteReceivers(receivers) || options.resolution < 3) {
+            return {};
+        }
+
+        // Square coarse grid over the grown bounding box
+        Eigen::Vector2d low = receivers[0].position(), high = low;
+        for (const auto &r: receivers) {
+            low = low.cwiseMin(r.position());
+            high = high.cwiseMax(r.position());
+        }
+        const double side = std::max((high - low).maxCoeff(), std::numeric_limits<double>::min()) *
+                            (1.0 + 2.0 * options.margin);
+        const int n = options.resolution;
+        double step = side / (n - 1);
+        const Eigen::Vector2d center = 0.5 * (low + high);
+
+        CostField field{receivers};
+        Eigen::ArrayXd xs, ys, cost;
+        fillGrid(center[0], center[1], step, n, xs, ys);
+        field.evaluate(xs, ys, cost);
+
+        // Local minima over the 8 neighbours, lowest first
+        std::vector<std::pair<double, int>> minima;
+        for (int j = 0; j < n; j++) {
+            for (int i = 0; i < n; i++) {
+                const double c = cost[j * n + i];
+                bool minimum = true;
+                for (int dj = -1; dj <= 1 && minimum; dj++) {
+                    for (int di = -1; di <= 1 && minimum; di++) {
+                        const int ni = i + di, nj = j + dj;
+                        if ((di || dj) && ni >= 0 && ni < n && nj >= 0 && nj < n) {
+                            minimum = c <= cost[nj * n + ni];
+                        }
+                    }
+                }
+                if (minimum) {
+                    minima.emplace_back(c, j * n + i);
+                }
+            }
+        }
+        std::sort(minima.begin(), minima.end());
+        minima.resize(std::min(minima.size(), static_cast<size_t>(std::max(options.candidates, 1))));
+
+        // Zoom on every candidate: the finer grid spans the cells around the previous best point
+        std::vector<GridCandidate> refined;
+        Eigen::ArrayXd fx, fy, fc;
+        for (const auto &[c, index]: minima) {
+            Eigen::Vector2d best{xs[index], ys[index]};
+            double bestCost = c;
+            double levelStep = step;
+            for (int level = 0; level < options.levels; level++) {
+                levelStep *= 2.0 / (kRefineResolution - 1);
+                fillGrid(best[0], best[1], levelStep, kRefineResolution, fx, fy);
+                field.evaluate(fx, fy, fc);
+                Eigen::Index k;
+                bestCost = fc.minCoeff(&k);
+                best = {fx[k], fy[k]};
+            }
+            refined.push_back({best, bestCost});
+        }
+        std::stable_sort(refined.begin(), refined.end(),
+                         [](const GridCandidate &a, const GridCandidate &b) { return a.cost < b.cost; });
+        return refined;
+    }
+
+    TdoaSolution multiStartSolution(const std::vector<Receiver> &receivers, const GridOptions &options) {
+        TdoaSolution best;
+        best.method = SolutionMethod::NonlinearLeastSquares;
+        if (receivers.size() < 3) {
+            best.status = SolutionStatus::NotEnoughReceivers;
+            return best;
+        }
+
+        const auto candidates = gridCandidates(receivers, options);
+        if (candidates.empty()) {
+            return best;
+        }
+
+        int iterations = 0;
+        for (size_t i = 0; i < candidates.size(); i++) {
+            if (i > 0 && candidates[i].cost > options.ambiguity * candidates[0].cost) {
+                break;
+            }
+            auto solution = nonlinearSolution(receivers, candidates[i].position, options.backend);
+            iterations += solution.iterations;
+            if (i == 0 || (solution.usable() && (!best.usable() || solution.residualNorm < best.residualNorm))) {
+                best = solution;
+            }
+        }
+        best.iterations = iterations;
+        return best;
+    }
+}
@@ -0,0 +1,245 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "../include/LocateCodec.hh"
+
+namespace tdoapp {
+    namespace {
+        constexpr size_t kRequestHeaderSize = 32;
+        constexpr size_t kResponseHeaderSize = 24;
+
+        void checkEndianness() {
+            const std::uint16_t one = 1;
+            unsigned char first;
+            std::memcpy(&first, &one, 1);
+            if (first != 1) {
+                throw std::runtime_error("The binary localization encoding is only supported on little-endian hosts");
+            }
+        }
+
+        template<typename T>
+        T readField(std::string_view data, size_t offset) {
+            T value;
+            std::memcpy(&value, data.data() + offset, sizeof(T));
+            return value;
+        }
+
+        template<typename T>
+        void writeField(std::string &out, size_t offset, T value) {
+            std::memcpy(&out[offset], &value, sizeof(T));
+        }
+
+        size_t padded(size_t length) { return (length + 7) / 8 * 8; }
+
+        // Number of float64 values of a payload, or throws when the sizes overflow or do not match the data length.
+        // Columns are never 0, so the rows are bounded by the length of the data
+        size_t payloadValues(std::string_view data, size_t offset, std::uint64_t rows, std::uint64_t columns) {
+            const size_t available = (data.size() - offset) / sizeof(double);
+            if ((data.size() - offset) % sizeof(double) != 0 || rows > available / columns ||
+                rows * columns != available) {
+                throw std::invalid_argument("The size of the data does not match its header");
+            }
+            return available;
+        }
+
+        std::string header(const char (&magic)[4], int method, std::uint32_t flags, size_t size) {
+            std::string out(size, '\0');
+            std::memcpy(&out[0], magic, sizeof(magic));
+            writeField(out, 4, kLocateCodecVersion);
+            writeField(out, 8, static_cast<std::uint32_t>(method));
+            writeField(out, 12, flags);
+            return out;
+        }
+    }
+
+    LocateRequest decodeLocateRequest(std::string_view data) {
+        checkEndianness();
+        if (data.size() < kRequestHeaderSize ||
+            std::memcmp(data.data(), kLocateRequestMagic, sizeof(kLocateRequestMagic)) != 0) {
+            throw std::invalid_argument("Not a binary localization request");
+        }
+        if (readField<std::uint32_t>(data, 4) != kLocateCodecVersion) {
+            throw std::invalid_argument("Unsupported binary localization request version");
+        }
+
+        LocateRequest request;
+        request.method = static_cast<int>(readField<std::uint32_t>(data, 8));
+        request.flags = readField<std::uint32_t>(data, 12);
+        if ((request.flags & ~(kLocateGeodetic | kLocateReceiverSet)) != 0 ||
+            (request.flags & kLocateGeodetic && request.flags & kLocateReceiverSet)) {
+            throw std::invalid_argument("Unsupported binary localization request flags");
+        }
+        const auto receivers = readField<std::uint64_t>(data, 16);
+        const auto count = readField<std::uint64_t>(data, 24);
+        if (receivers < 3) {
+            throw std::invalid_argument("Every measurement needs at least 3 receivers");
+        }
+        if (receivers > std::numeric_limits<std::uint32_t>::max()) {
+            throw std::invalid_argument("The size of the data does not match its header");
+        }
+
+        size_t offset = kRequestHeaderSize;
+        std::uint64_t columns = receivers * (request.flags & kLocateGeodetic ? 4 : 3);
+        if (request.flags & kLocateReceiverSet) {
+            if (data.size() < offset + sizeof(std::uint64_t)) {
+                throw std::invalid_argument("The size of the data does not match its header");
+            }
+            const auto length = readField<std::uint64_t>(data, offset);
+            offset += sizeof(std::uint64_t);
+            if (length > data.size() - offset || padded(length) > data.size() - offset) {
+                throw std::invalid_argument("The size of the data does not match its header");
+            }
+            request.set.assign(data.data() + offset, length);
+            offset += padded(length);
+            columns = receivers;
+        }
+        const size_t values = payloadValues(data, offset, count, columns);
+
+        // Copied value by value: the payload offset is only aligned to 8 bytes within the data
+        const char *payload = data.data() + offset;
+        auto value = [payload](size_t i) {
+            double v;
+            std::memcpy(&v, payload + i * sizeof(double), sizeof(double));
+            if (!std::isfinite(v)) {
+                throw std::invalid_argument("Binary localization requests must only contain finite values");
+            }
+            return v;
+        };
+
+        if (request.flags & kLocateReceiverSet) {
+            request.toas.resize(static_cast<Eigen::Index>(count), static_cast<Eigen::Index>(receivers));
+            for (size_t i = 0; i < values; i++) {
+                request.toas.data()[i] = value(i);
+            }
+        } else if (request.flags & kLocateGeodetic) {
+            request.geodetic.resize(count);
+            size_t i = 0;
+            for (auto &measurement: request.geodetic) {
+                measurement.reserve(receivers);
+                for (std::uint64_t r = 0; r < receivers; r++, i += 4) {
+                    measurement.push_back({value(i), value(i + 1), value(i + 2), value(i + 3)});
+                }
+            }
+        } else {
+            request.measurements.resize(count);
+            size_t i = 0;
+            for (auto &measurement: request.measurements) {
+                measurement.reserve(receivers);
+                for (std::uint64_t r = 0; r < receivers; r++, i += 3) {
+                    measurement.emplace_back(value(i), value(i + 1), value(i + 2));
+                }
+            }
+        }
+        return request;
+    }
+
+    std::string encodeLocateRequest(const LocateRequest &request) {
+        checkEndianness();
+        size_t receivers = 0;
+        size_t count = 0;
+        std::vector<double> values;
+        if (request.flags & kLocateReceiverSet) {
+            receivers = static_cast<size_t>(request.toas.cols());
+            count = static_cast<size_t>(request.toas.rows());
+            values.assign(request.toas.data(), request.toas.data() + request.toas.size());
+        } else if (request.flags & kLocateGeodetic) {
+            count = request.geodetic.size();
+            receivers = count ? request.geodetic.front().size() : 0;
+            for (const auto &measurement: request.geodetic) {
+                if (measurement.size() != receivers) {
+                    throw std::invalid_argument("All the measurements of a request must have the same receivers");
+                }
+                for (const auto &r: measurement) {
+                    values.insert(values.end(), {r.latitude, r.longitude, r.altitude, r.timestamp});
+                }
+            }
+        } else {
+            count = request.measurements.size();
+            receivers = count ? request.measurements.front().size() : 0;
+            for (const auto &measurement: request.measurements) {
+                if (measurement.size() != receivers) {
+                    throw std::invalid_argument("All the measurements of a request must have the same receivers");
+                }
+                for (const auto &r: measurement) {
+                    values.insert(values.end(), {r.x, r.y, r.timestamp});
+                }
+            }
+        }
+
+        if (receivers < 3) {
+            throw std::invalid_argument("Every measurement needs at least 3 receivers");
+        }
+        const size_t id = request.flags & kLocateReceiverSet ? sizeof(std::uint64_t) + padded(request.set.size()) : 0;
+        auto out = header(kLocateRequestMagic, request.method, request.flags,
+                          kRequestHeaderSize + id + values.size() * sizeof(double));
+        writeField(out, 16, static_cast<std::uint64_t>(receivers));
+        writeField(out, 24, static_cast<std::uint64_t>(count));
+        if (id) {
+            writeField(out, kRequestHeaderSize, static_cast<std::uint64_t>(request.set.size()));
+            std::memcpy(&out[kRequestHeaderSize + sizeof(std::uint64_t)], request.set.data(), request.set.size());
+        }
+        if (!values.empty()) {
+            std::memcpy(&out[kRequestHeaderSize + id], values.data(), values.size() * sizeof(double));
+        }
+        return out;
+    }
+
+    std::string encodeLocateResponse(int method, const std::vector<Eigen::Vector2d> &positions) {
+        checkEndianness();
+        auto out = header(kLocateResponseMagic, method, 0, kResponseHeaderSize + positions.size() * 2 * sizeof(double));
+        writeField(out, 16, static_cast<std::uint64_t>(positions.size()));
+        size_t offset = kResponseHeaderSize;
+        for (const auto &p: positions) {
+            writeField(out, offset, p[0]);
+            writeField(out, offset + sizeof(double), p[1]);
+            offset += 2 * sizeof(double);
+        }
+        return out;
+    }
+
+    std::string encodeLocateResponse(int method, const std::vector<GeodeticPosition> &positions) {
+        checkEndianness();
+        auto out = header(kLocateResponseMagic, method, kLocateGeodetic,
+                          kResponseHeaderSize + positions.size() * 3 * sizeof(double));
+        writeField(out, 16, static_cast<std::uint64_t>(positions.size()));
+        size_t offset = kResponseHeaderSize;
+        for (const auto &p: positions) {
+            writeField(out, offset, p.latitude);
+            writeField(out, offset + sizeof(double), p.longitude);
+            writeField(out, offset + 2 * sizeof(double), p.altitude);
+            offset += 3 * sizeof(double);
+        }
+        return out;
+    }
+
+    Eigen::MatrixXd decodeLocateResponse(std::string_view data, int *method, bool *geodetic) {
+        checkEndianness();
+        if (data.size() < kResponseHeaderSize ||
+            std::memcmp(data.data(), kLocateResponseMagic, sizeof(kLocateResponseMagic)) != 0 ||
+            readField<std::uint32_t>(data, 4) != kLocateCodecVersion) {
+            throw std::invalid_argument("Not a binary localization response");
+        }
+        const bool isGeodetic = readField<std::uint32_t>(data, 12) & kLocateGeodetic;
+        const auto count = readField<std::uint64_t>(data, 16);
+        const Eigen::Index rows = isGeodetic ? 3 : 2;
+        payloadValues(data, kResponseHeaderSize, count, static_cast<std::uint64_t>(rows));
+
+        Eigen::MatrixXd positions(rows, static_cast<Eigen::Index>(count));
+        if (count) {
+            std::memcpy(positions.data(), data.data() + kResponseHeaderSize, positions.size() * sizeof(double));
+        }
+        if (method) {
+            *method = static_cast<int>(readField<std::uint32_t>(data, 8));
+        }
+        if (geodetic) {
+            *geodetic = isGeodetic;
+        }
+        return positions;
+    }
+}
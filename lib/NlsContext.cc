@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+#include <stdexcept>
+
+#include "../include/NlsContext.hh"
+
+namespace tdoapp {
+    ceres::Solver::Options ceresOptions(const NlsOptions &options) {
+        ceres::Solver::Options solverOptions;
+        solverOptions.linear_solver_type = ceres::DENSE_QR;
+        solverOptions.max_num_iterations = options.maxIterations;
+        solverOptions.function_tolerance = options.functionTolerance;
+        solverOptions.gradient_tolerance = options.gradientTolerance;
+        solverOptions.parameter_tolerance = options.parameterTolerance;
+        solverOptions.num_threads = 1;
+        solverOptions.minimizer_progress_to_stdout = false;
+        solverOptions.logging_type = ceres::SILENT;
+        return solverOptions;
+    }
+
+    NlsContext::NlsContext(const std::vector<Receiver> &receivers, const NlsOptions &options)
+            : geometry_{receivers},
+              solverOptions_{ceresOptions(options)},
+              cost_{new TdoaCostFunction(receivers, options.topology)},
+              warmStart_{options.warmStart} {
+        problem_.AddResidualBlock(cost_, nullptr, xy_);
+    }
+
+    Eigen::Vector2d NlsContext::solve(const Eigen::Ref<const Eigen::VectorXd> &timestamps) {
+        if (warmStart_ && hasFix_) {
+            return solve(timestamps, Eigen::Vector2d{xy_[0], xy_[1]});
+        }
+        return solve(timestamps, geometry_.initialGuess(timestamps));
+    }
+
+    Eigen::Vector2d NlsContext::solve(const Eigen::Ref<const Eigen::VectorXd> &timestamps,
+                                      const Eigen::Vector2d &initialGuess) {
+        if (static_cast<size_t>(timestamps.size()) != geometry_.size()) {
+            throw std::invalid_argument("Number of timestamps does not match the number of receivers");
+        }
+
+        cost_->setTimestamps(timestamps);
+        xy_[0] = initialGuess[0];
+        xy_[1] = initialGuess[1];
+
+        ceres::Solve(solverOptions_, &problem_, &summary_);
+        hasFix_ = summary_.IsSolutionUsable();
+
+        return Eigen::Vector2d{xy_[0], xy_[1]};
+    }
+}
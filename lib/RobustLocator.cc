@@ -0,0 +1,256 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include "../include/RobustLocator.hh"
+#include "../include/TdoaGeometry.hh"
+
+namespace tdoapp {
+    namespace {
+        using Clock = std::chrono::steady_clock;
+        using Triple = std::array<size_t, 3>;
+
+        struct Score {
+            Triple triple{};
+            Eigen::Vector2d position;
+            double offset = 0.0; // Emission time (plus clock offset) implied by the triple
+            double cost = std::numeric_limits<double>::infinity();
+            size_t inliers = 0;
+        };
+
+        // Receivers as separate coordinate arrays, so the residuals of a candidate against all of them are
+        // element-wise array expressions
+        class Consensus {
+        public:
+            Consensus(const std::vector<Receiver> &receivers, double threshold)
+                    : receivers_{receivers}, threshold2_{threshold * threshold} {
+                const auto n = static_cast<Eigen::Index>(receivers.size());
+                xs_.resize(n);
+                ys_.resize(n);
+                toas_.resize(n);
+                for (Eigen::Index i = 0; i < n; i++) {
+                    xs_[i] = receivers[i].x;
+                    ys_[i] = receivers[i].y;
+                    toas_[i] = receivers[i].timestamp;
+                }
+            }
+
+            // (t_i - |p - s_i| - offset)^2, lazily evaluated
+            auto squaredResiduals(const Eigen::Vector2d &p, double offset) const {
+                return (toas_ - ((xs_ - p[0]).square() + (ys_ - p[1]).square()).sqrt() - offset).square();
+            }
+
+            // Best of the (up to two) candidates of a triple
+            Score score(const Triple &t) const {
+                Score best;
+                best.triple = t;
+
+                const auto &r0 = receivers_[t[0]], &r1 = receivers_[t[1]], &r2 = receivers_[t[2]];
+                const auto exact = ExactFrame{r0, r1, r2}.solution(r0.timestamp - r1.timestamp,
+                                                                   r0.timestamp - r2.timestamp);
+                if (!exact.usable()) {
+                    return best;
+                }
+
+                const int candidates = exact.status == SolutionStatus::Ambiguous ? 2 : 1;
+                for (int c = 0; c < candidates; c++) {
+                    const Eigen::Vector2d p = candidates == 2 ? exact.roots[c] : exact.position;
+                    double offset = 0.0;
+                    for (auto i: t) {
+                        offset += receivers_[i].timestamp - (receivers_[i].position() - p).norm();
+                    }
+                    offset /= 3.0;
+
+                    const auto r2 = squaredResiduals(p, offset);
+                    const double cost = r2.min(threshold2_).sum();
+                    if (cost < best.cost) {
+                        best.position = p;
+                        best.offset = offset;
+                        best.cost = cost;
+                        best.inliers = static_cast<size_t>((r2 <= threshold2_).count());
+                    }
+                }
+                return best;
+            }
+
+            std::vector<bool> inliers(const Score &score) const {
+                const Eigen::ArrayXd r2 = squaredResiduals(score.position, score.offset);
+                std::vector<bool> result(receivers_.size());
+                for (size_t i = 0; i < result.size(); i++) {
+                    result[i] = r2[static_cast<Eigen::Index>(i)] <= threshold2_;
+                }
+                // The triple defines the candidate, whatever the rounding
+                for (auto i: score.triple) {
+                    result[i] = true;
+                }
+                return result;
+            }
+
+        private:
+            const std::vector<Receiver> &receivers_;
+            const double threshold2_;
+            Eigen::ArrayXd xs_, ys_, toas_;
+        };
+
+        // Random triples, or every triple in random order when there are not more than the hypothesis limit
+        class TripleSampler {
+        public:
+            TripleSampler(size_t n, size_t limit, unsigned seed) : n_{n}, rng_{seed} {
+                if (n * (n - 1) * (n - 2) / 6 <= limit) {
+                    for (size_t i = 0; i < n; i++) {
+                        for (size_t j = i + 1; j < n; j++) {
+                            for (size_t k = j + 1; k < n; k++) {
+                                all_.push_back({i, j, k});
+                            }
+                        }
+                    }
+                    std::shuffle(all_.begin(), all_.end(), rng_);
+                    limit_ = all_.size();
+                } else {
+                    limit_ = limit;
+                }
+            }
+
+            size_t limit() const { return limit_; }
+
+            Triple operator()(size_t h) {
+                if (!all_.empty()) {
+                    return all_[h];
+                }
+                std::uniform_int_distribution<size_t> pick{0, n_ - 1};
+                Triple t{pick(rng_), 0, 0};
+                do {
+                    t[1] = pick(rng_);
+                } while (t[1] == t[0]);
+                do {
+                    t[2] = pick(rng_);
+                } while (t[2] == t[0] || t[2] == t[1]);
+                return t;
+            }
+
+        private:
+            size_t n_;
+            std::mt19937 rng_;
+            std::vector<Triple> all_;
+            size_t limit_;
+        };
+
+        // Hypotheses needed to draw one outlier-free triple with the given confidence, for an inlier ratio w
+        double requiredHypotheses(double w, double confidence) {
+            const double clean = w * w * w;
+            if (clean >= 1.0) {
+                return 0.0;
+            }
+            const double denominator = std::log1p(-clean);
+            return denominator < 0.0 ? std::log1p(-confidence) / denominator
+                                     : std::numeric_limits<double>::infinity();
+        }
+
+        bool finite(const std::vector<Receiver> &receivers) {
+            return std::all_of(receivers.begin(), receivers.end(), [](const Receiver &r) {
+                return std::isfinite(r.x) && std::isfinite(r.y) && std::isfinite(r.timestamp);
+            });
+        }
+    }
+
+    RobustSolution robustSolution(const std::vector<Receiver> &receivers, const RansacOptions &options) {
+        RobustSolution result;
+        const size_t n = receivers.size();
+        result.inliers.assign(n, true);
+        if (n < 3) {
+            result.solution.status = SolutionStatus::NotEnoughReceivers;
+            return result;
+        }
+        if (!finite(receivers)) {
+            return result;
+        }
+
+        const bool limited = options.budget.count() > 0;
+        const auto deadline = Clock::now() + options.budget;
+
+        // Nothing to vote on
+        if (n == 3) {
+            result.hypotheses = 1;
+            result.solution = exactSolution(receivers);
+            if (result.solution.usable()) {
+                auto refined = nonlinearSolution(receivers, result.solution.position, options.backend);
+                refined.roots = result.solution.roots;
+                result.solution = refined;
+            }
+            return result;
+        }
+
+        const Consensus consensus{receivers, options.inlierThreshold};
+        TripleSampler sample{n, options.maxHypotheses, options.seed};
+        const bool parallel = options.pool && n >= options.parallelReceivers;
+        const size_t round = parallel ? 4 * static_cast<size_t>(options.pool->size()) : 1;
+
+        Score best;
+        std::vector<Triple> triples(round);
+        std::vector<Score> scores(round);
+        double required = std::numeric_limits<double>::infinity();
+        while (result.hypotheses < sample.limit() && static_cast<double>(result.hypotheses) < required) {
+            if (limited && Clock::now() >= deadline) {
+                result.timedOut = true;
+                break;
+            }
+
+            const size_t m = std::min(round, sample.limit() - result.hypotheses);
+            for (size_t h = 0; h < m; h++) {
+                triples[h] = sample(result.hypotheses + h);
+            }
+            if (parallel) {
+                options.pool->parallelFor(m, [&](size_t h) { scores[h] = consensus.score(triples[h]); });
+            } else {
+                for (size_t h = 0; h < m; h++) {
+                    scores[h] = consensus.score(triples[h]);
+                }
+            }
+
+            // In draw order, so the outcome does not depend on the threads
+            for (size_t h = 0; h < m; h++) {
+                if (scores[h].cost < best.cost) {
+                    best = scores[h];
+                    required = requiredHypotheses(static_cast<double>(best.inliers) / static_cast<double>(n),
+                                                  options.confidence);
+                }
+            }
+            result.hypotheses += m;
+        }
+
+        // No hypothesis: none of the triples had a real solution, or the budget ran out before the first one
+        if (!std::isfinite(best.cost)) {
+            result.solution.method = SolutionMethod::Exact;
+            result.solution.status = result.timedOut ? SolutionStatus::TimedOut : SolutionStatus::NoRealSolution;
+            return result;
+        }
+
+        result.inliers = consensus.inliers(best);
+        std::vector<Receiver> inliers;
+        for (size_t i = 0; i < n; i++) {
+            if (result.inliers[i]) {
+                inliers.push_back(receivers[i]);
+            }
+        }
+
+        if (limited && Clock::now() >= deadline) {
+            result.timedOut = true;
+            result.solution.method = SolutionMethod::Exact;
+            result.solution.status = SolutionStatus::TimedOut;
+            result.solution.position = best.position;
+            result.solution.residualNorm = residualNorm(inliers, best.position);
+            return result;
+        }
+        result.solution = nonlinearSolution(inliers, best.position, options.backend);
+        if (result.timedOut && result.solution.status == SolutionStatus::Ok) {
+            result.solution.status = SolutionStatus::TimedOut;
+        }
+        return result;
+    }
+}
@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "../include/SlidingWindowLocator.hh"
+
+namespace tdoapp {
+    namespace {
+        // Position of value in the sorted range [first, first + n)
+        size_t findSorted(const double *first, size_t n, double value) {
+            return static_cast<size_t>(std::lower_bound(first, first + n, value) - first);
+        }
+
+        // Removes the value at pos from the sorted range [first, first + n)
+        void eraseSorted(double *first, size_t n, size_t pos) {
+            std::copy(first + pos + 1, first + n, first + pos);
+        }
+
+        // Inserts value in the sorted range [first, first + n), which has room for one more. Returns its position
+        size_t insertSorted(double *first, size_t n, double value) {
+            double *pos = std::upper_bound(first, first + n, value);
+            std::copy_backward(pos, first + n, first + n + 1);
+            *pos = value;
+            return static_cast<size_t>(pos - first);
+        }
+    }
+
+    SlidingWindowLocator::SlidingWindowLocator(const std::vector<Receiver> &receivers,
+                                               const SlidingWindowOptions &options)
+            : geometry_{receivers}, options_{options} {
+        if (options_.windowSize == 0) {
+            throw std::invalid_argument("The window size must be at least 1");
+        }
+        if (!(options_.trimFraction >= 0.0 && options_.trimFraction < 0.5)) {
+            throw std::invalid_argument("The trim fraction must be in [0, 0.5)");
+        }
+        if (options_.method != Method::Linear && options_.method != Method::Nonlinear) {
+            throw std::invalid_argument("Only the linear and non-linear methods are supported over a window");
+        }
+
+        const auto W = static_cast<Eigen::Index>(options_.windowSize);
+        const auto R = static_cast<Eigen::Index>(receivers.size());
+        ring_.resize(W, R);
+        sum_.setZero(R);
+        bandSum_.setZero(R);
+        statistic_.setZero(R);
+
+        if (options_.statistic != WindowStatistic::Mean) {
+            sorted_.resize(R, W);
+        }
+        if (options_.statistic == WindowStatistic::TrimmedMean) {
+            trim_ = std::min(static_cast<size_t>(std::floor(options_.trimFraction * static_cast<double>(W))),
+                             (options_.windowSize - 1) / 2);
+        }
+    }
+
+    void SlidingWindowLocator::reset() {
+        head_ = 0;
+        count_ = 0;
+        sum_.setZero();
+    }
+
+    std::optional<Eigen::Vector2d> SlidingWindowLocator::push(const Eigen::Ref<const Eigen::VectorXd> &toas) {
+        if (static_cast<size_t>(toas.size()) != geometry_.size()) {
+            throw std::invalid_argument("Number of TOAs does not match the number of receivers");
+        }
+        if (!toas.allFinite()) {
+            throw std::invalid_argument("TOAs must be finite");
+        }
+
+        const auto head = static_cast<Eigen::Index>(head_);
+        const bool orderStatistics = sorted_.size() > 0;
+        const bool trimmed = options_.statistic == WindowStatistic::TrimmedMean;
+        const bool wasFull = full();
+        size_t sortedSize = count_;
+
+        // The trimmed mean keeps the sum of the band [k, W - k) of every sorted window. Removing or inserting a
+        // value at position p moves it by the value at p clamped into the band (before the removal, after the
+        // insertion): the value itself inside the band, the one shifting across the band edge otherwise
+        const size_t lo = trim_, hi = options_.windowSize - trim_ - 1;
+        auto band = [lo, hi](size_t p) { return std::min(std::max(p, lo), hi); };
+
+        // Evict the oldest row
+        if (wasFull) {
+            sum_ -= ring_.row(head).transpose();
+            if (orderStatistics) {
+                sortedSize--;
+                for (Eigen::Index j = 0; j < sorted_.rows(); j++) {
+                    double *row = sorted_.row(j).data();
+                    const size_t pos = findSorted(row, count_, ring_(head, j));
+                    if (trimmed) {
+                        bandSum_[j] -= row[band(pos)];
+                    }
+                    eraseSorted(row, count_, pos);
+                }
+            }
+        }
+
+        ring_.row(head) = toas.transpose();
+        sum_ += toas;
+        if (orderStatistics) {
+            for (Eigen::Index j = 0; j < sorted_.rows(); j++) {
+                double *row = sorted_.row(j).data();
+                const size_t pos = insertSorted(row, sortedSize, toas[j]);
+                if (trimmed && wasFull) {
+                    bandSum_[j] += row[band(pos)];
+                }
+            }
+        }
+
+        count_ = std::min(count_ + 1, options_.windowSize);
+        head_ = (head_ + 1) % options_.windowSize;
+
+        // Resumming once per lap keeps rounding from piling up, for an amortized O(R). The window fills up at the
+        // end of a lap, which also gives the band its first sum
+        if (head_ == 0) {
+            sum_ = ring_.colwise().sum().transpose();
+            if (trimmed) {
+                bandSum_ = sorted_.middleCols(static_cast<Eigen::Index>(lo),
+                                              static_cast<Eigen::Index>(hi - lo + 1)).rowwise().sum();
+            }
+        }
+
+        if (!full()) {
+            return std::nullopt;
+        }
+
+        updateStatistic();
+        Eigen::Vector2d fix = geometry_.initialGuess(statistic_);
+        if (options_.method == Method::Nonlinear) {
+            fix = geometry_.nonlinearOptimization(statistic_, fix);
+        }
+        return fix;
+    }
+
+    void SlidingWindowLocator::updateStatistic() {
+        const auto W = static_cast<Eigen::Index>(options_.windowSize);
+        switch (options_.statistic) {
+            case WindowStatistic::Mean:
+                statistic_ = sum_ / static_cast<double>(W);
+                break;
+            case WindowStatistic::Median:
+                if (W % 2 == 1) {
+                    statistic_ = sorted_.col(W / 2);
+                } else {
+                    statistic_ = 0.5 * (sorted_.col(W / 2 - 1) + sorted_.col(W / 2));
+                }
+                break;
+            case WindowStatistic::TrimmedMean: {
+                const auto k = static_cast<Eigen::Index>(trim_);
+                statistic_ = bandSum_ / static_cast<double>(W - 2 * k);
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+#include <limits>
+#include <map>
+#include <stdexcept>
+
+#include "../include/ExactBatch.hh"
+#include "../include/TdoaBatch.hh"
+
+namespace tdoapp {
+    namespace {
+        // Failed fixes become NaN, so one bad measurement does not abort the batch
+        Eigen::Vector2d positionOrNan(const TdoaSolution &solution) {
+            return solution.usable() ? solution.position
+                                     : Eigen::Vector2d::Constant(std::numeric_limits<double>::quiet_NaN());
+        }
+
+        // Methods whose fixes do not use the shared geometry
+        bool independentFixes(Method method) {
+            return method == Method::Robust || method == Method::MultiStart;
+        }
+
+        TdoaSolution locateRow(const TdoaGeometry &geometry, const Eigen::Ref<const Eigen::VectorXd> &timestamps,
+                               Method method, const TdoaIndex *index = nullptr) {
+            if (independentFixes(method)) {
+                auto receivers = geometry.receivers();
+                for (size_t i = 0; i < receivers.size(); i++) {
+                    receivers[i].timestamp = timestamps[static_cast<Eigen::Index>(i)];
+                }
+                return locateSolution(receivers, method);
+            }
+
+            // The index replaces the initial guess of the non-linear fixes
+            if (index != nullptr && method == Method::Nonlinear) {
+                const Eigen::Vector2d start = index->warmStart(timestamps);
+                if (start.allFinite()) {
+                    return geometry.nonlinearSolution(timestamps, start);
+                }
+            }
+
+            auto result = geometry.initialSolution(timestamps);
+            if (method == Method::Nonlinear && result.usable()) {
+                result = geometry.nonlinearSolution(timestamps, result.position);
+            }
+            return result;
+        }
+    }
+
+    std::vector<Eigen::Vector2d> locateBatch(const std::vector<Measurement> &measurements, Method method,
+                                             ThreadPool &pool) {
+        std::vector<Eigen::Vector2d> results(measurements.size());
+        pool.parallelFor(measurements.size(), [&](size_t i) {
+            results[i] = positionOrNan(locateSolution(measurements[i], method));
+        });
+        return results;
+    }
+
+    std::vector<Eigen::Vector2d> locateBatch(const std::vector<Measurement> &measurements, Method method,
+                                             unsigned threads) {
+        ThreadPool pool{threads};
+        return locateBatch(measurements, method, pool);
+    }
+
+    std::vector<Eigen::Vector2d> locateGrouped(const std::vector<Measurement> &measurements, Method method) {
+        std::vector<Eigen::Vector2d> results(measurements.size());
+
+        // Three-receiver fixes are solved together by the vector kernel, whatever their deployment
+        ExactBatchColumns exact;
+        std::vector<size_t> exactIndices;
+
+        // Receiver positions -> measurements taken with them
+        std::map<std::vector<double>, std::vector<size_t>> groups;
+        for (size_t i = 0; i < measurements.size(); i++) {
+            if (independentFixes(method)) {
+                results[i] = positionOrNan(locateSolution(measurements[i], method));
+                continue;
+            }
+            if (measurements[i].size() == 3) {
+                exact.push_back(measurements[i][0], measurements[i][1], measurements[i][2]);
+                exactIndices.push_back(i);
+                continue;
+            }
+
+            std::vector<double> key;
+            key.reserve(2 * measurements[i].size());
+            for (const auto &r: measurements[i]) {
+                key.push_back(r.x);
+                key.push_back(r.y);
+            }
+            groups[std::move(key)].push_back(i);
+        }
+
+        for (const auto &[key, indices]: groups) {
+            // A lone measurement would not amortize the geometry
+            if (indices.size() == 1 || key.size() < 6) {
+                for (auto i: indices) {
+                    results[i] = positionOrNan(locateSolution(measurements[i], method));
+                }
+                continue;
+            }
+
+            const TdoaGeometry geometry{measurements[indices.front()]};
+            Eigen::VectorXd timestamps(static_cast<Eigen::Index>(geometry.size()));
+            for (auto i: indices) {
+                for (size_t j = 0; j < geometry.size(); j++) {
+                    timestamps[static_cast<Eigen::Index>(j)] = measurements[i][j].timestamp;
+                }
+                results[i] = positionOrNan(locateRow(geometry, timestamps, method));
+            }
+        }
+
+        ExactBatchResult solved;
+        exactBatch(exact, solved);
+        for (size_t j = 0; j < exactIndices.size(); j++) {
+            const auto i = exactIndices[j];
+            results[i] = {solved.x[j], solved.y[j]};
+            if (method == Method::Nonlinear && results[i].allFinite()) {
+                results[i] = positionOrNan(nonlinearSolution(measurements[i], results[i]));
+            }
+        }
+        return results;
+    }
+
+    std::vector<Eigen::Vector2d> locateBatch(const TdoaGeometry &geometry, const Eigen::Ref<const ToaMatrix> &toas,
+                                             Method method, ThreadPool &pool, const TdoaIndex *index) {
+        if (static_cast<size_t>(toas.cols()) != geometry.size()) {
+            throw std::invalid_argument("Number of TOA columns does not match the number of receivers");
+        }
+        if (index != nullptr && !index->matches(geometry.receivers())) {
+            throw std::invalid_argument("The index was built for other receivers");
+        }
+
+        std::vector<Eigen::Vector2d> results(static_cast<size_t>(toas.rows()));
+        pool.parallelFor(results.size(), [&](size_t i) {
+            // Contiguous row of a row-major matrix, binds to the geometry's Ref without a copy
+            const auto timestamps = toas.row(static_cast<Eigen::Index>(i)).transpose();
+            results[i] = positionOrNan(locateRow(geometry, timestamps, method, index));
+        });
+        return results;
+    }
+}
@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+#include <cmath>
+#include <stdexcept>
+
+#include "../include/TdoaCostFunction.hh"
+
+namespace tdoapp {
+    TdoaCostFunction::TdoaCostFunction(const std::vector<Receiver> &receivers, ResidualTopology topology,
+                                       int reference)
+            : ownedPositions_(2, receivers.size()), ownedTimestamps_(receivers.size()),
+              positions_{ownedPositions_.data(), 2, ownedPositions_.cols(), Eigen::OuterStride<>{2}},
+              timestamps_{ownedTimestamps_.data(), ownedTimestamps_.size()}, topology_{topology},
+              reference_{reference} {
+        for (size_t i = 0; i < receivers.size(); i++) {
+            ownedPositions_.col(i) << receivers[i].x, receivers[i].y;
+            ownedTimestamps_[i] = receivers[i].timestamp;
+        }
+        setSizes();
+    }
+
+    TdoaCostFunction::TdoaCostFunction(const Positions &positions, const Timestamps &timestamps,
+                                       ResidualTopology topology, int reference)
+            : positions_{positions}, timestamps_{timestamps}, topology_{topology}, reference_{reference} {
+        if (positions.cols() != timestamps.size()) {
+            throw std::invalid_argument("Number of timestamps does not match the number of receivers");
+        }
+        setSizes();
+    }
+
+    void TdoaCostFunction::setSizes() {
+        const auto n = static_cast<int>(positions_.cols());
+        if (reference_ < kAutoReference || reference_ >= n) {
+            throw std::invalid_argument("Reference receiver out of range");
+        }
+        set_num_residuals(topology_ == ResidualTopology::Reference ? n - 1 : n * (n - 1) / 2);
+        mutable_parameter_block_sizes()->push_back(2);
+    }
+
+    void TdoaCostFunction::setTimestamps(const Eigen::Ref<const Eigen::VectorXd> &timestamps) {
+        ownedTimestamps_ = timestamps;
+        new(&timestamps_) Timestamps(ownedTimestamps_.data(), ownedTimestamps_.size());
+    }
+
+    bool TdoaCostFunction::Evaluate(double const *const *parameters, double *residuals, double **jacobians) const {
+        const Eigen::Vector2d p{parameters[0][0], parameters[0][1]};
+        const auto n = positions_.cols();
+        if (n <= kStackReceivers) {
+            Eigen::Matrix<double, 2, Eigen::Dynamic, 0, 2, kStackReceivers> diff(2, n);
+            Eigen::Matrix<double, 1, Eigen::Dynamic, Eigen::RowMajor, 1, kStackReceivers> d(n);
+            return evaluate(p, diff, d, residuals, jacobians);
+        }
+        Eigen::Matrix2Xd diff(2, n);
+        Eigen::RowVectorXd d(n);
+        return evaluate(p, diff, d, residuals, jacobians);
+    }
+
+    bool TdoaCostFunction::evaluate(const Eigen::Vector2d &p, Eigen::Ref<Eigen::Matrix2Xd> diff,
+                                    Eigen::Ref<Eigen::RowVectorXd> d, double *residuals, double **jacobians) const {
+        const auto n = positions_.cols();
+
+        // Distances and their gradients are shared by all the pairs of a receiver, so we compute them only once
+        diff = p.replicate(1, n) - positions_;
+        d = (diff.colwise().squaredNorm().array() + epsilon).sqrt();
+
+        if (topology_ == ResidualTopology::Reference) {
+            diff.array().rowwise() /= d.array();
+            return evaluateReference(diff, d, residuals, jacobians);
+        }
+
+        // r_ij = (ti - tj) - (di - dj)
+        int k = 0;
+        for (Eigen::Index i = 0; i < n - 1; i++) {
+            for (Eigen::Index j = i + 1; j < n; j++) {
+                residuals[k++] = (timestamps_[i] - timestamps_[j]) - (d[i] - d[j]);
+            }
+        }
+
+        // dr_ij/dp = -((p - si) / di - (p - sj) / dj), stored row-major
+        if (jacobians != nullptr && jacobians[0] != nullptr) {
+            diff.array().rowwise() /= d.array();
+            double *J = jacobians[0];
+            for (Eigen::Index i = 0; i < n - 1; i++) {
+                for (Eigen::Index j = i + 1; j < n; j++) {
+                    J[0] = diff(0, j) - diff(0, i);
+                    J[1] = diff(1, j) - diff(1, i);
+                    J += 2;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    bool TdoaCostFunction::evaluateReference(const Eigen::Ref<const Eigen::Matrix2Xd> &unit,
+                                             const Eigen::Ref<const Eigen::RowVectorXd> &d, double *residuals,
+                                             double **jacobians) const {
+        const auto n = positions_.cols();
+        Eigen::Index ref = reference_;
+        if (ref == kAutoReference) {
+            timestamps_.minCoeff(&ref);
+        }
+        const double scale = std::sqrt(static_cast<double>(n));
+        const double a = (1.0 - 1.0 / scale) / static_cast<double>(n - 1);
+
+        // r_i = (ti - tref) - (di - dref), then W r = sqrt(N) * (r - a * sum(r))
+        double sum = 0.0;
+        int k = 0;
+        for (Eigen::Index i = 0; i < n; i++) {
+            if (i != ref) {
+                residuals[k] = (timestamps_[i] - timestamps_[ref]) - (d[i] - d[ref]);
+                sum += residuals[k++];
+            }
+        }
+        for (k = 0; k < n - 1; k++) {
+            residuals[k] = scale * (residuals[k] - a * sum);
+        }
+
+        // dr_i/dp = -(u_i - u_ref) with u = (p - s) / d, whitened the same way, stored row-major
+        if (jacobians != nullptr && jacobians[0] != nullptr) {
+            double *J = jacobians[0];
+            Eigen::Vector2d jSum = Eigen::Vector2d::Zero();
+            k = 0;
+            for (Eigen::Index i = 0; i < n; i++) {
+                if (i != ref) {
+                    J[2 * k] = unit(0, ref) - unit(0, i);
+                    J[2 * k + 1] = unit(1, ref) - unit(1, i);
+                    jSum[0] += J[2 * k];
+                    jSum[1] += J[2 * k + 1];
+                    k++;
+                }
+            }
+            for (k = 0; k < n - 1; k++) {
+                J[2 * k] = scale * (J[2 * k] - a * jSum[0]);
+                J[2 * k + 1] = scale * (J[2 * k + 1] - a * jSum[1]);
+            }
+        }
+
+        return true;
+    }
+}
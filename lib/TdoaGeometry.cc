@@ -0,0 +1,306 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+#include <Eigen/SVD>
+
+#include "../include/TdoaGeometry.hh"
+#include "../include/TdoaLocator.hh"
+#include "../include/Algebra.hh"
+#include "GivensSolve.hh"
+
+namespace tdoapp {
+    namespace {
+        ExactFrame makeExactFrame(const std::vector<Receiver> &receivers) {
+            if (receivers.size() < 3) {
+                throw std::invalid_argument("At least 3 receivers are needed");
+            }
+            return ExactFrame{receivers[0], receivers[1], receivers[2]};
+        }
+
+        // Below this fraction of its norm left outside the span of the geometry, the time column is considered part
+        // of it. The tail terms are differences of sums, so they only keep about eps / kSpanTolerance of relative
+        // accuracy near it
+        constexpr double kSpanTolerance = 1e-6;
+
+        // Minimum-norm LS solution of the full system [-tau_0i, (s0 - si)^T] [r0, x, y] = 0.5 * tau_0i^2 + bGeometry_i,
+        // for geometries where the decoupled solve does not hold, from the Givens QR of the system (GivensSolve.hh)
+        Eigen::Vector2d svdSolve(const Eigen::Matrix2Xd &positions, const Eigen::VectorXd &bGeometry,
+                                 const Eigen::Ref<const Eigen::VectorXd> &timestamps) {
+            detail::GivensTriangle<3> qr;
+            for (Eigen::Index i = 0; i < bGeometry.size(); i++) {
+                const double tau = timestamps[0] - timestamps[i + 1];
+                qr.add(Eigen::RowVector3d{-tau, positions(0, 0) - positions(0, i + 1),
+                                          positions(1, 0) - positions(1, i + 1)},
+                       0.5 * std::pow(tau, 2) + bGeometry[i]);
+            }
+            return qr.svdSolve().tail<2>();
+        }
+    }
+
+    ExactFrame::ExactFrame(const Receiver &r0, const Receiver &r1, const Receiver &r2) {
+        s0_ = Eigen::Vector2d{r0.x, r0.y};
+        s1_ = Eigen::Vector2d{r1.x, r1.y};
+
+        // Rotation taking the baseline s0 -> s1 to the x axis: its direction cosines, no trigonometry needed
+        const double dx = r1.x - r0.x, dy = r1.y - r0.y;
+        const double length = std::sqrt(dx * dx + dy * dy);
+        cos_ = length == 0.0 ? 1.0 : dx / length;
+        sin_ = length == 0.0 ? 0.0 : dy / length;
+
+        // We extract the values for the equations (receivers 1 and 2 in the rotated frame)
+        const double wx = r2.x - r0.x, wy = r2.y - r0.y;
+        b_ = cos_ * dx + sin_ * dy;
+        cx_ = cos_ * wx + sin_ * wy;
+        cy_ = -sin_ * wx + cos_ * wy;
+        c_ = std::sqrt(cx_ * cx_ + cy_ * cy_);
+    }
+
+    // Written out operation by operation: the batched solver (ExactBatchKernel.hh) performs the same operations in
+    // the same order, so both give identical bits
+    TdoaSolution ExactFrame::solution(double tau_01, double tau_02, bool getPositive) const {
+        TdoaSolution result;
+        result.method = SolutionMethod::Exact;
+
+        // We extract the values for g and h
+        const double q = b_ / tau_01;
+        const double k = 1.0 - q * q;
+        const double g = ((tau_02 / tau_01) * b_ - cx_) / cy_;
+        const double h = (c_ * c_ - tau_02 * tau_02 + tau_01 * tau_02 * k) / (2.0 * cy_);
+
+        // With this we go for the terms of the quadratic equation
+        const double d = -(1.0 + g * g - q * q);
+        const double e = b_ * k - 2.0 * g * h;
+        const double f = tau_01 * tau_01 / 4.0 * (k * k) - h * h;
+
+        // Terms for x and y (positions)
+        const double discriminant = e * e - 4.0 * d * f;
+        if (!(discriminant >= 0.0)) {
+            result.status = std::isnan(discriminant) ? SolutionStatus::InvalidInput : SolutionStatus::NoRealSolution;
+            return result;
+        }
+
+        const double root = std::sqrt(discriminant);
+        const double xp = (-e + root) / (2.0 * d);
+        const double yp = g * xp + h;
+        const double xm = (-e - root) / (2.0 * d);
+        const double ym = g * xm + h;
+
+        // Conversion to absolute coordinates
+        result.roots[0] = {cos_ * xp + -sin_ * yp + s0_[0], sin_ * xp + cos_ * yp + s0_[1]};
+        result.roots[1] = {cos_ * xm + -sin_ * ym + s0_[0], sin_ * xm + cos_ * ym + s0_[1]};
+
+        // We need to compare whether the signs are the same for the obtained results and the observed tdoa
+        bool consistent[2];
+        for (int j = 0; j < 2; j++) {
+            const double ax = result.roots[j][0] - s0_[0], ay = result.roots[j][1] - s0_[1];
+            const double bx = result.roots[j][0] - s1_[0], by = result.roots[j][1] - s1_[1];
+            consistent[j] = sgn(std::sqrt(ax * ax + ay * ay) - std::sqrt(bx * bx + by * by)) == sgn(tau_01);
+        }
+
+        if (consistent[0] && consistent[1]) {
+            result.status = SolutionStatus::Ambiguous;
+            result.position = result.roots[getPositive ? 0 : 1];
+        } else if (consistent[0] || consistent[1]) {
+            result.status = SolutionStatus::Ok;
+            result.position = result.roots[consistent[0] ? 0 : 1];
+        } else {
+            result.status = SolutionStatus::NoConsistentRoot;
+        }
+        return result;
+    }
+
+    Eigen::Vector2d ExactFrame::solve(double tau_01, double tau_02, bool getPositive) const {
+        auto result = solution(tau_01, tau_02, getPositive);
+        switch (result.status) {
+            case SolutionStatus::Ok:
+                return result.position;
+            case SolutionStatus::Ambiguous:
+                std::cerr << "Warning multiple solutions exist!" << std::endl;
+                std::cerr << (getPositive ? "Positive" : "Negative") << " arm will be returned" << std::endl;
+                return result.position;
+            case SolutionStatus::NoConsistentRoot:
+                return Eigen::Vector2d{0.0, 0.0};
+            default:
+                throw std::runtime_error("No real solution exists for the position");
+        }
+    }
+
+    TdoaGeometry::TdoaGeometry(const std::vector<Receiver> &receivers)
+            : receivers_{receivers}, positions_(2, receivers.size()), exact_{makeExactFrame(receivers)} {
+        for (size_t i = 0; i < receivers_.size(); i++) {
+            positions_.col(static_cast<Eigen::Index>(i)) << receivers_[i].x, receivers_[i].y;
+        }
+
+        // Geometry columns of the LS matrix and constant part of the right-hand side
+        const auto n = static_cast<Eigen::Index>(receivers_.size()) - 1;
+        Eigen::MatrixX2d G(n, 2);
+        bGeometry_.resize(n);
+        for (Eigen::Index i = 0; i < n; i++) {
+            const auto &ri = receivers_[i + 1];
+            G(i, 0) = receivers_[0].x - ri.x;
+            G(i, 1) = receivers_[0].y - ri.y;
+            bGeometry_[i] = 0.5 * (norm_sq(receivers_[0].x, receivers_[0].y) - norm_sq(ri.x, ri.y));
+        }
+        geometryQr_.compute(G);
+        geometryBasis_ = (geometryQr_.householderQ() * Eigen::MatrixX2d::Identity(n, 2)).transpose();
+
+        // Collinear receivers leave R singular: those fixes go through svdSolve
+        const Eigen::Vector2d diagonal = geometryQr_.matrixQR().diagonal().cwiseAbs();
+        rankDeficient_ = !(diagonal.minCoeff() > static_cast<double>(n) * std::numeric_limits<double>::epsilon() *
+                                                 diagonal.maxCoeff());
+    }
+
+    void TdoaGeometry::checkSize(const Eigen::Ref<const Eigen::VectorXd> &timestamps) const {
+        if (static_cast<size_t>(timestamps.size()) != receivers_.size()) {
+            throw std::invalid_argument("Number of timestamps does not match the number of receivers");
+        }
+    }
+
+    bool TdoaGeometry::validTimestamps(const Eigen::Ref<const Eigen::VectorXd> &timestamps) const {
+        return static_cast<size_t>(timestamps.size()) == receivers_.size() && timestamps.allFinite();
+    }
+
+    Eigen::Vector2d TdoaGeometry::initialGuess(const Eigen::Ref<const Eigen::VectorXd> &timestamps) const {
+        // For Least Squares, we need at least 4 receivers (in 2D case)
+        if (receivers_.size() > 3) {
+            return linearTDOA(timestamps);
+        }
+        return exactTDOA(timestamps);
+    }
+
+    Eigen::Vector2d TdoaGeometry::exactTDOA(const Eigen::Ref<const Eigen::VectorXd> &timestamps,
+                                            bool getPositive) const {
+        checkSize(timestamps);
+        return exact_.solve(timestamps[0] - timestamps[1], timestamps[0] - timestamps[2], getPositive);
+    }
+
+    Eigen::Vector2d TdoaGeometry::linearTDOA(const Eigen::Ref<const Eigen::VectorXd> &timestamps) const {
+        checkSize(timestamps);
+        if (receivers_.size() < 4) {
+            throw std::invalid_argument("Least Squares needs at least 4 receivers");
+        }
+
+        if (rankDeficient_) {
+            return svdSolve(positions_, bGeometry_, timestamps);
+        }
+
+        // In the basis of the geometry QR, the first two rows couple with (x, y) through R and the remaining ones
+        // only with r0, which decouples the problem into two tiny ones. Only the projections of the time column a
+        // and of b on the first two (Q1^T a, Q1^T b) and their products are needed: the tail products follow from
+        // a^T a and a^T b, so a fix takes one pass over the timestamps and allocates nothing
+        const auto n = static_cast<Eigen::Index>(receivers_.size()) - 1;
+        Eigen::Vector2d qa = Eigen::Vector2d::Zero(), qb = Eigen::Vector2d::Zero();
+        double aa = 0.0, ab = 0.0;
+        for (Eigen::Index i = 0; i < n; i++) {
+            const double tau = timestamps[0] - timestamps[i + 1];
+            const double a = -tau;
+            const double b = 0.5 * std::pow(tau, 2) + bGeometry_[i];
+            qa += a * geometryBasis_.col(i);
+            qb += b * geometryBasis_.col(i);
+            aa += a * a;
+            ab += a * b;
+        }
+        const double tailAa = aa - qa.squaredNorm();
+        const double tailAb = ab - qa.dot(qb);
+
+        // Time column (almost) inside the span of the geometry, fall back to the rank-revealing solver
+        if (!(tailAa > kSpanTolerance * aa)) {
+            return svdSolve(positions_, bGeometry_, timestamps);
+        }
+
+        const double r0 = tailAb / tailAa;
+        const Eigen::Vector2d rhs = qb - r0 * qa;
+        return geometryQr_.matrixQR().topLeftCorner<2, 2>().triangularView<Eigen::Upper>().solve(rhs);
+    }
+
+    Eigen::Vector2d TdoaGeometry::nonlinearOptimization(const Eigen::Ref<const Eigen::VectorXd> &timestamps,
+                                                        const Eigen::Vector2d &initialGuess,
+                                                        CostModel model) const {
+        checkSize(timestamps);
+        return ::tdoapp::nonlinearOptimization(positions_, timestamps, initialGuess, model);
+    }
+
+    Eigen::Vector2d TdoaGeometry::nonlinearOptimization(const Eigen::Ref<const Eigen::VectorXd> &timestamps,
+                                                        const Eigen::Vector2d &initialGuess,
+                                                        NlsBackend backend) const {
+        checkSize(timestamps);
+        if (backend == NlsBackend::LevenbergMarquardt) {
+            return levenbergMarquardt(positions_, timestamps, initialGuess).position;
+        }
+        return nonlinearOptimization(timestamps, initialGuess, CostModel::Analytic);
+    }
+
+    TdoaSolution TdoaGeometry::initialSolution(const Eigen::Ref<const Eigen::VectorXd> &timestamps) const {
+        return receivers_.size() > 3 ? linearSolution(timestamps) : exactSolution(timestamps);
+    }
+
+    TdoaSolution TdoaGeometry::linearSolution(const Eigen::Ref<const Eigen::VectorXd> &timestamps,
+                                              bool covariance) const {
+        TdoaSolution result;
+        result.method = SolutionMethod::LinearLeastSquares;
+        if (receivers_.size() < 4) {
+            result.status = SolutionStatus::NotEnoughReceivers;
+            return result;
+        }
+        if (!validTimestamps(timestamps)) {
+            return result;
+        }
+
+        result.position = linearTDOA(timestamps);
+        result.status = result.position.allFinite() ? SolutionStatus::Ok : SolutionStatus::SolverFailure;
+        result.residualNorm = residualNorm(positions_, timestamps, result.position);
+        if (covariance && result.usable()) {
+            result.covariance = positionCovariance(positions_, result.position);
+        }
+        return result;
+    }
+
+    TdoaSolution TdoaGeometry::exactSolution(const Eigen::Ref<const Eigen::VectorXd> &timestamps,
+                                             bool getPositive) const {
+        if (!validTimestamps(timestamps)) {
+            return {};
+        }
+
+        auto result = exact_.solution(timestamps[0] - timestamps[1], timestamps[0] - timestamps[2], getPositive);
+        if (result.usable()) {
+            result.residualNorm = residualNorm(positions_, timestamps, result.position);
+        }
+        return result;
+    }
+
+    TdoaSolution TdoaGeometry::nonlinearSolution(const Eigen::Ref<const Eigen::VectorXd> &timestamps,
+                                                 const Eigen::Vector2d &initialGuess,
+                                                 NlsBackend backend,
+                                                 ceres::Solver::Summary *summary,
+                                                 bool covariance) const {
+        if (!validTimestamps(timestamps) || !initialGuess.allFinite()) {
+            TdoaSolution result;
+            result.method = SolutionMethod::NonlinearLeastSquares;
+            return result;
+        }
+
+        if (backend == NlsBackend::Ceres) {
+            return ::tdoapp::nonlinearSolution(positions_, timestamps, initialGuess, CostModel::Analytic, summary,
+                                               covariance);
+        }
+
+        TdoaSolution result;
+        result.method = SolutionMethod::NonlinearLeastSquares;
+        auto lm = levenbergMarquardt(positions_, timestamps, initialGuess);
+        result.position = lm.position;
+        result.iterations = lm.iterations;
+        result.status = !lm.position.allFinite() ? SolutionStatus::SolverFailure
+                        : lm.converged ? SolutionStatus::Ok : SolutionStatus::NoConvergence;
+        result.residualNorm = residualNorm(positions_, timestamps, result.position);
+        if (covariance && result.usable()) {
+            result.covariance = covarianceFromGaussNewton(lm.gaussNewton, size());
+        }
+        return result;
+    }
+}
@@ -0,0 +1,342 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+#include "../include/TdoaIndex.hh"
+
+namespace tdoapp {
+    namespace {
+        using Clock = std::chrono::steady_clock;
+
+        constexpr size_t kHeaderSize = 32;
+
+        double secondsSince(Clock::time_point start) {
+            return std::chrono::duration<double>(Clock::now() - start).count();
+        }
+
+        void checkEndianness() {
+            const std::uint16_t one = 1;
+            unsigned char first;
+            std::memcpy(&first, &one, 1);
+            if (first != 1) {
+                throw std::runtime_error("TDOA index files are only supported on little-endian hosts");
+            }
+        }
+
+        template<typename T>
+        T readField(const char *data, size_t offset) {
+            T value;
+            std::memcpy(&value, data + offset, sizeof(T));
+            return value;
+        }
+
+        template<typename T>
+        void writeField(std::ofstream &ofs, T value) {
+            ofs.write(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+
+        template<typename T>
+        void writeArray(std::ofstream &ofs, const std::vector<T> &values) {
+            ofs.write(reinterpret_cast<const char *>(values.data()),
+                      static_cast<std::streamsize>(values.size() * sizeof(T)));
+        }
+
+        template<typename T>
+        void readArray(const char *data, size_t &offset, std::vector<T> &values, size_t count) {
+            values.resize(count);
+            std::memcpy(values.data(), data + offset, count * sizeof(T));
+            offset += count * sizeof(T);
+        }
+    }
+
+    TdoaIndex::TdoaIndex(const std::vector<Receiver> &receivers, const TdoaIndexOptions &options)
+            : receivers_{receivers} {
+        const auto start = Clock::now();
+        if (receivers.size() < 3) {
+            throw std::invalid_argument("A TDOA index needs at least 3 receivers");
+        }
+        if (std::any_of(receivers.begin(), receivers.end(),
+                        [](const Receiver &r) { return !std::isfinite(r.x) || !std::isfinite(r.y); })) {
+            throw std::invalid_argument("Receiver positions must be finite");
+        }
+        if (options.resolution < 2 || options.resolution > 65535) {
+            throw std::invalid_argument("The resolution of a TDOA index must be between 2 and 65535");
+        }
+        for (auto &r: receivers_) {
+            r.timestamp = 0.0;
+        }
+
+        // Square grid over the grown bounding box
+        Eigen::Vector2d low = receivers[0].position(), high = low;
+        for (const auto &r: receivers) {
+            low = low.cwiseMin(r.position());
+            high = high.cwiseMax(r.position());
+        }
+        const auto n = static_cast<size_t>(options.resolution);
+        const double side = std::max((high - low).maxCoeff(), std::numeric_limits<double>::min()) *
+                            (1.0 + 2.0 * options.margin);
+        const double step = side / static_cast<double>(n - 1);
+        const Eigen::Vector2d origin = 0.5 * (low + high) - Eigen::Vector2d::Constant(0.5 * side);
+
+        dims_ = receivers.size() - 1;
+        const size_t m = n * n;
+        positions_.resize(2 * m);
+        keys_.resize(dims_ * m);
+        for (size_t j = 0; j < n; j++) {
+            for (size_t i = 0; i < n; i++) {
+                const size_t p = j * n + i;
+                const Eigen::Vector2d position = origin + step * Eigen::Vector2d(static_cast<double>(i),
+                                                                                 static_cast<double>(j));
+                positions_[2 * p] = position[0];
+                positions_[2 * p + 1] = position[1];
+                const double d0 = (position - receivers[0].position()).norm();
+                for (size_t d = 0; d < dims_; d++) {
+                    keys_[p * dims_ + d] = (position - receivers[d + 1].position()).norm() - d0;
+                }
+            }
+        }
+
+        // Principal plane of the TDOAs. Its basis is orthonormal, so projected distances are never longer
+        const Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>> keys(
+                keys_.data(), static_cast<Eigen::Index>(m), static_cast<Eigen::Index>(dims_));
+        mean_ = keys.colwise().mean().transpose();
+        const Eigen::MatrixXd centered = keys.rowwise() - mean_.transpose();
+        const Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> pca(centered.transpose() * centered);
+        basis_ = pca.eigenvectors().rightCols<2>();
+        const Eigen::MatrixX2d projected = centered * basis_;
+
+        // About one point per cell, each cell holding a contiguous range of the tables
+        cells_ = n;
+        low_ = projected.colwise().minCoeff().transpose();
+        const Eigen::Vector2d extent = projected.colwise().maxCoeff().transpose() - low_;
+        cellSize_ = (extent / static_cast<double>(cells_)).cwiseMax(std::numeric_limits<double>::min());
+        std::vector<std::uint32_t> cellOfPoint(m);
+        cellStart_.assign(cells_ * cells_ + 1, 0);
+        for (size_t k = 0; k < m; k++) {
+            const auto cell = cellOf(projected.row(static_cast<Eigen::Index>(k)).transpose());
+            cellOfPoint[k] = static_cast<std::uint32_t>(static_cast<size_t>(cell.y()) * cells_ +
+                                                        static_cast<size_t>(cell.x()));
+            cellStart_[cellOfPoint[k] + 1]++;
+        }
+        std::partial_sum(cellStart_.begin(), cellStart_.end(), cellStart_.begin());
+
+        std::vector<std::uint32_t> next(cellStart_.begin(), cellStart_.end() - 1);
+        std::vector<double> positions(2 * m), sorted(dims_ * m);
+        for (size_t k = 0; k < m; k++) {
+            const size_t to = next[cellOfPoint[k]]++;
+            std::copy_n(&positions_[2 * k], 2, &positions[2 * to]);
+            std::copy_n(&keys_[dims_ * k], dims_, &sorted[dims_ * to]);
+        }
+        positions_ = std::move(positions);
+        keys_ = std::move(sorted);
+
+        buildSeconds_ = secondsSince(start);
+    }
+
+    Eigen::Array2i TdoaIndex::cellOf(const Eigen::Vector2d &projected) const {
+        const Eigen::Array2d cell = ((projected - low_).array() / cellSize_.array()).floor();
+        return cell.max(0.0).min(static_cast<double>(cells_ - 1)).cast<int>();
+    }
+
+    Eigen::Vector2d TdoaIndex::warmStart(const Eigen::Ref<const Eigen::VectorXd> &timestamps) const {
+        if (static_cast<size_t>(timestamps.size()) != receivers_.size() || !timestamps.allFinite()) {
+            return Eigen::Vector2d::Constant(std::numeric_limits<double>::quiet_NaN());
+        }
+
+        // |p - s_i| - |p - s_0| = t_i - t_0, whatever the emission time
+        const double *t = timestamps.data();
+        Eigen::Vector2d projected = Eigen::Vector2d::Zero();
+        for (size_t d = 0; d < dims_; d++) {
+            projected += (t[d + 1] - t[0] - mean_[static_cast<Eigen::Index>(d)]) *
+                         basis_.row(static_cast<Eigen::Index>(d)).transpose();
+        }
+
+        size_t best = 0;
+        double bestDistance = std::numeric_limits<double>::infinity();
+        auto scan = [&](int x, int y) {
+            const size_t cell = static_cast<size_t>(y) * cells_ + static_cast<size_t>(x);
+            for (size_t k = cellStart_[cell]; k < cellStart_[cell + 1]; k++) {
+                const double *key = &keys_[k * dims_];
+                double distance = 0.0;
+                for (size_t d = 0; d < dims_ && distance < bestDistance; d++) {
+                    const double diff = t[d + 1] - t[0] - key[d];
+                    distance += diff * diff;
+                }
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = k;
+                }
+            }
+        };
+
+        // Rings of cells around the query. Points beyond ring r are at least r cells away once projected, and
+        // farther still in full
+        const auto center = cellOf(projected);
+        const double width = cellSize_.minCoeff();
+        const int last = static_cast<int>(cells_) - 1;
+        for (int r = 0; r <= last; r++) {
+            for (int y = std::max(center.y() - r, 0); y <= std::min(center.y() + r, last); y++) {
+                if (std::abs(y - center.y()) == r) {
+                    for (int x = std::max(center.x() - r, 0); x <= std::min(center.x() + r, last); x++) {
+                        scan(x, y);
+                    }
+                    continue;
+                }
+                if (center.x() - r >= 0) {
+                    scan(center.x() - r, y);
+                }
+                if (center.x() + r <= last) {
+                    scan(center.x() + r, y);
+                }
+            }
+            const double reach = static_cast<double>(r) * width;
+            if (reach * reach >= bestDistance) {
+                break;
+            }
+        }
+        return {positions_[2 * best], positions_[2 * best + 1]};
+    }
+
+    Eigen::Vector2d TdoaIndex::warmStart(const std::vector<Receiver> &receivers) const {
+        Eigen::VectorXd timestamps(static_cast<Eigen::Index>(receivers.size()));
+        for (size_t i = 0; i < receivers.size(); i++) {
+            timestamps[static_cast<Eigen::Index>(i)] = receivers[i].timestamp;
+        }
+        return warmStart(timestamps);
+    }
+
+    bool TdoaIndex::matches(const std::vector<Receiver> &receivers) const {
+        return std::equal(receivers.begin(), receivers.end(), receivers_.begin(), receivers_.end(),
+                          [](const Receiver &a, const Receiver &b) { return a.x == b.x && a.y == b.y; });
+    }
+
+    size_t TdoaIndex::memoryBytes() const {
+        return receivers_.size() * sizeof(Receiver) + (mean_.size() + basis_.size() + 4) * sizeof(double) +
+               positions_.size() * sizeof(double) + keys_.size() * sizeof(double) +
+               cellStart_.size() * sizeof(std::uint32_t);
+    }
+
+    void TdoaIndex::save(const std::string &path) const {
+        checkEndianness();
+        std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+        if (!ofs.is_open()) {
+            throw std::runtime_error("Could not open TDOA index file for writing: " + path);
+        }
+
+        ofs.write(kTdoaIndexMagic, sizeof(kTdoaIndexMagic));
+        writeField<std::uint32_t>(ofs, kTdoaIndexVersion);
+        writeField<std::uint64_t>(ofs, receivers_.size());
+        writeField<std::uint64_t>(ofs, size());
+        writeField<std::uint64_t>(ofs, cells_);
+        for (const auto &r: receivers_) {
+            writeField(ofs, r.x);
+            writeField(ofs, r.y);
+        }
+        for (Eigen::Index d = 0; d < mean_.size(); d++) {
+            writeField(ofs, mean_[d]);
+        }
+        for (Eigen::Index d = 0; d < basis_.rows(); d++) {
+            writeField(ofs, basis_(d, 0));
+            writeField(ofs, basis_(d, 1));
+        }
+        for (const double v: {low_[0], low_[1], cellSize_[0], cellSize_[1]}) {
+            writeField(ofs, v);
+        }
+        writeArray(ofs, positions_);
+        writeArray(ofs, keys_);
+        writeArray(ofs, cellStart_);
+
+        if (!ofs.flush()) {
+            throw std::runtime_error("Could not write TDOA index file: " + path);
+        }
+    }
+
+    TdoaIndex TdoaIndex::load(const std::string &path) {
+        const auto start = Clock::now();
+        checkEndianness();
+
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs.is_open()) {
+            throw std::runtime_error("Could not open TDOA index file: " + path);
+        }
+        const std::vector<char> data{std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+        if (data.size() < kHeaderSize) {
+            throw std::runtime_error("TDOA index file is too small: " + path);
+        }
+
+        const auto version = readField<std::uint32_t>(data.data(), 4);
+        const auto receiverCount = readField<std::uint64_t>(data.data(), 8);
+        const auto pointCount = readField<std::uint64_t>(data.data(), 16);
+        const auto cellCount = readField<std::uint64_t>(data.data(), 24);
+
+        // Sizes are checked by division first so that a corrupted header can not overflow them
+        const size_t payload = data.size() - kHeaderSize;
+        bool valid = std::memcmp(data.data(), kTdoaIndexMagic, sizeof(kTdoaIndexMagic)) == 0 &&
+                     version == kTdoaIndexVersion && receiverCount >= 3 &&
+                     receiverCount <= payload / (5 * sizeof(double)) && cellCount >= 1 &&
+                     cellCount <= payload / sizeof(std::uint32_t) / cellCount;
+        if (valid) {
+            // Receivers, mean, basis and cells; then the points and the cell ranges
+            const size_t fixed = (5 * receiverCount + 1) * sizeof(double) +
+                                 (cellCount * cellCount + 1) * sizeof(std::uint32_t);
+            const size_t pointSize = (receiverCount + 1) * sizeof(double);
+            valid = fixed <= payload && pointCount >= 1 && pointCount <= (payload - fixed) / pointSize &&
+                    payload == fixed + pointCount * pointSize;
+        }
+        if (!valid) {
+            throw std::runtime_error("Not a valid TDOA index file: " + path);
+        }
+
+        TdoaIndex index;
+        index.dims_ = static_cast<size_t>(receiverCount) - 1;
+        index.cells_ = static_cast<size_t>(cellCount);
+        const auto dims = static_cast<Eigen::Index>(index.dims_);
+        size_t offset = kHeaderSize;
+        auto next = [&data, &offset]() {
+            const auto value = readField<double>(data.data(), offset);
+            offset += sizeof(double);
+            return value;
+        };
+        for (size_t i = 0; i < receiverCount; i++) {
+            const double x = next();
+            index.receivers_.emplace_back(x, next());
+        }
+        index.mean_.resize(dims);
+        for (Eigen::Index d = 0; d < dims; d++) {
+            index.mean_[d] = next();
+        }
+        index.basis_.resize(dims, 2);
+        for (Eigen::Index d = 0; d < dims; d++) {
+            index.basis_(d, 0) = next();
+            index.basis_(d, 1) = next();
+        }
+        index.low_[0] = next();
+        index.low_[1] = next();
+        index.cellSize_[0] = next();
+        index.cellSize_[1] = next();
+        readArray(data.data(), offset, index.positions_, 2 * pointCount);
+        readArray(data.data(), offset, index.keys_, index.dims_ * pointCount);
+        readArray(data.data(), offset, index.cellStart_, index.cells_ * index.cells_ + 1);
+
+        const auto &cellStart = index.cellStart_;
+        if (cellStart.front() != 0 || cellStart.back() != pointCount ||
+            !std::is_sorted(cellStart.begin(), cellStart.end()) || !index.mean_.allFinite() ||
+            !index.basis_.allFinite() || !index.low_.allFinite() || !(index.cellSize_.array() > 0.0).all() ||
+            !index.cellSize_.allFinite()) {
+            throw std::runtime_error("Not a valid TDOA index file: " + path);
+        }
+
+        index.buildSeconds_ = secondsSince(start);
+        return index;
+    }
+}
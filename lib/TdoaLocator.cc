@@ -2,10 +2,20 @@
 
 // Copyright 2023 Yago Lizarribar
 
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
 #include <Eigen/SVD>
 
 #include "../include/TdoaLocator.hh"
+#include "../include/RobustLocator.hh"
+#include "../include/GridInitializer.hh"
+#include "../include/TdoaGeometry.hh"
+#include "../include/NlsContext.hh"
 #include "../include/Algebra.hh"
+#include "GivensSolve.hh"
 
 namespace tdoapp {
     Eigen::Vector2d initialGuess(const std::vector<Receiver> &receivers) {
@@ -22,148 +32,391 @@ namespace tdoapp {
     }
 
     Eigen::Vector2d exactTDOA(const std::vector<Receiver> &receivers, bool getPositive) {
+        ExactFrame frame{receivers[0], receivers[1], receivers[2]};
 
-        Eigen::Vector2d res{0.0, 0.0};
+        double tau_01 = receivers[0].timestamp - receivers[1].timestamp;
+        double tau_02 = receivers[0].timestamp - receivers[2].timestamp;
 
-        // Get receivers in Eigen matrix form
-        Eigen::Vector2d s0{receivers[0].x, receivers[0].y};
-        Eigen::Vector2d s1{receivers[1].x, receivers[1].y};
-        Eigen::Vector2d s2{receivers[2].x, receivers[2].y};
+        return frame.solve(tau_01, tau_02, getPositive);
+    }
 
-        // Define the rotation matrix
-        double theta = std::atan2(receivers[1].y - receivers[0].y, receivers[1].x - receivers[0].x);
-        Eigen::Matrix2d R;
-        R << std::cos(theta), -std::sin(theta),
-                std::sin(theta), std::cos(theta);
+    Eigen::Vector2d linearTDOA(const std::vector<Receiver> &receivers, LinearSolver solver) {
+        return linearTDOA<2>(receivers, solver);
+    }
 
-        Eigen::Vector2d s0r = {0.0, 0.0};
-        Eigen::Vector2d s1r = R.transpose() * (s1 - s0);
-        Eigen::Vector2d s2r = R.transpose() * (s2 - s0);
+    Eigen::Vector2d nonlinearOptimization(const std::vector<Receiver> &receivers,
+                                          const Eigen::Vector2d &initialGuess,
+                                          CostModel model,
+                                          ceres::Solver::Summary *summary) {
+        ceres::Problem problem;
+        double xy[2] = {initialGuess[0], initialGuess[1]};
+        if (model == CostModel::Analytic) {
+            problem.AddResidualBlock(new TdoaCostFunction(receivers), nullptr, xy);
+        } else if (model == CostModel::Reference) {
+            problem.AddResidualBlock(new TdoaCostFunction(receivers, ResidualTopology::Reference), nullptr, xy);
+        } else {
+            for (size_t i = 0; i < receivers.size() - 1; i++) {
+                for (size_t j = i + 1; j < receivers.size(); j++) {
+                    problem.AddResidualBlock(
+                            new ceres::AutoDiffCostFunction<TdoaError, 1, 1, 1>(
+                                    new TdoaError(receivers[i], receivers[j])
+                            ),
+                            nullptr,
+                            &xy[0], &xy[1]
+                    );
+                }
+            }
+        }
 
-        // We extract the values for the equations
-        double b = s1r[0];
-        double cx = s2r[0];
-        double cy = s2r[1];
-        double c = norm(cx, cy);
+        ceres::Solver::Summary local;
+        ceres::Solve(ceresOptions(NlsOptions{}), &problem, summary ? summary : &local);
 
-        double tau_01 = receivers[0].timestamp - receivers[1].timestamp;
-        double tau_02 = receivers[0].timestamp - receivers[2].timestamp;
+        return Eigen::Vector2d{xy[0], xy[1]};
+    }
 
-        // We extract the values for g and h
-        double g = ((tau_02 / tau_01) * b - cx) / cy;
-        double h = (std::pow(c, 2) - std::pow(tau_02, 2) + tau_01 * tau_02 * (1 - std::pow(b / tau_01, 2))) /
-                   (2 * cy);
+    Eigen::Vector2d nonlinearOptimization(const std::vector<Receiver> &receivers,
+                                          const Eigen::Vector2d &initialGuess,
+                                          NlsBackend backend) {
+        if (backend == NlsBackend::LevenbergMarquardt) {
+            return levenbergMarquardt(receivers, initialGuess).position;
+        }
+        return nonlinearOptimization(receivers, initialGuess, CostModel::Analytic);
+    }
 
-        // With this we go for the terms of the quadratic equation
-        double d = -(1 + std::pow(g, 2) - std::pow(b / tau_01, 2));
-        double e = b * (1 - std::pow(b / tau_01, 2)) - 2 * g * h;
-        double f = std::pow(tau_01, 2) / 4 * std::pow((1 - std::pow(b / tau_01, 2)), 2) - std::pow(h, 2);
+    Eigen::Vector2d nonlinearOptimization(const Eigen::Ref<const Eigen::Matrix2Xd> &positions,
+                                          const Eigen::Ref<const Eigen::VectorXd> &timestamps,
+                                          const Eigen::Vector2d &initialGuess, CostModel model,
+                                          ceres::Solver::Summary *summary) {
+        if (positions.cols() != timestamps.size()) {
+            throw std::invalid_argument("Number of timestamps does not match the number of receivers");
+        }
 
-        // Terms for x and y (positions)
-        double discriminant = std::pow(e, 2) - 4 * d * f;
+        ceres::Problem problem;
+        double xy[2] = {initialGuess[0], initialGuess[1]};
+        if (model == CostModel::AutoDiff) {
+            for (Eigen::Index i = 0; i < positions.cols() - 1; i++) {
+                for (Eigen::Index j = i + 1; j < positions.cols(); j++) {
+                    problem.AddResidualBlock(
+                            new ceres::AutoDiffCostFunction<TdoaError, 1, 1, 1>(
+                                    new TdoaError(Receiver{positions(0, i), positions(1, i), timestamps[i]},
+                                                  Receiver{positions(0, j), positions(1, j), timestamps[j]})
+                            ),
+                            nullptr,
+                            &xy[0], &xy[1]
+                    );
+                }
+            }
+        } else {
+            const auto topology = model == CostModel::Reference ? ResidualTopology::Reference
+                                                                : ResidualTopology::AllPairs;
+            // positions and timestamps outlive the solve, the cost function reads them in place
+            problem.AddResidualBlock(
+                    new TdoaCostFunction(TdoaCostFunction::Positions{positions.data(), 2, positions.cols(),
+                                                                     Eigen::OuterStride<>{positions.outerStride()}},
+                                         TdoaCostFunction::Timestamps{timestamps.data(), timestamps.size()},
+                                         topology),
+                    nullptr, xy);
+        }
 
-        double xp, yp, xm, ym;
-        if (discriminant >= 0.0) {
-            xp = (-e + std::sqrt(discriminant)) / (2 * d);
-            yp = g * xp + h;
+        ceres::Solver::Summary local;
+        ceres::Solve(ceresOptions(NlsOptions{}), &problem, summary ? summary : &local);
 
-            xm = (-e - std::sqrt(discriminant)) / (2 * d);
-            ym = g * xm + h;
-        } else {
-            throw std::runtime_error("No real solution exists for the position");
-        }
-
-        // Conversion to absolute coordinates
-        // For the positive result
-        Eigen::Vector2d rp = R * Eigen::Vector2d{xp, yp};
-        rp += s0;
-        auto rp0 = rp - s0;
-        auto rp1 = rp - s1;
-        auto rpn = norm(rp0[0], rp0[1]) - norm(rp1[0], rp1[1]);
-
-        // We need to compare whether the signs are the same for the obtained result and the observed tdoa
-        bool multiple = false; // Check if we will have multiple solutions
-        if (sgn(rpn) == sgn(tau_01)) {
-            res[0] = rp[0];
-            res[1] = rp[1];
-            multiple = true;
-        }
-
-        // For the negative result
-        Eigen::Vector2d rm = R * Eigen::Vector2d{xm, ym};
-        rm += s0;
-
-        auto rm0 = rm - s0;
-        auto rm1 = rm - s1;
-        auto rmn = norm(rm0[0], rm0[1]) - norm(rm1[0], rm1[1]);
-
-        // We need to compare whether the signs are the same for the obtained result and the observed tdoa
-        if (sgn(rmn) == sgn(tau_01)) {
-            if (multiple) {
-                std::cerr << "Warning multiple solutions exist!" << std::endl;
-                if (getPositive) {
-                    std::cerr << "Positive arm will be returned" << std::endl;
-                    return res;
-                } else {
-                    std::cerr << "Negative arm will be returned" << std::endl;
+        return Eigen::Vector2d{xy[0], xy[1]};
+    }
+
+    Eigen::Vector2d locate(const std::vector<Receiver> &receivers, Method method) {
+        if (method == Method::Robust) {
+            const auto robust = robustSolution(receivers);
+            if (!robust.solution.usable()) {
+                throw std::runtime_error(std::string{"Robust localization failed: "} +
+                                         toString(robust.solution.status));
+            }
+            return robust.solution.position;
+        }
+        if (method == Method::MultiStart) {
+            const auto solution = multiStartSolution(receivers);
+            if (!solution.usable()) {
+                throw std::runtime_error(std::string{"Multi-start localization failed: "} + toString(solution.status));
+            }
+            return solution.position;
+        }
+
+        auto position = initialGuess(receivers);
+        if (method == Method::Nonlinear) {
+            position = nonlinearOptimization(receivers, position);
+        }
+        return position;
+    }
+
+    namespace {
+        bool finiteReceivers(const std::vector<Receiver> &receivers) {
+            for (const auto &r: receivers) {
+                if (!std::isfinite(r.x) || !std::isfinite(r.y) || !std::isfinite(r.timestamp)) {
+                    return false;
                 }
             }
+            return true;
+        }
+
+        // Iterations and status of a Ceres solve
+        void ceresStatus(const ceres::Solver::Summary &summary, TdoaSolution &result) {
+            result.iterations = summary.num_successful_steps + summary.num_unsuccessful_steps;
+            switch (summary.termination_type) {
+                case ceres::CONVERGENCE:
+                case ceres::USER_SUCCESS:
+                    result.status = SolutionStatus::Ok;
+                    break;
+                case ceres::NO_CONVERGENCE:
+                    result.status = SolutionStatus::NoConvergence;
+                    break;
+                default:
+                    result.status = SolutionStatus::SolverFailure;
+            }
+            if (!result.position.allFinite()) {
+                result.status = SolutionStatus::SolverFailure;
+            }
+        }
+
+        // Status and residual of a closed-form position
+        TdoaSolution closedForm(const std::vector<Receiver> &receivers, const Eigen::Vector2d &position,
+                                SolutionMethod method) {
+            TdoaSolution result;
+            result.method = method;
+            result.position = position;
+            result.status = position.allFinite() ? SolutionStatus::Ok : SolutionStatus::SolverFailure;
+            result.residualNorm = residualNorm(receivers, position);
+            return result;
+        }
+    }
 
-            res[0] = rm[0];
-            res[1] = rm[1];
+    TdoaSolution initialSolution(const std::vector<Receiver> &receivers) {
+        return receivers.size() > 3 ? linearSolution(receivers) : exactSolution(receivers);
+    }
+
+    TdoaSolution linearSolution(const std::vector<Receiver> &receivers, LinearSolver solver, bool covariance) {
+        TdoaSolution result;
+        result.method = SolutionMethod::LinearLeastSquares;
+        if (receivers.size() < 4) {
+            result.status = SolutionStatus::NotEnoughReceivers;
+            return result;
+        }
+        if (!finiteReceivers(receivers)) {
+            return result;
+        }
+        result = closedForm(receivers, linearTDOA(receivers, solver), SolutionMethod::LinearLeastSquares);
+        if (covariance && result.usable()) {
+            result.covariance = positionCovariance(receivers, result.position);
+        }
+        return result;
+    }
+
+    TdoaSolution exactSolution(const std::vector<Receiver> &receivers, bool getPositive) {
+        TdoaSolution result;
+        if (receivers.size() < 3) {
+            result.status = SolutionStatus::NotEnoughReceivers;
+            return result;
+        }
+        if (!finiteReceivers(receivers)) {
+            return result;
+        }
+
+        ExactFrame frame{receivers[0], receivers[1], receivers[2]};
+        result = frame.solution(receivers[0].timestamp - receivers[1].timestamp,
+                                receivers[0].timestamp - receivers[2].timestamp, getPositive);
+        if (result.usable()) {
+            result.residualNorm = residualNorm(receivers, result.position);
+        }
+        return result;
+    }
+
+    TdoaSolution nonlinearSolution(const std::vector<Receiver> &receivers, const Eigen::Vector2d &initialGuess,
+                                   NlsBackend backend, ceres::Solver::Summary *summary, bool covariance) {
+        TdoaSolution result;
+        result.method = SolutionMethod::NonlinearLeastSquares;
+        if (receivers.size() < 3) {
+            result.status = SolutionStatus::NotEnoughReceivers;
+            return result;
+        }
+        if (!finiteReceivers(receivers) || !initialGuess.allFinite()) {
+            return result;
         }
 
-        return res;
+        if (backend == NlsBackend::Ceres) {
+            return nonlinearSolution(receivers, initialGuess, CostModel::Analytic, summary, covariance);
+        }
+
+        auto lm = levenbergMarquardt(receivers, initialGuess);
+        result.position = lm.position;
+        result.iterations = lm.iterations;
+        result.status = !lm.position.allFinite() ? SolutionStatus::SolverFailure
+                        : lm.converged ? SolutionStatus::Ok : SolutionStatus::NoConvergence;
+        result.residualNorm = residualNorm(receivers, result.position);
+        if (covariance && result.usable()) {
+            result.covariance = covarianceFromGaussNewton(lm.gaussNewton, receivers.size());
+        }
+        return result;
     }
 
-    Eigen::Vector2d linearTDOA(const std::vector<Receiver> &receivers) {
-        // Set up for the LS problem
-        Eigen::MatrixXd A(receivers.size() - 1, 3);
-        Eigen::VectorXd b(receivers.size() - 1);
+    TdoaSolution nonlinearSolution(const std::vector<Receiver> &receivers, const Eigen::Vector2d &initialGuess,
+                                   CostModel model, ceres::Solver::Summary *summary, bool covariance) {
+        TdoaSolution result;
+        result.method = SolutionMethod::NonlinearLeastSquares;
+        if (receivers.size() < 3) {
+            result.status = SolutionStatus::NotEnoughReceivers;
+            return result;
+        }
+        if (!finiteReceivers(receivers) || !initialGuess.allFinite()) {
+            return result;
+        }
 
-        for (int i = 0; i < receivers.size() - 1; i++) {
-            A(i, 0) = -(receivers[0].timestamp - receivers[i + 1].timestamp);
-            A(i, 1) = receivers[0].x - receivers[i + 1].x;
-            A(i, 2) = receivers[0].y - receivers[i + 1].y;
+        ceres::Solver::Summary local;
+        auto &ceresSummary = summary ? *summary : local;
+        result.position = nonlinearOptimization(receivers, initialGuess, model, &ceresSummary);
+        ceresStatus(ceresSummary, result);
+        result.residualNorm = residualNorm(receivers, result.position);
+        if (covariance && result.usable()) {
+            result.covariance = positionCovariance(receivers, result.position);
+        }
+        return result;
+    }
 
-            b[i] = 0.5 * (
-                    std::pow(receivers[0].timestamp - receivers[i + 1].timestamp, 2)
-                    + norm_sq(receivers[0].x, receivers[0].y)
-                    - norm_sq(receivers[i + 1].x, receivers[i + 1].y)
-            );
+    TdoaSolution nonlinearSolution(const Eigen::Ref<const Eigen::Matrix2Xd> &positions,
+                                   const Eigen::Ref<const Eigen::VectorXd> &timestamps,
+                                   const Eigen::Vector2d &initialGuess, CostModel model,
+                                   ceres::Solver::Summary *summary, bool covariance) {
+        TdoaSolution result;
+        result.method = SolutionMethod::NonlinearLeastSquares;
+        if (positions.cols() < 3) {
+            result.status = SolutionStatus::NotEnoughReceivers;
+            return result;
+        }
+        if (positions.cols() != timestamps.size() || !positions.allFinite() || !timestamps.allFinite() ||
+            !initialGuess.allFinite()) {
+            return result;
         }
 
-        // We use Eigen's SVD decomposition to solve the problem
-        Eigen::Vector3d r;
-        if (receivers.size() == 4) {
-            r = A.colPivHouseholderQr().solve(b);
+        ceres::Solver::Summary local;
+        auto &ceresSummary = summary ? *summary : local;
+        result.position = nonlinearOptimization(positions, timestamps, initialGuess, model, &ceresSummary);
+        ceresStatus(ceresSummary, result);
+        result.residualNorm = residualNorm(positions, timestamps, result.position);
+        if (covariance && result.usable()) {
+            result.covariance = positionCovariance(positions, result.position);
+        }
+        return result;
+    }
+
+    TdoaSolution locateSolution(const std::vector<Receiver> &receivers, Method method, bool covariance) {
+        TdoaSolution result;
+        if (method == Method::Robust) {
+            result = robustSolution(receivers).solution;
+        } else if (method == Method::MultiStart) {
+            result = multiStartSolution(receivers);
         } else {
-            r = A.bdcSvd(Eigen::ComputeThinU | Eigen::ComputeThinV).solve(b);
+            result = initialSolution(receivers);
+            if (method == Method::Nonlinear && result.usable()) {
+                auto roots = result.roots;
+                result = nonlinearSolution(receivers, result.position);
+                result.roots = roots;
+            }
+        }
+
+        if (covariance && result.usable()) {
+            result.covariance = positionCovariance(receivers, result.position);
         }
-        return Eigen::Vector2d{r[1], r[2]};
+        return result;
     }
 
-    Eigen::Vector2d nonlinearOptimization(const std::vector<Receiver> &receivers,
-                                          const Eigen::Vector2d &initialGuess) {
-        ceres::Problem problem;
-        auto x = initialGuess[0];
-        auto y = initialGuess[1];
-        for (size_t i = 0; i < receivers.size() - 1; i++) {
-            for (size_t j = i + 1; j < receivers.size(); j++) {
-                problem.AddResidualBlock(
-                        new ceres::AutoDiffCostFunction<TdoaError, 1, 1, 1>(
-                                new TdoaError(receivers[i], receivers[j])
-                        ),
-                        nullptr,
-                        &x, &y
-                );
+    namespace {
+        // Calls visit(row, rhs) for every row of the linear system [-tau_0i, (s0 - si)^T] [r0, position] =
+        // 0.5 * (tau_0i^2 + |s0|^2 - |si|^2), without storing it
+        template<int Dim, typename Visit>
+        void linearRows(const std::vector<ReceiverT<Dim>> &receivers, Visit &&visit) {
+            constexpr int U = Dim + 1; // Unknowns: r0 and the position
+            const PositionT<Dim> s0 = receivers[0].position();
+            for (size_t i = 1; i < receivers.size(); i++) {
+                const PositionT<Dim> si = receivers[i].position();
+                const double tau = receivers[0].timestamp - receivers[i].timestamp;
+
+                Eigen::Matrix<double, 1, U> row;
+                row[0] = -tau;
+                row.template tail<Dim>() = (s0 - si).transpose();
+                visit(row, 0.5 * (std::pow(tau, 2) + s0.squaredNorm() - si.squaredNorm()));
             }
         }
 
-        ceres::Solver::Options options;
-        ceres::Solver::Summary summary;
-        ceres::Solve(options, &problem, &summary);
+        // QR of [A | b] by Givens rotations (detail::GivensTriangle). A (nearly) rank-deficient R, or useSvd, gets
+        // the minimum-norm solution
+        template<int Dim>
+        Eigen::Matrix<double, Dim + 1, 1> givensSolve(const std::vector<ReceiverT<Dim>> &receivers, bool useSvd) {
+            constexpr int U = Dim + 1;
+            detail::GivensTriangle<U> qr;
+            linearRows<Dim>(receivers, [&](const Eigen::Matrix<double, 1, U> &row, double rhs) { qr.add(row, rhs); });
+
+            const auto diagonal = qr.R.diagonal().cwiseAbs();
+            if (useSvd || diagonal.minCoeff() <= U * std::numeric_limits<double>::epsilon() * diagonal.maxCoeff()) {
+                return qr.svdSolve();
+            }
+            return qr.R.template triangularView<Eigen::Upper>().solve(qr.qtb);
+        }
 
-        return Eigen::Vector2d{x, y};
+        // A^T A and A^T b in one pass, then a (Dim + 1)^2 LDLT. Returns false when checkConditioning is set and the
+        // normal equations lose too many digits: their condition number is the square of that of A
+        template<int Dim>
+        bool normalSolve(const std::vector<ReceiverT<Dim>> &receivers, bool checkConditioning,
+                         Eigen::Matrix<double, Dim + 1, 1> &r) {
+            constexpr int U = Dim + 1;
+            Eigen::Matrix<double, U, U> ata = Eigen::Matrix<double, U, U>::Zero();
+            Eigen::Matrix<double, U, 1> atb = Eigen::Matrix<double, U, 1>::Zero();
+            linearRows<Dim>(receivers, [&](const Eigen::Matrix<double, 1, U> &row, double rhs) {
+                ata.noalias() += row.transpose() * row;
+                atb.noalias() += row.transpose() * rhs;
+            });
+
+            const Eigen::LDLT<Eigen::Matrix<double, U, U>> ldlt{ata};
+            if (checkConditioning &&
+                (ldlt.info() != Eigen::Success || !(ldlt.rcond() > kNormalEquationsRcond))) {
+                return false;
+            }
+            r = ldlt.solve(atb);
+            return true;
+        }
+    }
+
+    template<int Dim>
+    PositionT<Dim> linearTDOA(const std::vector<ReceiverT<Dim>> &receivers, LinearSolver solver) {
+        constexpr int U = Dim + 1;
+        if (receivers.size() < static_cast<size_t>(Dim + 2)) {
+            throw std::invalid_argument("Least Squares needs at least Dim + 2 receivers");
+        }
+
+        Eigen::Matrix<double, U, 1> r;
+        switch (solver) {
+            case LinearSolver::NormalEquations:
+                normalSolve<Dim>(receivers, false, r);
+                break;
+            case LinearSolver::Givens:
+                r = givensSolve<Dim>(receivers, false);
+                break;
+            case LinearSolver::Svd:
+                r = givensSolve<Dim>(receivers, true);
+                break;
+            default:
+                if (!normalSolve<Dim>(receivers, true, r)) {
+                    r = givensSolve<Dim>(receivers, true);
+                }
+        }
+        return r.template tail<Dim>();
     }
+
+    template<int Dim>
+    PositionT<Dim> nonlinearOptimization(const std::vector<ReceiverT<Dim>> &receivers,
+                                         const PositionT<Dim> &initialGuess) {
+        return levenbergMarquardt<Dim>(receivers, initialGuess).position;
+    }
+
+    template PositionT<2> linearTDOA<2>(const std::vector<ReceiverT<2>> &, LinearSolver);
+    template PositionT<3> linearTDOA<3>(const std::vector<ReceiverT<3>> &, LinearSolver);
+    template PositionT<2> nonlinearOptimization<2>(const std::vector<ReceiverT<2>> &, const PositionT<2> &);
+    template PositionT<3> nonlinearOptimization<3>(const std::vector<ReceiverT<3>> &, const PositionT<3> &);
 }
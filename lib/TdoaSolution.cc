@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+#include <cmath>
+#include <limits>
+
+#include "../include/TdoaSolution.hh"
+
+namespace tdoapp {
+    const char *toString(SolutionStatus status) {
+        switch (status) {
+            case SolutionStatus::Ok:
+                return "ok";
+            case SolutionStatus::Ambiguous:
+                return "ambiguous";
+            case SolutionStatus::NoConvergence:
+                return "no convergence";
+            case SolutionStatus::TimedOut:
+                return "time budget spent";
+            case SolutionStatus::NoRealSolution:
+                return "no real solution";
+            case SolutionStatus::NoConsistentRoot:
+                return "no root consistent with the TDOAs";
+            case SolutionStatus::NotEnoughReceivers:
+                return "not enough receivers";
+            case SolutionStatus::InvalidInput:
+                return "invalid input";
+            case SolutionStatus::SolverFailure:
+                return "solver failure";
+        }
+        return "unknown";
+    }
+
+    const char *toString(SolutionMethod method) {
+        switch (method) {
+            case SolutionMethod::Exact:
+                return "exact";
+            case SolutionMethod::LinearLeastSquares:
+                return "linear least squares";
+            case SolutionMethod::NonlinearLeastSquares:
+                return "non-linear least squares";
+        }
+        return "unknown";
+    }
+
+    double residualNorm(const Eigen::Ref<const Eigen::Matrix2Xd> &positions,
+                        const Eigen::Ref<const Eigen::VectorXd> &timestamps, const Eigen::Vector2d &position) {
+        const double d0 = (position - positions.col(0)).norm();
+        double sum = 0.0;
+        for (Eigen::Index i = 1; i < positions.cols(); i++) {
+            const double di = (position - positions.col(i)).norm();
+            const double r = (timestamps[0] - timestamps[i]) - (d0 - di);
+            sum += r * r;
+        }
+        return std::sqrt(sum);
+    }
+
+    double residualNorm(const std::vector<Receiver> &receivers, const Eigen::Vector2d &position) {
+        if (receivers.empty()) {
+            return 0.0;
+        }
+        const double d0 = std::hypot(position[0] - receivers[0].x, position[1] - receivers[0].y);
+        double sum = 0.0;
+        for (size_t i = 1; i < receivers.size(); i++) {
+            const double di = std::hypot(position[0] - receivers[i].x, position[1] - receivers[i].y);
+            const double r = (receivers[0].timestamp - receivers[i].timestamp) - (d0 - di);
+            sum += r * r;
+        }
+        return std::sqrt(sum);
+    }
+
+    Eigen::Matrix2d covarianceFromGaussNewton(const Eigen::Matrix2d &gaussNewton, size_t n) {
+        // Closed-form 2x2 inverse; a singular matrix leaves a direction unobserved
+        const double det = gaussNewton.determinant();
+        if (!(det > std::numeric_limits<double>::epsilon() * gaussNewton.squaredNorm())) {
+            return Eigen::Matrix2d::Constant(std::numeric_limits<double>::infinity());
+        }
+        Eigen::Matrix2d adjugate;
+        adjugate << gaussNewton(1, 1), -gaussNewton(0, 1), -gaussNewton(1, 0), gaussNewton(0, 0);
+        return static_cast<double>(n) / det * adjugate;
+    }
+
+    namespace {
+        // Scatter of the unit vectors from every receiver to the position, with Welford's update so that far
+        // emitters, whose unit vectors are all alike, do not cancel out
+        template<typename Column>
+        Eigen::Matrix2d unitScatter(size_t n, const Eigen::Vector2d &position, Column &&column) {
+            Eigen::Matrix2d scatter = Eigen::Matrix2d::Zero();
+            Eigen::Vector2d mean = Eigen::Vector2d::Zero();
+            for (size_t i = 0; i < n; i++) {
+                const Eigen::Vector2d u = (position - column(i)).normalized();
+                const Eigen::Vector2d delta = u - mean;
+                mean += delta / static_cast<double>(i + 1);
+                scatter.noalias() += delta * (u - mean).transpose();
+            }
+            return scatter;
+        }
+    }
+
+    Eigen::Matrix2d positionCovariance(const Eigen::Ref<const Eigen::Matrix2Xd> &positions,
+                                       const Eigen::Vector2d &position) {
+        if (positions.cols() < 3 || !position.allFinite()) {
+            return Eigen::Matrix2d::Constant(std::numeric_limits<double>::quiet_NaN());
+        }
+        return covarianceFromGaussNewton(
+                unitScatter(static_cast<size_t>(positions.cols()), position,
+                            [&positions](size_t i) -> Eigen::Vector2d {
+                                return positions.col(static_cast<Eigen::Index>(i));
+                            }), 1);
+    }
+
+    Eigen::Matrix2d positionCovariance(const std::vector<Receiver> &receivers, const Eigen::Vector2d &position) {
+        if (receivers.size() < 3 || !position.allFinite()) {
+            return Eigen::Matrix2d::Constant(std::numeric_limits<double>::quiet_NaN());
+        }
+        return covarianceFromGaussNewton(
+                unitScatter(receivers.size(), position,
+                            [&receivers](size_t i) -> Eigen::Vector2d { return receivers[i].position(); }), 1);
+    }
+}
@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+#include <stdexcept>
+
+#include "../include/TdoaTracker.hh"
+
+namespace tdoapp {
+    namespace {
+        constexpr double epsilon = 1e-8; // Same regularization of the distances as TdoaError
+    }
+
+    TdoaTracker::TdoaTracker(const std::vector<Receiver> &receivers, const TrackerOptions &options)
+            : geometry_{receivers}, options_{options}, positions_(2, receivers.size()) {
+        if (!(options_.measurementSigma > 0.0) || options_.processNoise < 0.0 || !(options_.gate > 0.0)) {
+            throw std::invalid_argument("Tracker noise levels and gate must be positive");
+        }
+        for (size_t i = 0; i < receivers.size(); i++) {
+            positions_.col(static_cast<Eigen::Index>(i)) << receivers[i].x, receivers[i].y;
+        }
+
+        const auto m = static_cast<Eigen::Index>(receivers.size()) - 1;
+        z_.resize(m);
+        h_.resize(m);
+        H_.resize(m, 2);
+        S_.resize(m, m);
+        x_.setZero();
+        P_.setIdentity();
+    }
+
+    void TdoaTracker::predict(double dt) {
+        // x' = F x with F = [I, dt I; 0, I]; white acceleration noise integrated over dt
+        x_.head<2>() += dt * x_.tail<2>();
+
+        Eigen::Matrix4d F = Eigen::Matrix4d::Identity();
+        F.topRightCorner<2, 2>().diagonal().setConstant(dt);
+        P_ = F * P_ * F.transpose();
+
+        const double q = options_.processNoise;
+        P_.topLeftCorner<2, 2>().diagonal().array() += q * dt * dt * dt / 3.0;
+        P_.topRightCorner<2, 2>().diagonal().array() += q * dt * dt / 2.0;
+        P_.bottomLeftCorner<2, 2>().diagonal().array() += q * dt * dt / 2.0;
+        P_.bottomRightCorner<2, 2>().diagonal().array() += q * dt;
+    }
+
+    void TdoaTracker::measure(const Eigen::Vector2d &p) {
+        Eigen::Matrix2Xd u = (-positions_).colwise() + p;
+        Eigen::RowVectorXd d = (u.colwise().squaredNorm().array() + epsilon).sqrt();
+        u.array().rowwise() /= d.array();
+
+        const auto m = h_.size();
+        h_ = (d.tail(m).array() - d[0]).transpose();
+        H_ = (u.rightCols(m).colwise() - u.col(0)).transpose();
+    }
+
+    Eigen::Matrix2d TdoaTracker::fixCovariance(const Eigen::Vector2d &p) {
+        measure(p);
+
+        // (I + 1 1^T)^-1 = I - 1 1^T / N, so the information H^T R^-1 H takes O(N)
+        const double n = static_cast<double>(h_.size() + 1);
+        const Eigen::Vector2d s = H_.colwise().sum().transpose();
+        Eigen::Matrix2d information = (H_.transpose() * H_ - s * s.transpose() / n) /
+                                      (options_.measurementSigma * options_.measurementSigma);
+
+        // Nearly collinear receivers leave a direction without information
+        information.diagonal().array() += 1e-12 * information.trace();
+        return information.inverse();
+    }
+
+    void TdoaTracker::fusePosition(const Eigen::Vector2d &fix, const Eigen::Matrix2d &covariance) {
+        const Eigen::Matrix2d S = P_.topLeftCorner<2, 2>() + covariance;
+        const Eigen::Matrix<double, 4, 2> K = P_.leftCols<2>() * S.inverse();
+        x_ += K * (fix - x_.head<2>());
+        P_ -= K * P_.topRows<2>();
+        P_ = 0.5 * (P_ + P_.transpose()).eval();
+    }
+
+    TrackerUpdate TdoaTracker::update(double dt, const Eigen::Ref<const Eigen::VectorXd> &toas) {
+        if (static_cast<size_t>(toas.size()) != geometry_.size()) {
+            throw std::invalid_argument("Number of TOAs does not match the number of receivers");
+        }
+        if (dt < 0.0) {
+            throw std::invalid_argument("Time between updates can not be negative");
+        }
+
+        // New track: cold fix
+        if (!initialized_) {
+            Eigen::Vector2d fix = geometry_.nonlinearOptimization(toas, geometry_.initialGuess(toas),
+                                                                  options_.backend);
+            x_ << fix, 0.0, 0.0;
+            P_.setZero();
+            P_.topLeftCorner<2, 2>() = fixCovariance(fix);
+            P_.bottomRightCorner<2, 2>().diagonal().setConstant(options_.initialSpeedSigma *
+                                                                options_.initialSpeedSigma);
+            initialized_ = true;
+            return {fix, x_.tail<2>(), 0.0, true};
+        }
+
+        predict(dt);
+
+        // Score the TDOAs of the predicted position
+        const auto m = z_.size();
+        const double variance = options_.measurementSigma * options_.measurementSigma;
+        z_ = toas.tail(m).array() - toas[0];
+        measure(x_.head<2>());
+
+        S_.noalias() = H_ * P_.topLeftCorner<2, 2>() * H_.transpose();
+        S_.array() += variance;
+        S_.diagonal().array() += variance;
+        const Eigen::LDLT<Eigen::MatrixXd> ldlt{S_};
+        const Eigen::VectorXd innovation = z_ - h_;
+        const double nis = innovation.dot(ldlt.solve(innovation)) / static_cast<double>(m);
+
+        // Consistent with the track: EKF update
+        if (nis <= options_.gate) {
+            const Eigen::Matrix<double, 4, Eigen::Dynamic> PHt = P_.leftCols<2>() * H_.transpose();
+            const Eigen::Matrix<double, 4, Eigen::Dynamic> K = ldlt.solve(PHt.transpose()).transpose();
+            x_ += K * innovation;
+            P_ -= K * PHt.transpose();
+            P_ = 0.5 * (P_ + P_.transpose()).eval();
+            return {x_.head<2>(), x_.tail<2>(), nis, false};
+        }
+
+        // Outside the gate: full refinement, warm-started from the prediction
+        Eigen::Vector2d fix = geometry_.nonlinearOptimization(toas, x_.head<2>(), options_.backend);
+        const Eigen::Matrix2d covariance = fixCovariance(fix);
+
+        // A fix that the prediction can not explain either (e.g. a new emitter) restarts the track there
+        const Eigen::Vector2d delta = fix - x_.head<2>();
+        const Eigen::Matrix2d spread = P_.topLeftCorner<2, 2>() + covariance;
+        if (delta.dot(spread.ldlt().solve(delta)) / 2.0 > options_.gate) {
+            x_ << fix, 0.0, 0.0;
+            P_.setZero();
+            P_.topLeftCorner<2, 2>() = covariance;
+            P_.bottomRightCorner<2, 2>().diagonal().setConstant(options_.initialSpeedSigma *
+                                                                options_.initialSpeedSigma);
+        } else {
+            fusePosition(fix, covariance);
+        }
+        return {x_.head<2>(), x_.tail<2>(), nis, true};
+    }
+}
@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+#include <algorithm>
+
+#include "../include/ThreadPool.hh"
+
+namespace tdoapp {
+    ThreadPool::ThreadPool(unsigned threads)
+            : ranges_(threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threads) {
+        // Thread 0 is whoever calls parallelFor
+        for (unsigned id = 1; id < size(); id++) {
+            workers_.emplace_back(&ThreadPool::workerLoop, this, id);
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            stop_ = true;
+        }
+        start_.notify_all();
+        for (auto &worker: workers_) {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::parallelFor(size_t n, const std::function<void(size_t)> &fn, size_t grain) {
+        if (n == 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> loop{loopMutex_};
+        grain = std::max<size_t>(grain, 1);
+
+        // One contiguous block per thread
+        const size_t threads = ranges_.size();
+        for (size_t t = 0; t < threads; t++) {
+            ranges_[t].next.store(n * t / threads, std::memory_order_relaxed);
+            ranges_[t].end = n * (t + 1) / threads;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            fn_ = &fn;
+            grain_ = grain;
+            error_ = nullptr;
+            pending_ = static_cast<unsigned>(threads - 1);
+            generation_++;
+        }
+        start_.notify_all();
+
+        runChunks(0, fn, grain);
+
+        std::exception_ptr error;
+        {
+            std::unique_lock<std::mutex> lock{mutex_};
+            done_.wait(lock, [this]() { return pending_ == 0; });
+            fn_ = nullptr;
+            error = error_;
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    void ThreadPool::workerLoop(unsigned id) {
+        unsigned long seen = 0;
+        while (true) {
+            const std::function<void(size_t)> *fn;
+            size_t grain;
+            {
+                std::unique_lock<std::mutex> lock{mutex_};
+                start_.wait(lock, [&]() { return stop_ || generation_ != seen; });
+                if (stop_) {
+                    return;
+                }
+                seen = generation_;
+                fn = fn_;
+                grain = grain_;
+            }
+
+            runChunks(id, *fn, grain);
+
+            std::lock_guard<std::mutex> lock{mutex_};
+            if (--pending_ == 0) {
+                done_.notify_one();
+            }
+        }
+    }
+
+    void ThreadPool::runChunks(unsigned id, const std::function<void(size_t)> &fn, size_t grain) {
+        // Own block first, then steal from the others
+        const auto threads = static_cast<unsigned>(ranges_.size());
+        for (unsigned k = 0; k < threads; k++) {
+            Range &range = ranges_[(id + k) % threads];
+            while (true) {
+                const size_t begin = range.next.fetch_add(grain, std::memory_order_relaxed);
+                if (begin >= range.end) {
+                    break;
+                }
+
+                const size_t end = std::min(begin + grain, range.end);
+                for (size_t i = begin; i < end; i++) {
+                    try {
+                        fn(i);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock{mutex_};
+                        if (!error_) {
+                            error_ = std::current_exception();
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,178 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/ToaFile.hh"
+
+namespace tdoapp {
+    namespace {
+        bool littleEndian() {
+            const std::uint16_t one = 1;
+            unsigned char first;
+            std::memcpy(&first, &one, 1);
+            return first == 1;
+        }
+
+        void checkEndianness() {
+            if (!littleEndian()) {
+                throw std::runtime_error("TOA files are only supported on little-endian hosts");
+            }
+        }
+
+        template<typename T>
+        T readField(const unsigned char *data, size_t offset) {
+            T value;
+            std::memcpy(&value, data + offset, sizeof(T));
+            return value;
+        }
+
+        template<typename T>
+        void writeField(std::ofstream &ofs, T value) {
+            ofs.write(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+    }
+
+    bool isToaFile(const std::string &path) {
+        std::ifstream ifs(path, std::ios::binary);
+        char magic[sizeof(kToaFileMagic)];
+        return ifs.read(magic, sizeof(magic)) && std::memcmp(magic, kToaFileMagic, sizeof(magic)) == 0;
+    }
+
+    ToaFile::ToaFile(const std::string &path) {
+        checkEndianness();
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open TOA file: " + path);
+        }
+
+        struct stat st{};
+        if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(kToaFileHeaderSize)) {
+            ::close(fd);
+            throw std::runtime_error("TOA file is too small: " + path);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+
+        data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data_ == MAP_FAILED) {
+            data_ = nullptr;
+            throw std::runtime_error("Could not map TOA file: " + path);
+        }
+        // Rows are consumed front to back
+        ::madvise(data_, size_, MADV_SEQUENTIAL);
+
+        const auto *bytes = static_cast<const unsigned char *>(data_);
+        const auto version = readField<std::uint32_t>(bytes, 4);
+        const auto receiverCount = readField<std::uint64_t>(bytes, 8);
+        const auto measurementCount = readField<std::uint64_t>(bytes, 16);
+
+        // Sizes are checked by division first so that a corrupted header can not overflow them
+        const size_t payload = size_ - kToaFileHeaderSize;
+        const bool valid = std::memcmp(bytes, kToaFileMagic, sizeof(kToaFileMagic)) == 0 &&
+                           version == kToaFileVersion &&
+                           receiverCount <= payload / (2 * sizeof(double)) &&
+                           (receiverCount == 0 || measurementCount <= payload / (receiverCount * sizeof(double))) &&
+                           payload == (2 + measurementCount) * receiverCount * sizeof(double);
+        if (!valid) {
+            unmap();
+            throw std::runtime_error("Not a valid TOA file: " + path);
+        }
+
+        receiverCount_ = static_cast<size_t>(receiverCount);
+        measurementCount_ = static_cast<size_t>(measurementCount);
+    }
+
+    ToaFile::~ToaFile() {
+        unmap();
+    }
+
+    ToaFile::ToaFile(ToaFile &&other) noexcept
+            : data_{std::exchange(other.data_, nullptr)}, size_{std::exchange(other.size_, 0)},
+              receiverCount_{std::exchange(other.receiverCount_, 0)},
+              measurementCount_{std::exchange(other.measurementCount_, 0)} {}
+
+    ToaFile &ToaFile::operator=(ToaFile &&other) noexcept {
+        if (this != &other) {
+            unmap();
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+            receiverCount_ = std::exchange(other.receiverCount_, 0);
+            measurementCount_ = std::exchange(other.measurementCount_, 0);
+        }
+        return *this;
+    }
+
+    void ToaFile::unmap() {
+        if (data_ != nullptr) {
+            ::munmap(data_, size_);
+            data_ = nullptr;
+        }
+    }
+
+    Eigen::Map<const Eigen::Matrix2Xd> ToaFile::positions() const {
+        const auto *base = static_cast<const unsigned char *>(data_) + kToaFileHeaderSize;
+        return {reinterpret_cast<const double *>(base), 2, static_cast<Eigen::Index>(receiverCount_)};
+    }
+
+    Eigen::Map<const ToaMatrix> ToaFile::toas() const {
+        const auto *base = static_cast<const unsigned char *>(data_) + kToaFileHeaderSize +
+                           2 * receiverCount_ * sizeof(double);
+        return {reinterpret_cast<const double *>(base), static_cast<Eigen::Index>(measurementCount_),
+                static_cast<Eigen::Index>(receiverCount_)};
+    }
+
+    std::vector<Receiver> ToaFile::receivers() const {
+        std::vector<Receiver> result;
+        result.reserve(receiverCount_);
+        const auto p = positions();
+        for (Eigen::Index i = 0; i < p.cols(); i++) {
+            result.emplace_back(p(0, i), p(1, i));
+        }
+        return result;
+    }
+
+    void writeToaFile(const std::string &path, const std::vector<Receiver> &receivers,
+                      const Eigen::Ref<const ToaMatrix> &toas) {
+        checkEndianness();
+        if (static_cast<size_t>(toas.cols()) != receivers.size()) {
+            throw std::invalid_argument("Number of TOA columns does not match the number of receivers");
+        }
+
+        std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+        if (!ofs.is_open()) {
+            throw std::runtime_error("Could not open TOA file for writing: " + path);
+        }
+
+        ofs.write(kToaFileMagic, sizeof(kToaFileMagic));
+        writeField<std::uint32_t>(ofs, kToaFileVersion);
+        writeField<std::uint64_t>(ofs, receivers.size());
+        writeField<std::uint64_t>(ofs, static_cast<std::uint64_t>(toas.rows()));
+        writeField<std::uint64_t>(ofs, 0);
+
+        for (const auto &r: receivers) {
+            writeField(ofs, r.x);
+            writeField(ofs, r.y);
+        }
+
+        // Rows of a Ref may be strided, but each one is contiguous
+        for (Eigen::Index i = 0; i < toas.rows(); i++) {
+            ofs.write(reinterpret_cast<const char *>(toas.row(i).data()),
+                      static_cast<std::streamsize>(toas.cols() * sizeof(double)));
+        }
+
+        if (!ofs.flush()) {
+            throw std::runtime_error("Could not write TOA file: " + path);
+        }
+    }
+}
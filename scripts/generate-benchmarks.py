@@ -5,6 +5,7 @@
 # std functions
 import argparse
 import json
+import struct
 
 # imported modules
 import numpy as np
@@ -22,6 +23,7 @@ def main():
     parser.add_argument('-n', '--number-receivers', required=True, type=int)  # Number of receivers to use
     parser.add_argument('-v', '--number-experiments', default=100, type=int)  # How many experiments to generate
     parser.add_argument('-s', '--sigma', default=1.0, type=float)  #
+    parser.add_argument('-b', '--binary', action='store_true')  # Write the binary TOA format instead of JSON
 
     args = parser.parse_args()
 
@@ -36,6 +38,14 @@ def main():
     distances = np.linalg.norm(center - receivers, axis=1)
     measurements = distances + sigma*np.random.randn(n, r)
 
+    # Binary TOA file (see include/ToaFile.hh): header, receiver positions and row-major TOA matrix
+    if args.binary:
+        with open(args.filename, 'wb') as f:
+            f.write(struct.pack('<4sIQQQ', b'TDOA', 1, r, n, 0))
+            f.write(receivers.astype('<f8').tobytes())
+            f.write(measurements.astype('<f8').tobytes())
+        return
+
     # Saving dictionary
     benchmark = {'center': center.tolist()}
 
@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: Apache-2.0
+//
+// Copyright (c) 2023 Yago Lizarribar
+
+#ifndef TDOAPP_COMPUTEPOOL_HH
+#define TDOAPP_COMPUTEPOOL_HH
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tdoapp {
+    // Worker threads fed from a bounded FIFO queue. Submitting never blocks: when the queue is full the task is
+    // refused, so the caller can shed load instead of piling up latency.
+    class ComputePool {
+    public:
+        using Task = std::function<void()>;
+
+        // 0 threads uses all the hardware threads
+        ComputePool(unsigned threads, size_t queueSize) : capacity_{queueSize} {
+            if (threads == 0) {
+                threads = std::max(1u, std::thread::hardware_concurrency());
+            }
+            workers_.reserve(threads);
+            for (unsigned i = 0; i < threads; i++) {
+                workers_.emplace_back([this]() { workerLoop(); });
+            }
+        }
+
+        // Runs whatever is still queued and joins the workers
+        ~ComputePool() {
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                stop_ = true;
+            }
+            ready_.notify_all();
+            for (auto &worker: workers_) {
+                worker.join();
+            }
+        }
+
+        ComputePool(const ComputePool &) = delete;
+
+        ComputePool &operator=(const ComputePool &) = delete;
+
+        // Queues the task unless the queue is full (returns false). Tasks must not throw
+        bool trySubmit(Task &&task) {
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                if (stop_ || queue_.size() >= capacity_) {
+                    return false;
+                }
+                queue_.push_back(std::move(task));
+            }
+            ready_.notify_one();
+            return true;
+        }
+
+        size_t queued() const {
+            std::lock_guard<std::mutex> lock{mutex_};
+            return queue_.size();
+        }
+
+        unsigned size() const { return static_cast<unsigned>(workers_.size()); }
+
+        size_t capacity() const { return capacity_; }
+
+    private:
+        void workerLoop() {
+            for (;;) {
+                Task task;
+                {
+                    std::unique_lock<std::mutex> lock{mutex_};
+                    ready_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+                    if (queue_.empty()) {
+                        return;
+                    }
+                    task = std::move(queue_.front());
+                    queue_.pop_front();
+                }
+                task();
+            }
+        }
+
+        const size_t capacity_;
+        std::vector<std::thread> workers_;
+        mutable std::mutex mutex_;
+        std::condition_variable ready_;
+        std::deque<Task> queue_;
+        bool stop_ = false;
+    };
+}
+
+#endif //TDOAPP_COMPUTEPOOL_HH
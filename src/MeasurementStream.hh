@@ -0,0 +1,273 @@
+// SPDX-License-Identifier: Apache-2.0
+//
+// Copyright (c) 2023 Yago Lizarribar
+
+#ifndef TDOAPP_MEASUREMENTSTREAM_HH
+#define TDOAPP_MEASUREMENTSTREAM_HH
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "../include/Geodetic.hh"
+#include "../include/Receiver.hh"
+#include "../include/TdoaBatch.hh"
+
+namespace tdoapp {
+    using MeasurementCallback = std::function<void(Measurement &&)>;
+
+    // Values in the JSON array of a receiver: [x, y, t], or [latitude, longitude, altitude, t] for geodetic input
+    template<typename M>
+    constexpr size_t kReceiverValues = 3;
+
+    template<>
+    constexpr size_t kReceiverValues<GeodeticMeasurement> = 4;
+
+    inline void appendReceiver(Measurement &measurement, const double *values) {
+        measurement.emplace_back(values[0], values[1], values[2]);
+    }
+
+    inline void appendReceiver(GeodeticMeasurement &measurement, const double *values) {
+        measurement.push_back({values[0], values[1], values[2], values[3]});
+    }
+
+    // Receivers are taken in the numeric order of their keys ("0", "1", ..., "10", ...) whatever the order they were
+    // written in, so that the DOM and the SAX paths agree on receiver 0. Non-numeric keys go last, by name
+    inline bool receiverKeyLess(const std::string &a, const std::string &b) {
+        auto index = [](const std::string &key) {
+            unsigned long long value = 0;
+            auto [end, ec] = std::from_chars(key.data(), key.data() + key.size(), value);
+            bool numeric = ec == std::errc{} && end == key.data() + key.size() && !key.empty();
+            return std::make_pair(!numeric, numeric ? value : 0ULL);
+        };
+        auto ia = index(a), ib = index(b);
+        return ia != ib ? ia < ib : a < b;
+    }
+
+    // Entries of a JSON object keyed by receiver, in receiverKeyLess order
+    inline std::vector<std::pair<std::string, const nlohmann::json *>> receiverItems(const nlohmann::json &object) {
+        std::vector<std::pair<std::string, const nlohmann::json *>> items;
+        for (const auto &[key, value]: object.items()) {
+            items.emplace_back(key, &value);
+        }
+        std::stable_sort(items.begin(), items.end(),
+                         [](const auto &a, const auto &b) { return receiverKeyLess(a.first, b.first); });
+        return items;
+    }
+
+    inline void reportReceiverNotArray(size_t expected) {
+        std::cerr << "Wrong format for JSON value in measurement. Expected " << expected << "-element array"
+                  << std::endl;
+    }
+
+    inline void reportReceiverFormat(size_t expected, size_t size, bool numeric) {
+        std::cerr << "Wrong format for JSON value in measurement. Expected " << expected
+                  << "-element array of numbers" << std::endl
+                  << "The size was: " << size << ". All numbers: " << numeric << "" << std::endl;
+    }
+
+    // Measurement from its JSON object: {"0": [x, y, t], "1": [x, y, t], ...}
+    template<typename M = Measurement>
+    M toMeasurement(const nlohmann::json &measurement) {
+        M r;
+        for (const auto &receiver: receiverItems(measurement)) {
+            const auto *values = receiver.second;
+            if (!values->is_array()) {
+                reportReceiverNotArray(kReceiverValues<M>);
+                continue;
+            }
+
+            bool numeric = std::all_of(values->begin(), values->end(),
+                                       [](const nlohmann::json &v) { return v.is_number(); });
+            if (!numeric || values->size() != kReceiverValues<M>) {
+                reportReceiverFormat(kReceiverValues<M>, values->size(), numeric);
+                continue;
+            }
+
+            double v[kReceiverValues<M>];
+            for (size_t i = 0; i < kReceiverValues<M>; i++) {
+                v[i] = (*values)[i].template get<double>();
+            }
+            appendReceiver(r, v);
+        }
+        return r;
+    }
+
+    // SAX handler for the {"measurements": [...]} layout. Every measurement is handed over as soon as its object
+    // closes, so only one measurement is held in memory no matter how large the input is. Receivers are ordered and
+    // validated exactly as toMeasurement does.
+    template<typename M = Measurement>
+    class MeasurementSaxHandler {
+        // Nesting levels: 1 root object, 2 measurements array, 3 measurement object, 4 receiver array
+        enum Depth { kRoot = 1, kMeasurements = 2, kMeasurement = 3, kReceiver = 4 };
+
+        using Values = std::array<double, kReceiverValues<M>>;
+
+        std::function<void(M &&)> onMeasurement_;
+        std::vector<std::pair<std::string, Values>> receivers_; // Receivers of the open measurement, keyed
+        std::string key_;
+        Values values_ = {};
+        size_t count_ = 0;
+        bool numeric_ = true; // Whether every value of the open receiver array is a number
+        bool inReceiver_ = false; // Whether the open value of a receiver key is an array (objects are not counted)
+        int depth_ = 0;
+        bool measurementsKey_ = false;
+        bool inMeasurements_ = false;
+
+        // A receiver key whose value is not an array: reported and skipped, as toMeasurement does
+        bool receiverValue() const { return inMeasurements_ && depth_ == kMeasurement; }
+
+        bool value(double v) {
+            if (inReceiver_ && depth_ == kReceiver) {
+                if (count_ < kReceiverValues<M>) {
+                    values_[count_] = v;
+                }
+                count_++;
+            } else if (receiverValue()) {
+                reportReceiverNotArray(kReceiverValues<M>);
+            }
+            return true;
+        }
+
+        // Anything but a number inside a receiver array rejects the receiver
+        bool other() {
+            if (inReceiver_ && depth_ == kReceiver) {
+                numeric_ = false;
+                count_++;
+            } else if (receiverValue()) {
+                reportReceiverNotArray(kReceiverValues<M>);
+            }
+            return true;
+        }
+
+    public:
+        using json = nlohmann::json;
+
+        bool found = false; // Whether the measurements field was present
+
+        explicit MeasurementSaxHandler(std::function<void(M &&)> onMeasurement)
+                : onMeasurement_{std::move(onMeasurement)} {}
+
+        bool null() { return other(); }
+
+        bool boolean(bool) { return other(); }
+
+        bool number_integer(json::number_integer_t v) { return value(static_cast<double>(v)); }
+
+        bool number_unsigned(json::number_unsigned_t v) { return value(static_cast<double>(v)); }
+
+        bool number_float(json::number_float_t v, const json::string_t &) { return value(v); }
+
+        bool string(json::string_t &) { return other(); }
+
+        bool binary(json::binary_t &) { return other(); }
+
+        bool start_object(std::size_t) {
+            other();
+            depth_++;
+            if (inMeasurements_ && depth_ == kMeasurement) {
+                receivers_.clear();
+            }
+            return true;
+        }
+
+        bool key(json::string_t &key) {
+            if (depth_ == kRoot) {
+                measurementsKey_ = key == "measurements";
+            } else if (inMeasurements_ && depth_ == kMeasurement) {
+                key_ = key;
+            }
+            return true;
+        }
+
+        bool end_object() {
+            if (inMeasurements_ && depth_ == kMeasurement) {
+                std::stable_sort(receivers_.begin(), receivers_.end(),
+                                 [](const auto &a, const auto &b) { return receiverKeyLess(a.first, b.first); });
+                M measurement;
+                for (const auto &receiver: receivers_) {
+                    appendReceiver(measurement, receiver.second.data());
+                }
+                onMeasurement_(std::move(measurement));
+            }
+            depth_--;
+            return true;
+        }
+
+        bool start_array(std::size_t) {
+            if (receiverValue()) {
+                inReceiver_ = true;
+                count_ = 0;
+                numeric_ = true;
+            } else {
+                other();
+            }
+            depth_++;
+            if (depth_ == kMeasurements && measurementsKey_) {
+                inMeasurements_ = true;
+                found = true;
+            }
+            return true;
+        }
+
+        bool end_array() {
+            if (inReceiver_ && depth_ == kReceiver) {
+                inReceiver_ = false;
+                if (numeric_ && count_ == kReceiverValues<M>) {
+                    receivers_.emplace_back(key_, values_);
+                } else {
+                    reportReceiverFormat(kReceiverValues<M>, count_, numeric_);
+                }
+            } else if (inMeasurements_ && depth_ == kMeasurements) {
+                inMeasurements_ = false;
+            }
+            depth_--;
+            return true;
+        }
+
+        bool parse_error(std::size_t position, const std::string &, const nlohmann::detail::exception &ex) {
+            std::cerr << "Error parsing receiver file at byte " << position << ": " << ex.what() << std::endl;
+            return false;
+        }
+    };
+
+    // Streams the measurements of a {"measurements": [...]} document. Returns false on a parse error or when the
+    // measurements field is missing
+    template<typename M = Measurement, typename Callback>
+    bool streamMeasurements(std::istream &is, const Callback &onMeasurement) {
+        MeasurementSaxHandler<M> handler{onMeasurement};
+        return nlohmann::json::sax_parse(is, &handler) && handler.found;
+    }
+
+    // Streams NDJSON input: one measurement object per line. Blank lines are skipped, malformed ones reported
+    template<typename M = Measurement, typename Callback>
+    bool streamNdjson(std::istream &is, const Callback &onMeasurement) {
+        std::string line;
+        size_t lineNumber = 0;
+        bool ok = true;
+        while (std::getline(is, line)) {
+            lineNumber++;
+            if (line.find_first_not_of(" \t\r") == std::string::npos) {
+                continue;
+            }
+
+            auto measurement = nlohmann::json::parse(line, nullptr, false);
+            if (measurement.is_discarded() || !measurement.is_object()) {
+                std::cerr << "Error parsing line " << lineNumber << " of the receiver file" << std::endl;
+                ok = false;
+                continue;
+            }
+            onMeasurement(toMeasurement<M>(measurement));
+        }
+        return ok;
+    }
+}
+
+#endif //TDOAPP_MEASUREMENTSTREAM_HH
@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: Apache-2.0
+//
+// Copyright (c) 2023 Yago Lizarribar
+
+#ifndef TDOAPP_METRICS_HH
+#define TDOAPP_METRICS_HH
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace tdoapp {
+    // Metrics are split in per-thread shards, each on its own cache line: recording is a relaxed atomic add on the
+    // shard of the calling thread, so handler and compute threads never contend. Reading sums all the shards.
+    constexpr size_t kMetricShards = 16;
+
+    // Shard of the calling thread, assigned round-robin the first time it records anything
+    inline size_t metricShard() {
+        static std::atomic<size_t> next{0};
+        thread_local const size_t shard = next.fetch_add(1, std::memory_order_relaxed) % kMetricShards;
+        return shard;
+    }
+
+    // Monotonic counter (Prometheus counter)
+    class ShardedCounter {
+    public:
+        void add(uint64_t n = 1) {
+            shards_[metricShard()].value.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        uint64_t value() const {
+            uint64_t total = 0;
+            for (const auto &shard: shards_) {
+                total += shard.value.load(std::memory_order_relaxed);
+            }
+            return total;
+        }
+
+    private:
+        struct alignas(64) Shard {
+            std::atomic<uint64_t> value{0};
+        };
+        std::array<Shard, kMetricShards> shards_;
+    };
+
+    // Value going up and down (Prometheus gauge), e.g. requests in flight. A thread may decrement what another
+    // incremented: single shards can go negative, the sum is exact
+    class ShardedGauge {
+    public:
+        void add(int64_t n) {
+            shards_[metricShard()].value.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        int64_t value() const {
+            int64_t total = 0;
+            for (const auto &shard: shards_) {
+                total += shard.value.load(std::memory_order_relaxed);
+            }
+            return total;
+        }
+
+    private:
+        struct alignas(64) Shard {
+            std::atomic<int64_t> value{0};
+        };
+        std::array<Shard, kMetricShards> shards_;
+    };
+
+    // Cumulative histogram over fixed upper bounds (Prometheus histogram)
+    class Histogram {
+    public:
+        explicit Histogram(std::vector<double> bounds) : bounds_{std::move(bounds)} {
+            for (auto &shard: shards_) {
+                shard.counts = std::make_unique<std::atomic<uint64_t>[]>(bounds_.size() + 1);
+            }
+        }
+
+        void observe(double value) {
+            size_t bucket = 0;
+            while (bucket < bounds_.size() && value > bounds_[bucket]) {
+                bucket++;
+            }
+
+            auto &shard = shards_[metricShard()];
+            shard.counts[bucket].fetch_add(1, std::memory_order_relaxed);
+
+            // No fetch_add for doubles before C++20: CAS on the bits, uncontended within the shard
+            uint64_t expected = shard.sum.load(std::memory_order_relaxed), desired;
+            do {
+                double sum;
+                std::memcpy(&sum, &expected, sizeof(sum));
+                sum += value;
+                std::memcpy(&desired, &sum, sizeof(sum));
+            } while (!shard.sum.compare_exchange_weak(expected, desired, std::memory_order_relaxed));
+        }
+
+        // Writes the _bucket, _sum and _count series. labels is either empty or 'key="value",'
+        void render(std::ostream &out, const std::string &name, const std::string &labels = "") const {
+            std::vector<uint64_t> counts(bounds_.size() + 1, 0);
+            double sum = 0.0;
+            for (const auto &shard: shards_) {
+                for (size_t i = 0; i < counts.size(); i++) {
+                    counts[i] += shard.counts[i].load(std::memory_order_relaxed);
+                }
+                uint64_t bits = shard.sum.load(std::memory_order_relaxed);
+                double value;
+                std::memcpy(&value, &bits, sizeof(value));
+                sum += value;
+            }
+
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i < bounds_.size(); i++) {
+                cumulative += counts[i];
+                out << name << "_bucket{" << labels << "le=\"" << bounds_[i] << "\"} " << cumulative << "\n";
+            }
+            cumulative += counts.back();
+            out << name << "_bucket{" << labels << "le=\"+Inf\"} " << cumulative << "\n";
+
+            const auto plain = labels.empty() ? std::string{} : "{" + labels.substr(0, labels.size() - 1) + "}";
+            out << name << "_sum" << plain << " " << sum << "\n";
+            out << name << "_count" << plain << " " << cumulative << "\n";
+        }
+
+    private:
+        struct alignas(64) Shard {
+            std::unique_ptr<std::atomic<uint64_t>[]> counts;
+            std::atomic<uint64_t> sum{0}; // Bits of a double
+        };
+        std::vector<double> bounds_;
+        std::array<Shard, kMetricShards> shards_;
+    };
+
+    // Seconds elapsed since construction, for the stage histograms
+    class StageTimer {
+    public:
+        StageTimer() : start_{std::chrono::steady_clock::now()} {}
+
+        double seconds() const {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        }
+
+    private:
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    // Latency buckets from 5 us to 1 s
+    inline std::vector<double> latencyBuckets() {
+        return {5e-6, 1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4, 1e-3, 2.5e-3, 5e-3, 1e-2, 2.5e-2, 5e-2, 0.1, 0.25, 0.5,
+                1.0};
+    }
+}
+
+#endif //TDOAPP_METRICS_HH
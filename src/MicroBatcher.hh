@@ -0,0 +1,197 @@
+// SPDX-License-Identifier: Apache-2.0
+//
+// Copyright (c) 2023 Yago Lizarribar
+
+#ifndef TDOAPP_MICROBATCHER_HH
+#define TDOAPP_MICROBATCHER_HH
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "../include/TdoaBatch.hh"
+#include "../include/TdoaLocator.hh"
+#include "ComputePool.hh"
+
+namespace tdoapp {
+    // Coalesces the measurements of concurrent requests. A batch is closed once it holds maxBatch requests or
+    // the oldest one has waited for the window, whichever comes first, and is then solved as a single task on
+    // the compute pool with locateGrouped, so requests from the same deployment share their geometry.
+    class MicroBatcher {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        // Called from the compute thread after every locateGrouped call, with its method, number of measurements
+        // and duration. The stages inside it are not observable one by one
+        using SolvedCallback = std::function<void(Method, size_t, double)>;
+
+        struct Request {
+            std::vector<Measurement> measurements;
+            Method method = Method::Linear;
+            // One position per measurement, NaN when it could not be solved. Called from a compute thread
+            std::function<void(std::vector<Eigen::Vector2d> &&)> onResult;
+            // The compute pool refused the batch
+            std::function<void()> onRejected;
+            Clock::time_point arrival;
+        };
+
+        struct Stats {
+            std::uint64_t batches = 0;
+            std::uint64_t requests = 0;
+            std::uint64_t measurements = 0;
+            std::uint64_t rejectedBatches = 0;
+            std::uint64_t maxBatchRequests = 0;
+            std::uint64_t totalWaitUs = 0; // Summed over requests
+            std::uint64_t maxWaitUs = 0;
+        };
+
+        MicroBatcher(std::chrono::microseconds window, size_t maxBatch, ComputePool &pool,
+                     SolvedCallback onSolved = {})
+                : window_{window}, maxBatch_{std::max<size_t>(1, maxBatch)}, pool_{pool},
+                  onSolved_{std::move(onSolved)}, thread_{[this]() { run(); }} {}
+
+        // Closes the pending batch and stops. Must be destroyed before the pool
+        ~MicroBatcher() {
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                stop_ = true;
+            }
+            ready_.notify_one();
+            thread_.join();
+        }
+
+        MicroBatcher(const MicroBatcher &) = delete;
+
+        MicroBatcher &operator=(const MicroBatcher &) = delete;
+
+        void submit(Request &&request) {
+            request.arrival = Clock::now();
+            size_t pending;
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                pending_.push_back(std::move(request));
+                pending = pending_.size();
+            }
+            // Wake up to open a window or to close a full batch
+            if (pending == 1 || pending >= maxBatch_) {
+                ready_.notify_one();
+            }
+        }
+
+        Stats stats() const {
+            std::lock_guard<std::mutex> lock{statsMutex_};
+            return stats_;
+        }
+
+    private:
+        void run() {
+            std::unique_lock<std::mutex> lock{mutex_};
+            for (;;) {
+                ready_.wait(lock, [this]() { return stop_ || !pending_.empty(); });
+                if (pending_.empty()) {
+                    return;
+                }
+
+                const auto deadline = pending_.front().arrival + window_;
+                ready_.wait_until(lock, deadline, [this]() { return stop_ || pending_.size() >= maxBatch_; });
+
+                const auto count = std::min(pending_.size(), maxBatch_);
+                std::vector<Request> batch{std::make_move_iterator(pending_.begin()),
+                                           std::make_move_iterator(pending_.begin() + count)};
+                pending_.erase(pending_.begin(), pending_.begin() + count);
+
+                lock.unlock();
+                dispatch(std::move(batch));
+                lock.lock();
+            }
+        }
+
+        void dispatch(std::vector<Request> &&batch) {
+            const auto now = Clock::now();
+            {
+                std::lock_guard<std::mutex> lock{statsMutex_};
+                stats_.batches++;
+                stats_.requests += batch.size();
+                stats_.maxBatchRequests = std::max<std::uint64_t>(stats_.maxBatchRequests, batch.size());
+                for (const auto &request: batch) {
+                    auto wait = static_cast<std::uint64_t>(
+                            std::chrono::duration_cast<std::chrono::microseconds>(now - request.arrival).count());
+                    stats_.measurements += request.measurements.size();
+                    stats_.totalWaitUs += wait;
+                    stats_.maxWaitUs = std::max(stats_.maxWaitUs, wait);
+                }
+            }
+
+            // Shared so that a refused task leaves the batch in place to reject it. The task does not capture this:
+            // it may run after the batcher is gone
+            auto shared = std::make_shared<std::vector<Request>>(std::move(batch));
+            if (!pool_.trySubmit([shared, onSolved = onSolved_]() { solve(*shared, onSolved); })) {
+                {
+                    std::lock_guard<std::mutex> lock{statsMutex_};
+                    stats_.rejectedBatches++;
+                }
+                for (auto &request: *shared) {
+                    request.onRejected();
+                }
+            }
+        }
+
+        // Solves all the measurements of one method together and hands every request its slice
+        static void solve(std::vector<Request> &batch, const SolvedCallback &onSolved) {
+            for (auto method: {Method::Linear, Method::Nonlinear, Method::Robust, Method::MultiStart}) {
+                std::vector<Measurement> measurements;
+                for (const auto &request: batch) {
+                    if (request.method == method) {
+                        measurements.insert(measurements.end(), request.measurements.begin(),
+                                            request.measurements.end());
+                    }
+                }
+                if (measurements.empty()) {
+                    continue;
+                }
+
+                const auto start = Clock::now();
+                auto results = locateGrouped(measurements, method);
+                if (onSolved) {
+                    onSolved(method, measurements.size(),
+                             std::chrono::duration<double>(Clock::now() - start).count());
+                }
+                auto next = results.begin();
+                for (auto &request: batch) {
+                    if (request.method == method) {
+                        auto end = next + static_cast<std::ptrdiff_t>(request.measurements.size());
+                        request.onResult(std::vector<Eigen::Vector2d>(next, end));
+                        next = end;
+                    }
+                }
+            }
+        }
+
+        const std::chrono::microseconds window_;
+        const size_t maxBatch_;
+        ComputePool &pool_;
+        const SolvedCallback onSolved_;
+
+        std::mutex mutex_;
+        std::condition_variable ready_;
+        std::deque<Request> pending_;
+        bool stop_ = false;
+
+        mutable std::mutex statsMutex_;
+        Stats stats_;
+
+        std::thread thread_; // Last, so that it starts with everything else initialized
+    };
+}
+
+#endif //TDOAPP_MICROBATCHER_HH
@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: Apache-2.0
+//
+// Copyright (c) 2023 Yago Lizarribar
+
+#ifndef TDOAPP_RECEIVERREGISTRY_HH
+#define TDOAPP_RECEIVERREGISTRY_HH
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../include/Geodetic.hh"
+#include "../include/Receiver.hh"
+#include "../include/TdoaGeometry.hh"
+#include "../include/TdoaIndex.hh"
+
+namespace tdoapp {
+    // Receiver set registered once, so that requests only carry its TOAs
+    struct ReceiverSet {
+        ReceiverSet(std::vector<Receiver> receivers, std::shared_ptr<const GeodeticProjection> projection,
+                    const TdoaIndex *index)
+                : receivers{std::move(receivers)}, geometry{this->receivers}, projection{std::move(projection)},
+                  index{index} {}
+
+        std::vector<Receiver> receivers; // Planar positions, zero timestamps
+        TdoaGeometry geometry;
+        std::shared_ptr<const GeodeticProjection> projection; // Only for sets given in WGS-84
+        const TdoaIndex *index;                               // Loaded index built for these receivers, if any
+    };
+
+    // Named receiver sets shared by the server threads. Lookups read an immutable snapshot of the whole map, taken
+    // with an atomic load and without locks, so they never wait for a registration. Registrations copy the
+    // snapshot, change the copy and publish it (read-copy-update); they are serialized among themselves. A set
+    // stays alive while a request still holds it, even after it was replaced. The number of sets is capped, which
+    // also bounds the copy a registration makes
+    class ReceiverRegistry {
+    public:
+        using SetPtr = std::shared_ptr<const ReceiverSet>;
+
+        enum class Added {
+            Created,
+            Replaced,
+            Full // New id while capacity sets are registered: nothing changed
+        };
+
+        explicit ReceiverRegistry(size_t capacity) : capacity_{capacity} {}
+
+        SetPtr find(const std::string &id) const {
+            const auto sets = std::atomic_load(&sets_);
+            const auto found = sets->find(id);
+            return found == sets->end() ? nullptr : found->second;
+        }
+
+        // Replacing the set of an existing id is always possible, new ids only below the capacity
+        Added add(const std::string &id, SetPtr set) {
+            std::lock_guard<std::mutex> lock{writeMutex_};
+            const auto current = std::atomic_load(&sets_);
+            const bool replaced = current->count(id) != 0;
+            if (!replaced && current->size() >= capacity_) {
+                return Added::Full;
+            }
+            auto sets = std::make_shared<Sets>(*current);
+            (*sets)[id] = std::move(set);
+            std::atomic_store(&sets_, std::shared_ptr<const Sets>{std::move(sets)});
+            return replaced ? Added::Replaced : Added::Created;
+        }
+
+        size_t size() const { return std::atomic_load(&sets_)->size(); }
+
+    private:
+        using Sets = std::unordered_map<std::string, SetPtr>;
+
+        size_t capacity_;
+        std::shared_ptr<const Sets> sets_ = std::make_shared<const Sets>();
+        std::mutex writeMutex_;
+    };
+}
+
+#endif //TDOAPP_RECEIVERREGISTRY_HH
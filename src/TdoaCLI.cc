@@ -2,15 +2,25 @@
 //
 // Copyright (c) 2023 Yago Lizarribar
 
+#include <algorithm>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <memory>
 
 #include <boost/program_options.hpp>
 #include <nlohmann/json.hpp>
 
+#include "../include/Geodetic.hh"
 #include "../include/Receiver.hh"
+#include "../include/TdoaBatch.hh"
+#include "../include/TdoaGeometry.hh"
+#include "../include/TdoaIndex.hh"
 #include "../include/TdoaLocator.hh"
+#include "../include/ThreadPool.hh"
+#include "../include/ToaFile.hh"
+#include "MeasurementStream.hh"
 
 using std::cout;
 using std::cerr;
@@ -22,8 +32,13 @@ using nlohmann::json;
 
 struct options {
     int optimization_level = 1;
+    unsigned int threads = 1;
+    bool stream = false;
+    bool geodetic = false;
+    std::string format;
     std::string receiver_file;
     std::string output;
+    std::string index_file;
 };
 
 int parse_commandline(int argc, char **argv, options &opt) {
@@ -31,11 +46,26 @@ int parse_commandline(int argc, char **argv, options &opt) {
     po::options_description desc("TdoaCLI. Command-Line utility to solve TDOA problems.\nAllowed options:");
     desc.add_options()
             ("help,h", "Show this message")
-            ("receiver,r", po::value<std::string>(), "JSON file with receiver positions & timestamps")
+            ("receiver,r", po::value<std::string>(), "JSON file with receiver positions & timestamps (-: stdin)")
+            ("format,f", po::value<std::string>(&opt.format)->default_value("json"),
+             "Input format. Options: (json: {\"measurements\": [...]}; ndjson: one measurement per line; "
+             "binary: TOA file from TdoaConvert, detected automatically). Default: json")
+            ("stream,s", po::bool_switch(&opt.stream),
+             "Solve and write every measurement as soon as it is read, with bounded memory. Implied by ndjson")
             ("method,m", po::value<int>(&opt.optimization_level)->default_value(1),
-             "Method to use. Options: (1: linear, 2: nonlinear). Default: 1")
+             "Method to use. Options: (1: linear, 2: nonlinear, 3: robust to outlier TOAs, 4: grid multi-start). "
+             "Default: 1")
+            ("threads,j", po::value<unsigned int>(&opt.threads)->default_value(1),
+             "Number of threads solving measurements in parallel. Options: (0: all cores; N). Default: 1")
             ("output,o", po::value<std::string>(&opt.output)->default_value("stdout"),
-             "Where to dump the output. Options: (stdout; filename). Default: stdout.");
+             "Where to dump the output. Options: (stdout; filename). Default: stdout.")
+            ("index,x", po::value<std::string>(&opt.index_file),
+             "TDOA index file giving the non-linear fixes of binary input their starting point. Built and written "
+             "there when it does not exist yet")
+            ("geodetic,g", po::bool_switch(&opt.geodetic),
+             "Receivers are [latitude, longitude, altitude, timestamp]: WGS-84 degrees and meters, timestamps in "
+             "meters (seconds times the speed of light). Every receiver set is projected once to a local plane and "
+             "the positions are written as latitude and longitude");
 
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -58,10 +88,27 @@ int parse_commandline(int argc, char **argv, options &opt) {
         return 1;
     }
 
+    // Input format
+    if (opt.format != "json" && opt.format != "ndjson" && opt.format != "binary") {
+        cerr << "Unsupported input format: " << opt.format << ". Options are: json, ndjson, binary" << endl;
+        return 1;
+    }
+    if (opt.format == "binary" && opt.receiver_file == "-") {
+        cerr << "Binary input must be a file, it is memory-mapped" << endl;
+        return 1;
+    }
+
     // Last we select the method
     if (vm.count("method")) {
         int method = vm["method"].as<int>();
-        std::string m = method == 1 ? "Linear/Least Squares" : "Non-Linear Least Squares";
+        if (method < 1 || method > 4) {
+            cerr << "Unsupported method: " << method << ". Options are: 1, 2, 3, 4" << endl;
+            return 1;
+        }
+        std::string m = method == 1 ? "Linear/Least Squares"
+                        : method == 2 ? "Non-Linear Least Squares"
+                        : method == 3 ? "RANSAC + Non-Linear Least Squares"
+                        : "Grid multi-start Non-Linear Least Squares";
         cout << "Optimization Method was set to: " << m << "." << endl;
         opt.optimization_level = method;
     } else {
@@ -72,6 +119,74 @@ int parse_commandline(int argc, char **argv, options &opt) {
     return 0;
 }
 
+// Index of the deployment: loaded when the file exists, built and written otherwise
+std::unique_ptr<tdoapp::TdoaIndex> openIndex(const std::string &path, const std::vector<tdoapp::Receiver> &receivers) {
+    std::unique_ptr<tdoapp::TdoaIndex> index;
+    if (std::ifstream{path}.good()) {
+        index = std::make_unique<tdoapp::TdoaIndex>(tdoapp::TdoaIndex::load(path));
+        if (!index->matches(receivers)) {
+            throw std::runtime_error("Index " + path + " was built for other receivers");
+        }
+        cout << "Loaded index " << path;
+    } else {
+        index = std::make_unique<tdoapp::TdoaIndex>(receivers);
+        index->save(path);
+        cout << "Built index " << path;
+    }
+    cout << " (" << index->size() << " points, " << index->memoryBytes() / 1024 << " KiB) in "
+         << index->buildSeconds() << " s" << endl;
+    return index;
+}
+
+// Binary TOA file: rows are solved straight from the mapping, a chunk at a time
+int locateToaFile(const options &opt, const std::function<void(const Eigen::Vector2d &)> &writeFn,
+                  tdoapp::Method method) {
+    try {
+        tdoapp::ToaFile file{opt.receiver_file};
+        const tdoapp::TdoaGeometry geometry{file.receivers()};
+        const auto toas = file.toas();
+        const auto index = opt.index_file.empty() ? nullptr : openIndex(opt.index_file, file.receivers());
+
+        tdoapp::ThreadPool pool{opt.threads};
+        const auto chunkSize = static_cast<Eigen::Index>(1024 * pool.size());
+        for (Eigen::Index start = 0; start < toas.rows(); start += chunkSize) {
+            const auto rows = std::min(chunkSize, toas.rows() - start);
+            const auto chunk = toas.middleRows(start, rows);
+            for (const auto &pos: tdoapp::locateBatch(geometry, chunk, method, pool, index.get())) {
+                writeFn(pos);
+            }
+        }
+    } catch (const std::exception &e) {
+        cerr << "Error reading binary receiver file: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Planar measurement of geodetic input, with the projection that takes its fix back to WGS-84. Invalid coordinates
+// leave it empty, so that it gets NaN like any other measurement that can not be solved
+tdoapp::Measurement projectMeasurement(tdoapp::GeodeticCache &cache, const tdoapp::GeodeticMeasurement &measurement,
+                                       std::shared_ptr<const tdoapp::GeodeticProjection> &projection) {
+    try {
+        projection = cache.projection(measurement);
+        return projection->project(measurement);
+    } catch (const std::invalid_argument &e) {
+        cerr << "Wrong geodetic measurement: " << e.what() << endl;
+        projection.reset();
+        return {};
+    }
+}
+
+// Latitude and longitude of a fix on the plane of a projection
+Eigen::Vector2d toLatLon(const std::shared_ptr<const tdoapp::GeodeticProjection> &projection,
+                         const Eigen::Vector2d &position) {
+    if (!projection) {
+        return Eigen::Vector2d::Constant(std::numeric_limits<double>::quiet_NaN());
+    }
+    const auto geodetic = projection->toGeodetic(position);
+    return {geodetic.latitude, geodetic.longitude};
+}
+
 int main(int argc, char **argv) {
     // Command line options
     auto opt = std::make_shared<options>();
@@ -79,43 +194,125 @@ int main(int argc, char **argv) {
         return 1;
     }
 
-    // Get receivers information
-    std::ifstream ifs(opt->receiver_file);
-    if (!ifs.is_open()) {
-        cerr << "Error: Could not open receiver file" << endl;
+    // Binary files are recognized by their magic, whatever the selected format
+    if (opt->receiver_file != "-" && tdoapp::isToaFile(opt->receiver_file)) {
+        opt->format = "binary";
+    }
+    if (opt->geodetic && opt->format == "binary") {
+        cerr << "Binary input has planar receivers, it can not be geodetic" << endl;
         return 1;
     }
+    if (!opt->index_file.empty() && opt->format != "binary") {
+        cerr << "The index is only used with binary input, ignoring it" << endl;
+    }
+
+    // Get receivers information
+    std::ifstream ifs;
+    std::istream *input = &std::cin;
+    if (opt->receiver_file != "-") {
+        ifs.open(opt->receiver_file);
+        if (!ifs.is_open()) {
+            cerr << "Error: Could not open receiver file" << endl;
+            return 1;
+        }
+        input = &ifs;
+    }
+
+    // Write output to file or stdout
+    auto writeToStdout = opt->output == "stdout";
+    std::function<void(const Eigen::Vector2d &)> writeFn;
+    const char *first = opt->geodetic ? "Lat: " : "X: ";
+    const char *second = opt->geodetic ? ", Lon: " : ", Y: ";
+    const int precision = opt->geodetic ? 8 : 5;
+
+    if (writeToStdout) {
+        writeFn = [=](const Eigen::Vector2d &values) {
+            std::cout << std::fixed << std::setprecision(precision) << first << values[0] << second << values[1]
+                      << endl;
+        };
+    } else {
+        auto outFile = std::make_shared<std::ofstream>(opt->output);
+        writeFn = [=](const Eigen::Vector2d &values) mutable {
+            *outFile << std::fixed << std::setprecision(precision) << first << values[0] << second << values[1]
+                     << endl;
+        };
+    }
+
+    // Projections of the geodetic receiver sets, computed once per set
+    tdoapp::GeodeticCache cache;
+
+    auto method = static_cast<tdoapp::Method>(opt->optimization_level);
+
+    if (opt->format == "binary") {
+        if (writeToStdout) {
+            cout << endl << "Positioning Results" << endl << "----------" << endl;
+        }
+        return locateToaFile(*opt, writeFn, method);
+    }
+
+    // Streaming: measurements are solved and written in small chunks while the input is still being read
+    if (opt->stream || opt->format == "ndjson") {
+        if (writeToStdout) {
+            cout << endl << "Positioning Results" << endl << "----------" << endl;
+        }
+
+        // A single thread solves each measurement right away, several ones need a few to share
+        tdoapp::ThreadPool pool{opt->threads};
+        const size_t chunkSize = pool.size() == 1 ? 1 : 64 * pool.size();
+        std::vector<tdoapp::Measurement> chunk;
+        std::vector<std::shared_ptr<const tdoapp::GeodeticProjection>> projections;
+        chunk.reserve(chunkSize);
+
+        auto flush = [&]() {
+            const auto result = tdoapp::locateBatch(chunk, method, pool);
+            for (size_t i = 0; i < result.size(); i++) {
+                writeFn(opt->geodetic ? toLatLon(projections[i], result[i]) : result[i]);
+            }
+            chunk.clear();
+            projections.clear();
+        };
+        auto onMeasurement = [&](tdoapp::Measurement &&measurement) {
+            chunk.push_back(std::move(measurement));
+            if (chunk.size() >= chunkSize) {
+                flush();
+            }
+        };
+        auto onGeodetic = [&](tdoapp::GeodeticMeasurement &&measurement) {
+            projections.emplace_back();
+            onMeasurement(projectMeasurement(cache, measurement, projections.back()));
+        };
+
+        bool ok;
+        if (opt->geodetic) {
+            ok = opt->format == "ndjson" ? tdoapp::streamNdjson<tdoapp::GeodeticMeasurement>(*input, onGeodetic)
+                                         : tdoapp::streamMeasurements<tdoapp::GeodeticMeasurement>(*input, onGeodetic);
+        } else {
+            ok = opt->format == "ndjson" ? tdoapp::streamNdjson(*input, onMeasurement)
+                                         : tdoapp::streamMeasurements(*input, onMeasurement);
+        }
+        flush();
+        if (!ok) {
+            cerr << "Error parsing receiver file." << endl;
+            return 1;
+        }
+        return 0;
+    }
 
     // receiver file should contain a vector with a "measurements" field
     // Inside, there should a vector with N positions to analyze
-    auto receivers = json::parse(ifs);
-    std::vector<std::array<double, 2>> result;
+    auto receivers = json::parse(*input);
+    std::vector<tdoapp::Measurement> measurements;
+    std::vector<std::shared_ptr<const tdoapp::GeodeticProjection>> projections;
     if (receivers.contains("measurements")) {
 
         // Main loop over the received measurements
         for (const auto &measurement: receivers["measurements"]) {
-            // Looping over how many receivers
-            std::vector<tdoapp::Receiver> r;
-            for (const auto &[key, values]: measurement.items()) {
-                if (values.is_array() && values.size() == 3) {
-                    r.emplace_back(values[0].get<double>(),
-                                   values[1].get<double>(),
-                                   values[2].get<double>());
-                } else {
-                    cerr << "Wrong format for JSON value in measurement. Expected 3-element array" << endl
-                         << "The array assertion was: " << values.is_array() << ". The size was: " << values.size()
-                         << "" << endl;
-                }
-            }
-
-            // Run the optimization routines
-            auto init = tdoapp::initialGuess(r);
-
-            if (opt->optimization_level == 2) {
-                auto nlls = tdoapp::nonlinearOptimization(r, init);
-                result.emplace_back(std::array<double, 2>{nlls[0], nlls[1]});
+            if (opt->geodetic) {
+                projections.emplace_back();
+                measurements.push_back(projectMeasurement(
+                        cache, tdoapp::toMeasurement<tdoapp::GeodeticMeasurement>(measurement), projections.back()));
             } else {
-                result.emplace_back(std::array<double, 2>{init[0], init[1]});
+                measurements.push_back(tdoapp::toMeasurement(measurement));
             }
         }
 
@@ -124,28 +321,16 @@ int main(int argc, char **argv) {
         return 1;
     }
 
-    // Write output to file or stdout
-    auto writeToStdout = opt->output == "stdout";
-    std::function<void(const std::array<double, 2> &)> writeFn;
-
-    if (writeToStdout) {
-        writeFn = [](const std::array<double, 2> &values) {
-            std::cout << std::fixed << std::setprecision(5) << "X: " << values[0] << ", Y: " << values[1] << endl;
-        };
-    } else {
-        auto outFile = std::make_shared<std::ofstream>(opt->output);
-        writeFn = [outFile](const std::array<double, 2> &values) mutable {
-            *outFile << std::fixed << std::setprecision(5) << "X: " << values[0] << ", Y: " << values[1] << endl;
-        };
-    }
+    // Run the optimization routines, spread over the selected number of threads
+    auto result = tdoapp::locateBatch(measurements, method, opt->threads);
 
     // Loop through the vector and write values to the appropriate target
     if (writeToStdout) {
         cout << endl << "Positioning Results" << endl << "----------" << endl;
     }
-    for (const auto pos: result) {
-        writeFn(pos);
+    for (size_t i = 0; i < result.size(); i++) {
+        writeFn(opt->geodetic ? toLatLon(projections[i], result[i]) : result[i]);
     }
 
     return 0;
-}
\ No newline at end of file
+}
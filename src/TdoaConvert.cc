@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: Apache-2.0
+//
+// Copyright (c) 2023 Yago Lizarribar
+
+#include <fstream>
+#include <iostream>
+
+#include <boost/program_options.hpp>
+#include <nlohmann/json.hpp>
+
+#include "../include/Receiver.hh"
+#include "../include/ToaFile.hh"
+#include "MeasurementStream.hh"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+namespace po = boost::program_options;
+
+using nlohmann::json;
+
+struct options {
+    std::string input;
+    std::string output;
+};
+
+int parse_commandline(int argc, char **argv, options &opt) {
+
+    po::options_description desc("TdoaConvert. Converts JSON measurement files to the binary TOA format.\n"
+                                 "Allowed options:");
+    desc.add_options()
+            ("help,h", "Show this message")
+            ("input,i", po::value<std::string>(&opt.input),
+             "JSON file. Either {\"receivers\": {...}, \"measurements\": [{\"0\": t, ...}]} "
+             "or {\"measurements\": [{\"0\": [x, y, t], ...}]} with static receivers")
+            ("output,o", po::value<std::string>(&opt.output), "Binary TOA file to write");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    // Help text
+    if (vm.count("help")) {
+        cout << desc << "\n";
+        return 1;
+    }
+
+    if (!vm.count("input") || !vm.count("output")) {
+        cerr << "Must provide input and output files" << endl;
+        cerr << desc << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+// Receivers are taken in the numeric order of their keys, as TdoaCLI does (MeasurementStream.hh)
+
+// Layout with the receiver positions apart: {"receivers": {"0": [x, y], ...}, "measurements": [{"0": t, ...}]}
+bool readBenchmarkLayout(const json &document, std::vector<tdoapp::Receiver> &receivers, tdoapp::ToaMatrix &toas) {
+    for (const auto &[key, value]: tdoapp::receiverItems(document["receivers"])) {
+        const auto &receiver = *value;
+        if (!receiver.is_array() || receiver.size() != 2) {
+            cerr << "Wrong format for receiver " << key << ". Expected 2-element array" << endl;
+            return false;
+        }
+        receivers.emplace_back(receiver[0].get<double>(), receiver[1].get<double>());
+    }
+
+    const auto &measurements = document["measurements"];
+    toas.resize(static_cast<Eigen::Index>(measurements.size()), static_cast<Eigen::Index>(receivers.size()));
+    Eigen::Index row = 0;
+    for (const auto &measurement: measurements) {
+        if (measurement.size() != receivers.size()) {
+            cerr << "Measurement " << row << " has " << measurement.size() << " TOA values, expected "
+                 << receivers.size() << endl;
+            return false;
+        }
+
+        Eigen::Index col = 0;
+        for (const auto &[key, value]: tdoapp::receiverItems(measurement)) {
+            toas(row, col++) = value->get<double>();
+        }
+        row++;
+    }
+    return true;
+}
+
+// Layout with positions in every measurement: {"measurements": [{"0": [x, y, t], ...}]}.
+// The binary format stores the positions once, so they must be the same in all measurements
+bool readMeasurementLayout(const json &document, std::vector<tdoapp::Receiver> &receivers,
+                           tdoapp::ToaMatrix &toas) {
+    const auto &measurements = document["measurements"];
+    if (measurements.empty()) {
+        return true;
+    }
+
+    for (const auto &[key, value]: tdoapp::receiverItems(measurements[0])) {
+        const auto &values = *value;
+        if (!values.is_array() || values.size() != 3) {
+            cerr << "Wrong format for receiver " << key << ". Expected 3-element array" << endl;
+            return false;
+        }
+        receivers.emplace_back(values[0].get<double>(), values[1].get<double>());
+    }
+
+    toas.resize(static_cast<Eigen::Index>(measurements.size()), static_cast<Eigen::Index>(receivers.size()));
+    Eigen::Index row = 0;
+    for (const auto &measurement: measurements) {
+        if (measurement.size() != receivers.size()) {
+            cerr << "Measurement " << row << " has " << measurement.size() << " receivers, expected "
+                 << receivers.size() << endl;
+            return false;
+        }
+
+        Eigen::Index col = 0;
+        for (const auto &[key, value]: tdoapp::receiverItems(measurement)) {
+            const auto &values = *value;
+            const auto &r = receivers[static_cast<size_t>(col)];
+            if (!values.is_array() || values.size() != 3 ||
+                values[0].get<double>() != r.x || values[1].get<double>() != r.y) {
+                cerr << "Receiver " << key << " of measurement " << row
+                     << " moved. Only static receivers can be converted" << endl;
+                return false;
+            }
+            toas(row, col++) = values[2].get<double>();
+        }
+        row++;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    options opt;
+    if (parse_commandline(argc, argv, opt)) {
+        return 1;
+    }
+
+    std::ifstream ifs(opt.input);
+    if (!ifs.is_open()) {
+        cerr << "Error: Could not open input file" << endl;
+        return 1;
+    }
+
+    auto document = json::parse(ifs, nullptr, false);
+    if (document.is_discarded() || !document.contains("measurements")) {
+        cerr << "Error parsing input file. Could not find measurements field" << endl;
+        return 1;
+    }
+
+    std::vector<tdoapp::Receiver> receivers;
+    tdoapp::ToaMatrix toas;
+    bool ok = document.contains("receivers") ? readBenchmarkLayout(document, receivers, toas)
+                                             : readMeasurementLayout(document, receivers, toas);
+    if (!ok) {
+        return 1;
+    }
+
+    try {
+        tdoapp::writeToaFile(opt.output, receivers, toas);
+    } catch (const std::exception &e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+
+    cout << "Wrote " << toas.rows() << " measurements from " << receivers.size() << " receivers to "
+         << opt.output << endl;
+    return 0;
+}
@@ -2,15 +2,36 @@
 //
 // Copyright (c) 2023 Yago Lizarribar
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
 #include <csignal>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string_view>
+#include <vector>
 
 #include <boost/program_options.hpp>
 #include <drogon/drogon.h>
 
+#include "../include/Geodetic.hh"
+#include "../include/LocateCodec.hh"
+#include "../include/TdoaBatch.hh"
+#include "../include/TdoaIndex.hh"
 #include "../include/TdoaLocator.hh"
 #include "../include/Receiver.hh"
+#include "../include/GridInitializer.hh"
+#include "../include/RobustLocator.hh"
+#include "ComputePool.hh"
+#include "Metrics.hh"
+#include "MicroBatcher.hh"
+#include "ReceiverRegistry.hh"
 
 namespace po = boost::program_options;
 using namespace drogon;
@@ -29,6 +50,17 @@ struct DrogonOptions {
     std::string log_path;
     int port = 8095;
     int threadNum = 4;
+    unsigned int computeThreads = 0;
+    size_t queueSize = 1024;
+    int retryAfter = 1;
+    long batchWindow = 0;
+    size_t batchSize = 64;
+    std::string stats_endpoint;
+    std::string metrics_endpoint;
+    std::string receivers_endpoint;
+    size_t maxReceiverSets = 1024;
+    size_t maxSetReceivers = 1024;
+    std::vector<std::string> index_files;
 };
 
 int parse_commandline(int argc, char **argv, DrogonOptions &opt) {
@@ -46,7 +78,30 @@ int parse_commandline(int argc, char **argv, DrogonOptions &opt) {
             ("log-path,l", po::value<std::string>(&opt.log_path)->default_value("/tmp"),
                     "Logging path")
             ("thread-num,t", po::value<int>(&opt.threadNum)->default_value(8),
-                    "Number of threads for the server");
+                    "Number of threads for the server")
+            ("compute-threads,c", po::value<unsigned int>(&opt.computeThreads)->default_value(0),
+                    "Number of threads solving requests (0: all cores)")
+            ("queue-size,q", po::value<size_t>(&opt.queueSize)->default_value(1024),
+                    "Requests waiting for a compute thread before new ones get 503")
+            ("retry-after", po::value<int>(&opt.retryAfter)->default_value(1),
+                    "Seconds sent in the Retry-After header of 503 responses")
+            ("batch-window,w", po::value<long>(&opt.batchWindow)->default_value(0),
+                    "Microseconds a request may wait to be solved together with others (0: no batching)")
+            ("batch-size,b", po::value<size_t>(&opt.batchSize)->default_value(64),
+                    "Maximum number of requests solved together")
+            ("stats-endpoint,s", po::value<std::string>(&opt.stats_endpoint)->default_value("/stats"),
+                    "Where to create the batching statistics endpoint")
+            ("metrics-endpoint,m", po::value<std::string>(&opt.metrics_endpoint)->default_value("/metrics"),
+                    "Where to create the Prometheus metrics endpoint")
+            ("receivers-endpoint,r", po::value<std::string>(&opt.receivers_endpoint)->default_value("/receivers"),
+                    "Where to create the endpoint registering receiver sets")
+            ("max-receiver-sets", po::value<size_t>(&opt.maxReceiverSets)->default_value(1024),
+                    "Receiver sets kept at most. Registering a new id beyond them gets 507, replacing one is allowed")
+            ("max-set-receivers", po::value<size_t>(&opt.maxSetReceivers)->default_value(1024),
+                    "Receivers a registered set may have at most. Larger sets get 413")
+            ("index,x", po::value<std::vector<std::string>>(&opt.index_files)->composing(),
+                    "TDOA index file (see TdoaCLI --index) giving method 2 its starting point for the receivers it "
+                    "was built for. May be repeated");
 
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -58,9 +113,376 @@ int parse_commandline(int argc, char **argv, DrogonOptions &opt) {
         return 1;
     }
 
+    if (opt.batchWindow < 0 || opt.batchSize == 0) {
+        std::cerr << "The batch window can not be negative and the batch size must be at least 1" << std::endl;
+        return 1;
+    }
+
+    if (opt.maxReceiverSets == 0 || opt.maxSetReceivers < 3) {
+        std::cerr << "At least 1 receiver set of at least 3 receivers must be allowed" << std::endl;
+        return 1;
+    }
+
+    if (opt.queueSize == 0) {
+        std::cerr << "The compute queue size must be at least 1" << std::endl;
+        return 1;
+    }
+
     return 0;
 }
 
+// Optimization methods of /locate, numbered from 1 as tdoapp::Method
+constexpr int kMethods = 4;
+
+// Instrumentation of the server, exposed in the Prometheus text format. Recording never takes a lock (Metrics.hh)
+struct RestMetrics {
+    std::array<tdoapp::ShardedCounter, kMethods> requests;     // Accepted for solving, per method
+    std::array<tdoapp::ShardedCounter, kMethods> measurements; // Per method
+    std::array<tdoapp::ShardedGauge, kMethods> inFlight;       // Accepted and not answered yet, per method
+    tdoapp::ShardedCounter ok, badRequests, failed, rejected;
+
+    // Stages of a request
+    tdoapp::Histogram parse{tdoapp::latencyBuckets()};
+    tdoapp::Histogram initialGuess{tdoapp::latencyBuckets()};
+    tdoapp::Histogram nlls{tdoapp::latencyBuckets()};
+    tdoapp::Histogram robust{tdoapp::latencyBuckets()}; // Whole RANSAC solve of method 3
+    tdoapp::Histogram grid{tdoapp::latencyBuckets()};   // Whole multi-start solve of method 4
+    tdoapp::Histogram serialize{tdoapp::latencyBuckets()};
+
+    // Batched requests (--batch-window) skip the solver stages above and the Ceres series below: a batch is solved
+    // in one locateGrouped call per method, timed as a whole here
+    std::array<tdoapp::Histogram, kMethods> batchSolve{
+            tdoapp::Histogram{tdoapp::latencyBuckets()}, tdoapp::Histogram{tdoapp::latencyBuckets()},
+            tdoapp::Histogram{tdoapp::latencyBuckets()}, tdoapp::Histogram{tdoapp::latencyBuckets()}};
+    std::array<tdoapp::ShardedCounter, kMethods> batchMeasurements;
+
+    // Ceres solves of method 2
+    tdoapp::Histogram ceresIterations{{1, 2, 3, 5, 8, 13, 21, 34, 50}};
+    std::array<tdoapp::ShardedCounter, ceres::USER_FAILURE + 1> terminations; // Per ceres::TerminationType
+
+    void accepted(int method, size_t count) {
+        requests[method - 1].add();
+        measurements[method - 1].add(count);
+        inFlight[method - 1].add(1);
+    }
+
+    void answered(int method, tdoapp::ShardedCounter &outcome) {
+        inFlight[method - 1].add(-1);
+        outcome.add();
+    }
+
+    void solved(const ceres::Solver::Summary &summary) {
+        ceresIterations.observe(summary.num_successful_steps + summary.num_unsuccessful_steps);
+        if (summary.termination_type >= 0 && summary.termination_type < static_cast<int>(terminations.size())) {
+            terminations[summary.termination_type].add();
+        }
+    }
+
+    std::string render(const tdoapp::ComputePool &pool) const {
+        std::ostringstream out;
+        out << "# HELP tdoa_requests_total Requests accepted for solving\n"
+            << "# TYPE tdoa_requests_total counter\n";
+        for (int m = 0; m < kMethods; m++) {
+            out << "tdoa_requests_total{method=\"" << m + 1 << "\"} " << requests[m].value() << "\n";
+        }
+        out << "# HELP tdoa_measurements_total Measurements in the accepted requests\n"
+            << "# TYPE tdoa_measurements_total counter\n";
+        for (int m = 0; m < kMethods; m++) {
+            out << "tdoa_measurements_total{method=\"" << m + 1 << "\"} " << measurements[m].value() << "\n";
+        }
+        out << "# HELP tdoa_requests_in_flight Accepted requests not answered yet\n"
+            << "# TYPE tdoa_requests_in_flight gauge\n";
+        for (int m = 0; m < kMethods; m++) {
+            out << "tdoa_requests_in_flight{method=\"" << m + 1 << "\"} " << inFlight[m].value() << "\n";
+        }
+        out << "# HELP tdoa_responses_total Responses by status code\n"
+            << "# TYPE tdoa_responses_total counter\n"
+            << "tdoa_responses_total{code=\"200\"} " << ok.value() << "\n"
+            << "tdoa_responses_total{code=\"400\"} " << badRequests.value() << "\n"
+            << "tdoa_responses_total{code=\"500\"} " << failed.value() << "\n"
+            << "tdoa_responses_total{code=\"503\"} " << rejected.value() << "\n";
+
+        out << "# HELP tdoa_stage_seconds Time spent in each stage of a request\n"
+            << "# TYPE tdoa_stage_seconds histogram\n";
+        parse.render(out, "tdoa_stage_seconds", "stage=\"parse\",");
+        initialGuess.render(out, "tdoa_stage_seconds", "stage=\"initial_guess\",");
+        nlls.render(out, "tdoa_stage_seconds", "stage=\"nlls\",");
+        robust.render(out, "tdoa_stage_seconds", "stage=\"robust\",");
+        grid.render(out, "tdoa_stage_seconds", "stage=\"grid\",");
+        serialize.render(out, "tdoa_stage_seconds", "stage=\"serialize\",");
+
+        out << "# HELP tdoa_batch_solve_seconds Time spent solving the measurements of one method in a batch\n"
+            << "# TYPE tdoa_batch_solve_seconds histogram\n";
+        for (int m = 0; m < kMethods; m++) {
+            batchSolve[m].render(out, "tdoa_batch_solve_seconds", "method=\"" + std::to_string(m + 1) + "\",");
+        }
+        out << "# HELP tdoa_batch_measurements_total Measurements solved in batches\n"
+            << "# TYPE tdoa_batch_measurements_total counter\n";
+        for (int m = 0; m < kMethods; m++) {
+            out << "tdoa_batch_measurements_total{method=\"" << m + 1 << "\"} " << batchMeasurements[m].value()
+                << "\n";
+        }
+
+        out << "# HELP tdoa_ceres_iterations Iterations of every non-linear solve outside batches\n"
+            << "# TYPE tdoa_ceres_iterations histogram\n";
+        ceresIterations.render(out, "tdoa_ceres_iterations");
+        out << "# HELP tdoa_ceres_termination_total Non-linear solves by termination type\n"
+            << "# TYPE tdoa_ceres_termination_total counter\n";
+        for (size_t t = 0; t < terminations.size(); t++) {
+            out << "tdoa_ceres_termination_total{type=\""
+                << ceres::TerminationTypeToString(static_cast<ceres::TerminationType>(t)) << "\"} "
+                << terminations[t].value() << "\n";
+        }
+
+        out << "# HELP tdoa_compute_queue_length Requests waiting for a compute thread\n"
+            << "# TYPE tdoa_compute_queue_length gauge\n"
+            << "tdoa_compute_queue_length " << pool.queued() << "\n";
+        return out.str();
+    }
+};
+
+HttpResponsePtr badRequest(const std::string &message) {
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setStatusCode(k400BadRequest);
+    resp->setBody(message);
+    return resp;
+}
+
+// Projection of every measurement of a geodetic request, empty for planar ones
+using Projections = std::vector<std::shared_ptr<const tdoapp::GeodeticProjection>>;
+
+// Response body for the positions of a request, in WGS-84 for geodetic ones
+Json::Value resultJson(const std::vector<Eigen::Vector2d> &positions, int method, const Projections &projections) {
+    Json::Value result;
+    result["method"] = method;
+    Json::Value collections{Json::arrayValue};
+    for (size_t i = 0; i < positions.size(); i++) {
+        Json::Value p;
+        if (projections.empty()) {
+            p["x"] = positions[i][0]; p["y"] = positions[i][1];
+        } else {
+            const auto geodetic = projections[i]->toGeodetic(positions[i]);
+            p["latitude"] = geodetic.latitude; p["longitude"] = geodetic.longitude;
+            p["altitude"] = geodetic.altitude;
+        }
+        collections.append(p);
+    }
+    result["results"] = collections;
+    return result;
+}
+
+// Response body in the binary encoding, see LocateCodec.hh
+std::string resultBinary(const std::vector<Eigen::Vector2d> &positions, int method, const Projections &projections) {
+    if (projections.empty()) {
+        return tdoapp::encodeLocateResponse(method, positions);
+    }
+    std::vector<tdoapp::GeodeticPosition> geodetic;
+    geodetic.reserve(positions.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        geodetic.push_back(projections[i]->toGeodetic(positions[i]));
+    }
+    return tdoapp::encodeLocateResponse(method, geodetic);
+}
+
+// Media type of a Content-Type or Accept entry, without parameters or surrounding spaces and in lower case
+std::string mediaType(std::string_view value) {
+    value = value.substr(0, value.find(';'));
+    const auto begin = value.find_first_not_of(" \t");
+    if (begin == std::string_view::npos) {
+        return {};
+    }
+    std::string type{value.substr(begin, value.find_last_not_of(" \t") + 1 - begin)};
+    for (auto &c: type) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return type;
+}
+
+// Whether to answer in the binary encoding rather than JSON, from the Accept header. On equal preference, and without
+// the header, the response follows the request. Empty when neither of them is acceptable
+std::optional<bool> binaryResponse(const std::string &accept, bool binaryRequest) {
+    if (mediaType(accept).empty()) {
+        return binaryRequest;
+    }
+    double json = 0.0, binary = 0.0;
+    std::string_view entries{accept};
+    while (!entries.empty()) {
+        const auto entry = entries.substr(0, entries.find(','));
+        entries.remove_prefix(std::min(entries.size(), entry.size() + 1));
+
+        double q = 1.0;
+        const auto weight = entry.find("q=");
+        if (weight != std::string_view::npos && entry.find(';') < weight) {
+            q = std::atof(std::string{entry.substr(weight + 2)}.c_str());
+        }
+        const auto type = mediaType(entry);
+        if (type == "*/*" || type == "application/*") {
+            json = std::max(json, q);
+            binary = std::max(binary, q);
+        } else if (type == "application/json") {
+            json = std::max(json, q);
+        } else if (type == tdoapp::kLocateMediaType) {
+            binary = std::max(binary, q);
+        }
+    }
+    if (json <= 0.0 && binary <= 0.0) {
+        return std::nullopt;
+    }
+    return binary == json ? binaryRequest : binary > json;
+}
+
+// Loaded index built for the receivers of a measurement, if any
+const tdoapp::TdoaIndex *findIndex(const tdoapp::Measurement &r, const std::vector<tdoapp::TdoaIndex> &indices) {
+    for (const auto &index: indices) {
+        if (index.matches(r)) {
+            return &index;
+        }
+    }
+    return nullptr;
+}
+
+// Warm start of the non-linear solve from an index, given a measurement or its timestamps. Not usable without index
+// or when the lookup fails
+template<typename Timestamps>
+tdoapp::TdoaSolution warmStart(const Timestamps &timestamps, const tdoapp::TdoaIndex *index) {
+    tdoapp::TdoaSolution start;
+    if (index) {
+        start.position = index->warmStart(timestamps);
+        if (start.position.allFinite()) {
+            start.status = tdoapp::SolutionStatus::Ok;
+        }
+    }
+    return start;
+}
+
+// Methods 3 and 4, which need the whole measurement
+tdoapp::TdoaSolution searchSolution(const tdoapp::Measurement &r, int method, RestMetrics &metrics) {
+    tdoapp::StageTimer timer;
+    if (method == 3) {
+        auto robust = tdoapp::robustSolution(r);
+        metrics.robust.observe(timer.seconds());
+        return robust.solution;
+    }
+    auto solution = tdoapp::multiStartSolution(r);
+    metrics.grid.observe(timer.seconds());
+    return solution;
+}
+
+// Runs the optimization routines for every measurement of a request. Stops at the first measurement without a usable
+// fix and returns its status
+tdoapp::SolutionStatus solve(const std::vector<tdoapp::Measurement> &measurements, int method,
+                             const std::vector<tdoapp::TdoaIndex> &indices, RestMetrics &metrics,
+                             std::vector<Eigen::Vector2d> &positions) {
+    positions.reserve(measurements.size());
+    for (const auto &r: measurements) {
+        tdoapp::TdoaSolution solution;
+        if (method >= 3) {
+            solution = searchSolution(r, method, metrics);
+        } else {
+            // Non-linear fixes start from the index of their receivers when one was loaded
+            tdoapp::StageTimer guessTimer;
+            if (method == 2) {
+                solution = warmStart(r, findIndex(r, indices));
+            }
+            if (!solution.usable()) {
+                solution = tdoapp::initialSolution(r);
+            }
+            metrics.initialGuess.observe(guessTimer.seconds());
+
+            if (method == 2 && solution.usable()) {
+                ceres::Solver::Summary summary;
+                tdoapp::StageTimer nllsTimer;
+                solution = tdoapp::nonlinearSolution(r, solution.position, tdoapp::NlsBackend::Ceres, &summary);
+                metrics.nlls.observe(nllsTimer.seconds());
+                metrics.solved(summary);
+            }
+        }
+
+        if (!solution.usable()) {
+            return solution.status;
+        }
+        positions.push_back(solution.position);
+    }
+    return tdoapp::SolutionStatus::Ok;
+}
+
+// Same for the TOA rows of a registered set, solved on its precomputed geometry straight from the rows. Only methods
+// 3 and 4 need receivers: they reuse a single copy of those of the set
+tdoapp::SolutionStatus solve(const tdoapp::ToaMatrix &toas, const tdoapp::ReceiverSet &set, int method,
+                             RestMetrics &metrics, std::vector<Eigen::Vector2d> &positions) {
+    positions.reserve(static_cast<size_t>(toas.rows()));
+    tdoapp::Measurement r;
+    if (method >= 3) {
+        r = set.receivers;
+    }
+    for (Eigen::Index k = 0; k < toas.rows(); k++) {
+        const auto timestamps = toas.row(k).transpose();
+        tdoapp::TdoaSolution solution;
+        if (method >= 3) {
+            for (size_t i = 0; i < r.size(); i++) {
+                r[i].timestamp = timestamps[static_cast<Eigen::Index>(i)];
+            }
+            solution = searchSolution(r, method, metrics);
+        } else {
+            tdoapp::StageTimer guessTimer;
+            if (method == 2) {
+                solution = warmStart(timestamps, set.index);
+            }
+            if (!solution.usable()) {
+                solution = set.geometry.initialSolution(timestamps);
+            }
+            metrics.initialGuess.observe(guessTimer.seconds());
+
+            if (method == 2 && solution.usable()) {
+                ceres::Solver::Summary summary;
+                tdoapp::StageTimer nllsTimer;
+                solution = set.geometry.nonlinearSolution(timestamps, solution.position, tdoapp::NlsBackend::Ceres,
+                                                          &summary);
+                metrics.nlls.observe(nllsTimer.seconds());
+                metrics.solved(summary);
+            }
+        }
+
+        if (!solution.usable()) {
+            return solution.status;
+        }
+        positions.push_back(solution.position);
+    }
+    return tdoapp::SolutionStatus::Ok;
+}
+
+// Response of a solved request
+HttpResponsePtr solvedResponse(const std::vector<Eigen::Vector2d> &positions, int method,
+                               const Projections &projections, bool binary, RestMetrics &metrics) {
+    tdoapp::StageTimer timer;
+    HttpResponsePtr resp;
+    if (binary) {
+        resp = HttpResponse::newHttpResponse();
+        resp->setContentTypeString(tdoapp::kLocateMediaType);
+        resp->setBody(resultBinary(positions, method, projections));
+    } else {
+        resp = HttpResponse::newHttpJsonResponse(resultJson(positions, method, projections));
+    }
+    metrics.serialize.observe(timer.seconds());
+    return resp;
+}
+
+HttpResponsePtr serverBusy(const std::string &retryAfter) {
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setStatusCode(k503ServiceUnavailable);
+    resp->addHeader("Retry-After", retryAfter);
+    resp->setBody("Server is busy. Please retry later.\n");
+    return resp;
+}
+
+HttpResponsePtr solveFailed(const std::string &reason) {
+    LOG_WARN << "Could not compute position: " << reason << "\n";
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setStatusCode(k500InternalServerError);
+    resp->setBody("Could not compute position: " + reason + "\n");
+    return resp;
+}
+
 // Meat of the function
 int main(int argc, char **argv) {
     // Register our signal handler
@@ -81,97 +503,424 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    // Everything the compute tasks capture is declared before the pool and the batcher, so that it outlives the
+    // tasks still queued when they are destroyed. Indices are read once and only read from afterwards, so the
+    // compute threads share them without locks
+    std::vector<tdoapp::TdoaIndex> indices;
+    for (const auto &path: drogon_options->index_files) {
+        try {
+            indices.push_back(tdoapp::TdoaIndex::load(path));
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        const auto &index = indices.back();
+        LOG_INFO << "Loaded index " << path << " for " << index.receivers().size() << " receivers ("
+                 << index.size() << " points, " << index.memoryBytes() / 1024 << " KiB) in "
+                 << index.buildSeconds() << " s";
+    }
+
+    RestMetrics metrics;
+
+    // Projections of the geodetic receiver sets, shared by all the requests
+    tdoapp::GeodeticCache geodeticCache;
+
+    // Receiver sets registered by the clients, looked up without locks
+    tdoapp::ReceiverRegistry registry{drogon_options->maxReceiverSets};
+    const auto maxSetReceivers = drogon_options->maxSetReceivers;
+
+    // Solves run here, away from drogon's event loops
+    tdoapp::ComputePool pool{drogon_options->computeThreads, drogon_options->queueSize};
+    const auto retryAfter = std::to_string(drogon_options->retryAfter);
+
+    // Optional coalescing of concurrent requests into shared solves
+    std::unique_ptr<tdoapp::MicroBatcher> batcher;
+    if (drogon_options->batchWindow > 0) {
+        batcher = std::make_unique<tdoapp::MicroBatcher>(std::chrono::microseconds{drogon_options->batchWindow},
+                                                         drogon_options->batchSize, pool,
+                                                         [&metrics](tdoapp::Method method, size_t count, double seconds) {
+                                                             const auto m = static_cast<size_t>(method) - 1;
+                                                             metrics.batchSolve[m].observe(seconds);
+                                                             metrics.batchMeasurements[m].add(count);
+                                                         });
+    }
+
     // For now, we only need this endpoint
     app().registerHandler(
             drogon_options->api_endpoint,
-            [](const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback) {
+            [&pool, &batcher, &indices, &metrics, &geodeticCache, &registry, retryAfter](const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback) {
+                tdoapp::StageTimer parseTimer;
 
-                // Get JSON from request
-                auto obj = req->getJsonObject();
-                if (obj) {
-                    // Let's process the optimization method
-                    int method = 1; // 1 is for LLS; 2 is for NLLS
-                    if (obj->isMember("method")) {
-                        auto t = (*obj)["method"].asInt();
-                        if (t != 1 and t != 2) {
-                            auto resp = HttpResponse::newHttpResponse();
-                            resp->setStatusCode(k400BadRequest);
-                            resp->setBody("Invalid optimization method. Valid options are: "
-                                          "1 (for Least Squares), 2 (for Non-Linear Least Squares)\n");
-                            callback(resp);
-                        } else {
-                            method = t;
-                            LOG_INFO << "Method set to " << method << "\n";
-                        }
+                // Requests and responses are JSON or the binary encoding of LocateCodec.hh
+                const auto contentType = mediaType(req->getHeader("content-type"));
+                const bool binaryRequest = contentType == tdoapp::kLocateMediaType;
+                if (!binaryRequest && !contentType.empty() && contentType != "application/json") {
+                    metrics.badRequests.add();
+                    auto resp = badRequest(std::string{"Unsupported content type. Send application/json or "} +
+                                           tdoapp::kLocateMediaType + "\n");
+                    resp->setStatusCode(k415UnsupportedMediaType);
+                    callback(resp);
+                    return;
+                }
+                const auto accepted = binaryResponse(req->getHeader("accept"), binaryRequest);
+                if (!accepted) {
+                    metrics.badRequests.add();
+                    auto resp = badRequest(std::string{"Responses are application/json or "} +
+                                           tdoapp::kLocateMediaType + "\n");
+                    resp->setStatusCode(k406NotAcceptable);
+                    callback(resp);
+                    return;
+                }
+                const bool binary = *accepted;
+
+                // Binary requests are decoded straight into receivers, without a JSON document
+                std::shared_ptr<Json::Value> obj;
+                tdoapp::LocateRequest decoded;
+                if (binaryRequest) {
+                    try {
+                        decoded = tdoapp::decodeLocateRequest(req->body());
+                    } catch (const std::exception &e) {
+                        metrics.badRequests.add();
+                        callback(badRequest(std::string{"Wrong binary request: "} + e.what() + "\n"));
+                        return;
+                    }
+                } else {
+                    obj = req->getJsonObject();
+                    if (!obj) {
+                        LOG_WARN << "Could not find a JSON object with the measurement information\n";
+                        metrics.badRequests.add();
+                        callback(badRequest("Could not find a JSON object with the measurement information\n"));
+                        return;
+                    }
+                }
+
+                // Let's process the optimization method
+                int method = 1; // 1 is for LLS; 2 is for NLLS; 3 is for RANSAC + NLLS; 4 is for grid + NLLS
+                if (binaryRequest || obj->isMember("method")) {
+                    auto t = binaryRequest ? decoded.method : (*obj)["method"].asInt();
+                    if (t < 1 or t > kMethods) {
+                        metrics.badRequests.add();
+                        callback(badRequest("Invalid optimization method. Valid options are: "
+                                            "1 (for Least Squares), 2 (for Non-Linear Least Squares), "
+                                            "3 (for outlier-robust RANSAC + Non-Linear Least Squares), "
+                                            "4 (for grid multi-start Non-Linear Least Squares)\n"));
+                        return;
+                    }
+                    method = t;
+                } else {
+                    LOG_DEBUG << "No method specified. Defaulting to 1 (Least Squares)\n";
+                }
+
+                // Measurements of a registered set only carry their TOAs: {"set": id, "toa": [[t0, t1, ...], ...]}, or
+                // a flat array for a single measurement. They are kept as rows and solved on the geometry of the set
+                std::vector<tdoapp::Measurement> measurements;
+                tdoapp::ToaMatrix toas;
+                Projections projections;
+                tdoapp::ReceiverRegistry::SetPtr set;
+
+                // Geodetic receivers are projected once per receiver set
+                auto addGeodetic = [&](const tdoapp::GeodeticMeasurement &g) {
+                    try {
+                        projections.push_back(geodeticCache.projection(g));
+                    } catch (const std::invalid_argument &e) {
+                        metrics.badRequests.add();
+                        callback(badRequest(std::string{"Wrong geodetic measurement: "} + e.what() + "\n"));
+                        return false;
+                    }
+                    measurements.push_back(projections.back()->project(g));
+                    return true;
+                };
+
+                if (binaryRequest ? (decoded.flags & tdoapp::kLocateReceiverSet) != 0 : obj->isMember("set")) {
+                    if (binaryRequest) {
+                        set = registry.find(decoded.set);
                     } else {
-                        LOG_WARN << "No method specified. Defaulting to 1 (Least Squares)\n";
+                        const auto &id = (*obj)["set"];
+                        set = id.isString() ? registry.find(id.asString()) : nullptr;
+                    }
+                    if (!set) {
+                        metrics.badRequests.add();
+                        auto resp = badRequest("Unknown receiver set. Register it first at the receivers endpoint\n");
+                        resp->setStatusCode(k404NotFound);
+                        callback(resp);
+                        return;
                     }
+                }
 
-                    // Get measurements
-                    Json::Value result;
-                    result["method"] = method;
-                    Json::Value collections;
-                    int k = 0;
-                    if (obj->isMember("measurements")) {
-                        auto mroot = (*obj)["measurements"];
-                        for (const auto &measurement : mroot) {
-                            std::vector<tdoapp::Receiver> r;
-
-                            for (const auto &values : measurement) {
-                                if (values.size() != 3) {
-                                    LOG_WARN << "Wrong measurement file. Size of the file was: " << values.size() << ".\n";
-                                    auto resp = HttpResponse::newHttpResponse();
-                                    resp->setStatusCode(k400BadRequest);
-                                    resp->setBody("Wrong measurement file. Each measurement must contain: "
-                                                  "X, Y coordinates and timestamp.\n");
-                                    callback(resp);
-                                }
-                                r.emplace_back(values[0].asDouble(),values[1].asDouble(),values[2].asDouble());
+                if (set && binaryRequest) {
+                    if (decoded.toas.rows() == 0 || static_cast<size_t>(decoded.toas.cols()) != set->receivers.size()) {
+                        metrics.badRequests.add();
+                        callback(badRequest("The TOAs must hold one column per receiver of the set\n"));
+                        return;
+                    }
+                    toas = std::move(decoded.toas);
+                } else if (set) {
+                    const auto &toa = (*obj)["toa"];
+                    auto addRow = [&](const Json::Value &row, Eigen::Index k) {
+                        if (!row.isArray() || row.size() != set->receivers.size()) {
+                            return false;
+                        }
+                        for (Json::ArrayIndex i = 0; i < row.size(); i++) {
+                            if (!row[i].isNumeric()) {
+                                return false;
                             }
+                            toas(k, static_cast<Eigen::Index>(i)) = row[i].asDouble();
+                        }
+                        return true;
+                    };
+                    bool valid = toa.isArray() && !toa.empty();
+                    if (valid && toa[0].isArray()) {
+                        toas.resize(static_cast<Eigen::Index>(toa.size()),
+                                    static_cast<Eigen::Index>(set->receivers.size()));
+                        for (Json::ArrayIndex k = 0; valid && k < toa.size(); k++) {
+                            valid = addRow(toa[k], static_cast<Eigen::Index>(k));
+                        }
+                    } else if (valid) {
+                        toas.resize(1, static_cast<Eigen::Index>(set->receivers.size()));
+                        valid = addRow(toa, 0);
+                    }
+                    if (!valid) {
+                        metrics.badRequests.add();
+                        callback(badRequest("The 'toa' field must hold one TOA per receiver of the set, or an array "
+                                            "of such rows\n"));
+                        return;
+                    }
+                } else if (binaryRequest) {
+                    measurements = std::move(decoded.measurements);
+                    for (const auto &g: decoded.geodetic) {
+                        if (!addGeodetic(g)) {
+                            return;
+                        }
+                    }
+                } else {
+                    // Get measurements
+                    if (!obj->isMember("measurements")) {
+                        LOG_WARN << "File does not contain any measurement field.\n";
+                        metrics.badRequests.add();
+                        callback(badRequest("File does not contain any measurements. Please make sure to put all "
+                                            "your measurements in the 'measurements' field of the request.\n"));
+                        return;
+                    }
+
+                    // Geodetic receivers are [latitude, longitude, altitude, timestamp]
+                    const bool geodetic = obj->isMember("geodetic") && (*obj)["geodetic"].asBool();
+                    const Json::ArrayIndex receiverValues = geodetic ? 4 : 3;
 
-                            // Run the optimization routines
-                            LOG_INFO << "Starting initial guess via Least Squares\n";
-                            auto init = tdoapp::initialGuess(r);
-                            Json::Value p;
-                            if (method == 2) {
-                                LOG_INFO << "Starting Non-Linear optimization\n";
-                                auto nlls = tdoapp::nonlinearOptimization(r, init);
-                                p["x"] = nlls[0]; p["y"] = nlls[1];
+                    for (const auto &measurement: (*obj)["measurements"]) {
+                        tdoapp::Measurement r;
+                        tdoapp::GeodeticMeasurement g;
+                        for (const auto &values: measurement) {
+                            if (values.size() != receiverValues) {
+                                LOG_WARN << "Wrong measurement file. Size of the file was: " << values.size() << ".\n";
+                                metrics.badRequests.add();
+                                callback(badRequest(geodetic ? "Wrong measurement file. Each measurement must contain: "
+                                                               "latitude, longitude, altitude and timestamp.\n"
+                                                             : "Wrong measurement file. Each measurement must contain: "
+                                                               "X, Y coordinates and timestamp.\n"));
+                                return;
+                            }
+                            if (geodetic) {
+                                g.push_back({values[0].asDouble(), values[1].asDouble(), values[2].asDouble(),
+                                             values[3].asDouble()});
                             } else {
-                                p["x"] = init[0]; p["y"] = init[1];
+                                r.emplace_back(values[0].asDouble(), values[1].asDouble(), values[2].asDouble());
                             }
+                        }
+                        if (!geodetic) {
+                            measurements.push_back(std::move(r));
+                        } else if (!addGeodetic(g)) {
+                            return;
+                        }
+                    }
+                }
+                if (set && set->projection) {
+                    projections.assign(static_cast<size_t>(toas.rows()), set->projection);
+                }
+                metrics.parse.observe(parseTimer.seconds());
+                metrics.accepted(method, set ? static_cast<size_t>(toas.rows()) : measurements.size());
 
-                            LOG_INFO << "Finished computing position" << k << "\n";
-                            collections[k] = p;
-                            k++;
+                // Coalesced with other requests, answered once its batch is solved. Requests for a registered set
+                // already share its geometry and go straight to the pool
+                if (batcher && !set) {
+                    tdoapp::MicroBatcher::Request request;
+                    request.measurements = std::move(measurements);
+                    request.method = static_cast<tdoapp::Method>(method);
+                    request.onResult = [callback, method, projections, binary, &metrics](
+                            std::vector<Eigen::Vector2d> &&positions) {
+                        for (const auto &position: positions) {
+                            if (position.hasNaN()) {
+                                metrics.answered(method, metrics.failed);
+                                callback(solveFailed("no solution for at least one measurement"));
+                                return;
+                            }
                         }
-                        result["results"] = collections;
-                        auto resp = HttpResponse::newHttpJsonResponse(result);
+                        auto resp = solvedResponse(positions, method, projections, binary, metrics);
+                        metrics.answered(method, metrics.ok);
                         callback(resp);
+                    };
+                    request.onRejected = [callback, method, &metrics, retryAfter]() {
+                        LOG_WARN << "Compute queue is full, rejecting request\n";
+                        metrics.answered(method, metrics.rejected);
+                        callback(serverBusy(retryAfter));
+                    };
+                    batcher->submit(std::move(request));
+                    return;
+                }
+
+                // The callback is invoked from the compute thread once the solve is done
+                auto task = [measurements = std::move(measurements), toas = std::move(toas),
+                             projections = std::move(projections), set, method, binary, callback, &indices,
+                             &metrics]() {
+                    std::vector<Eigen::Vector2d> positions;
+                    const auto status = set ? solve(toas, *set, method, metrics, positions)
+                                            : solve(measurements, method, indices, metrics, positions);
+                    if (status != tdoapp::SolutionStatus::Ok) {
+                        metrics.answered(method, metrics.failed);
+                        callback(solveFailed(tdoapp::toString(status)));
+                        return;
+                    }
+                    auto resp = solvedResponse(positions, method, projections, binary, metrics);
+                    metrics.answered(method, metrics.ok);
+                    callback(resp);
+                };
 
+                // Full queue: shed the request rather than letting latency grow
+                if (!pool.trySubmit(std::move(task))) {
+                    LOG_WARN << "Compute queue is full, rejecting request\n";
+                    metrics.answered(method, metrics.rejected);
+                    callback(serverBusy(retryAfter));
+                }
+            },
+            {Post});
+
+    // Registers a receiver set once: {"id": name, "receivers": [[x, y], ...]}, or [latitude, longitude, altitude]
+    // rows with "geodetic": true. Its geometry is built here, and /locate then takes {"set": name, "toa": [...]}
+    app().registerHandler(
+            drogon_options->receivers_endpoint,
+            [&indices, &metrics, &geodeticCache, &registry, maxSetReceivers](const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback) {
+                auto obj = req->getJsonObject();
+                if (!obj || !(*obj)["id"].isString() || !(*obj)["receivers"].isArray()) {
+                    metrics.badRequests.add();
+                    callback(badRequest("A receiver set needs a string 'id' and a 'receivers' array\n"));
+                    return;
+                }
+                if ((*obj)["receivers"].size() > maxSetReceivers) {
+                    metrics.badRequests.add();
+                    auto resp = badRequest("A receiver set can have at most " + std::to_string(maxSetReceivers) +
+                                           " receivers\n");
+                    resp->setStatusCode(k413RequestEntityTooLarge);
+                    callback(resp);
+                    return;
+                }
+
+                const bool geodetic = (*obj)["geodetic"].asBool();
+                const Json::ArrayIndex receiverValues = geodetic ? 3 : 2;
+                std::vector<tdoapp::Receiver> receivers;
+                tdoapp::GeodeticMeasurement g;
+                for (const auto &values: (*obj)["receivers"]) {
+                    bool valid = values.isArray() && values.size() == receiverValues;
+                    for (Json::ArrayIndex i = 0; valid && i < receiverValues; i++) {
+                        valid = values[i].isNumeric() && std::isfinite(values[i].asDouble());
+                    }
+                    if (!valid) {
+                        metrics.badRequests.add();
+                        callback(badRequest(geodetic ? "Each receiver must contain: latitude, longitude and altitude\n"
+                                                     : "Each receiver must contain: X and Y coordinates\n"));
+                        return;
+                    }
+                    if (geodetic) {
+                        g.push_back({values[0].asDouble(), values[1].asDouble(), values[2].asDouble(), 0.0});
                     } else {
-                        LOG_WARN << "File does not contain any measurement field.\n";
-                        auto resp = HttpResponse::newHttpResponse();
-                        resp->setStatusCode(k400BadRequest);
-                        resp->setBody("File does not contain any measurements. Please make sure to put all your "
-                                      "measurements in the 'measurements' field of the request.\n");
-                        callback(resp);
+                        receivers.emplace_back(values[0].asDouble(), values[1].asDouble());
                     }
+                }
 
-                } else {
-                    LOG_WARN << "Could not find a JSON object with the measurement information\n";
-                    auto resp = HttpResponse::newHttpResponse();
-                    resp->setStatusCode(k400BadRequest);
-                    resp->setBody("Could not find a JSON object with the measurement information\n");
+                std::shared_ptr<const tdoapp::GeodeticProjection> projection;
+                if (geodetic) {
+                    try {
+                        projection = geodeticCache.projection(g);
+                    } catch (const std::invalid_argument &e) {
+                        metrics.badRequests.add();
+                        callback(badRequest(std::string{"Wrong geodetic receiver set: "} + e.what() + "\n"));
+                        return;
+                    }
+                    receivers = projection->receivers();
+                } else if (receivers.size() < 3) {
+                    metrics.badRequests.add();
+                    callback(badRequest("A receiver set needs at least 3 receivers\n"));
+                    return;
+                }
+
+                const auto id = (*obj)["id"].asString();
+                const auto size = receivers.size();
+                const auto *index = findIndex(receivers, indices);
+                const auto added = registry.add(
+                        id, std::make_shared<const tdoapp::ReceiverSet>(std::move(receivers), projection, index));
+                if (added == tdoapp::ReceiverRegistry::Added::Full) {
+                    metrics.badRequests.add();
+                    auto resp = badRequest("The receiver set registry is full. Replace an existing set instead\n");
+                    resp->setStatusCode(k507InsufficientStorage);
                     callback(resp);
+                    return;
                 }
+                const bool replaced = added == tdoapp::ReceiverRegistry::Added::Replaced;
+
+                Json::Value result;
+                result["id"] = id;
+                result["receivers"] = static_cast<Json::UInt64>(size);
+                result["replaced"] = replaced;
+                result["index"] = index != nullptr;
+                auto resp = HttpResponse::newHttpJsonResponse(result);
+                resp->setStatusCode(replaced ? k200OK : k201Created);
+                callback(resp);
             },
             {Post});
 
+    // Batching statistics, to tune the window against latency
+    app().registerHandler(
+            drogon_options->stats_endpoint,
+            [&pool, &batcher, &registry](const HttpRequestPtr &, std::function<void(const HttpResponsePtr &)> &&callback) {
+                Json::Value result;
+                result["compute_threads"] = pool.size();
+                result["receiver_sets"] = static_cast<Json::UInt64>(registry.size());
+                result["queued"] = static_cast<Json::UInt64>(pool.queued());
+                result["batching"] = batcher != nullptr;
+                if (batcher) {
+                    auto stats = batcher->stats();
+                    result["batches"] = static_cast<Json::UInt64>(stats.batches);
+                    result["requests"] = static_cast<Json::UInt64>(stats.requests);
+                    result["measurements"] = static_cast<Json::UInt64>(stats.measurements);
+                    result["rejected_batches"] = static_cast<Json::UInt64>(stats.rejectedBatches);
+                    result["max_batch_requests"] = static_cast<Json::UInt64>(stats.maxBatchRequests);
+                    result["mean_batch_requests"] =
+                            stats.batches ? static_cast<double>(stats.requests) / stats.batches : 0.0;
+                    result["mean_wait_us"] =
+                            stats.requests ? static_cast<double>(stats.totalWaitUs) / stats.requests : 0.0;
+                    result["max_wait_us"] = static_cast<Json::UInt64>(stats.maxWaitUs);
+                }
+                callback(HttpResponse::newHttpJsonResponse(result));
+            },
+            {Get});
+
+    // Prometheus scrape target
+    app().registerHandler(
+            drogon_options->metrics_endpoint,
+            [&pool, &metrics](const HttpRequestPtr &, std::function<void(const HttpResponsePtr &)> &&callback) {
+                auto resp = HttpResponse::newHttpResponse();
+                resp->setContentTypeString("text/plain; version=0.0.4");
+                resp->setBody(metrics.render(pool));
+                callback(resp);
+            },
+            {Get});
+
     LOG_INFO << "Started application with the following parameters: ";
     LOG_INFO << "\t - IP address: " << drogon_options->ip_address;
     LOG_INFO << "\t - Port number: " << drogon_options->port;
     LOG_INFO << "\t - Number of threads: " << drogon_options->threadNum;
+    LOG_INFO << "\t - Number of compute threads: " << pool.size();
+    LOG_INFO << "\t - Compute queue size: " << pool.capacity();
+    LOG_INFO << "\t - Batch window (us): " << drogon_options->batchWindow;
+    LOG_INFO << "\t - Batch size: " << drogon_options->batchSize;
     LOG_INFO << "\t - Logging path: " << drogon_options->log_path;
 
     // Main app loop
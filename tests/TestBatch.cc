@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#include <atomic>
+#include <cmath>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "../include/Receiver.hh"
+#include "../include/TdoaBatch.hh"
+#include "../include/ThreadPool.hh"
+
+TEST(TestBatch, testParallelForCoversRange) {
+    tdoapp::ThreadPool pool{4};
+    std::vector<std::atomic<int>> visits(1000);
+
+    // Twice, to check the pool can be reused
+    for (int k = 0; k < 2; k++) {
+        pool.parallelFor(visits.size(), [&](size_t i) { visits[i]++; }, 7);
+    }
+
+    for (const auto &v: visits) {
+        EXPECT_EQ(v.load(), 2);
+    }
+}
+
+TEST(TestBatch, testParallelForRethrows) {
+    tdoapp::ThreadPool pool{3};
+    std::atomic<int> count{0};
+
+    EXPECT_THROW(pool.parallelFor(100, [&](size_t i) {
+        count++;
+        if (i == 42) {
+            throw std::runtime_error("failure");
+        }
+    }), std::runtime_error);
+    EXPECT_EQ(count.load(), 100);
+}
+
+TEST(TestBatch, testMatchesSequential) {
+    std::mt19937 rng{5};
+    std::uniform_real_distribution<double> area{-10.0, 10.0};
+    std::normal_distribution<double> noise{0.0, 0.05};
+
+    std::vector<tdoapp::Measurement> measurements;
+    for (int k = 0; k < 200; k++) {
+        Eigen::Vector2d emitter{area(rng), area(rng)};
+        tdoapp::Measurement m;
+        for (int i = 0; i < 3 + k % 6; i++) {
+            Eigen::Vector2d s{area(rng), area(rng)};
+            m.emplace_back(s[0], s[1], (emitter - s).norm() + noise(rng));
+        }
+        measurements.push_back(m);
+    }
+
+    auto results = tdoapp::locateBatch(measurements, tdoapp::Method::Nonlinear, 4);
+
+    ASSERT_EQ(results.size(), measurements.size());
+    for (size_t k = 0; k < measurements.size(); k++) {
+        auto solution = tdoapp::locateSolution(measurements[k], tdoapp::Method::Nonlinear);
+        if (!solution.usable()) {
+            EXPECT_TRUE(std::isnan(results[k][0]));
+            continue;
+        }
+        Eigen::Vector2d expected = solution.position;
+        EXPECT_EQ(results[k][0], expected[0]);
+        EXPECT_EQ(results[k][1], expected[1]);
+    }
+}
+
+TEST(TestBatch, testGroupedMatchesSequential) {
+    std::mt19937 rng{9};
+    std::uniform_real_distribution<double> area{-10.0, 10.0};
+    std::normal_distribution<double> noise{0.0, 0.05};
+
+    // Two deployments interleaved, plus a few one-off receiver sets
+    std::vector<std::vector<Eigen::Vector2d>> deployments(2);
+    for (auto &d: deployments) {
+        for (int i = 0; i < 6; i++) {
+            d.emplace_back(area(rng), area(rng));
+        }
+    }
+    std::vector<tdoapp::Measurement> measurements;
+    for (int k = 0; k < 60; k++) {
+        auto receivers = k % 10 == 9 ? std::vector<Eigen::Vector2d>{{area(rng), area(rng)},
+                                                                     {area(rng), area(rng)},
+                                                                     {area(rng), area(rng)}}
+                                     : deployments[k % 2];
+        Eigen::Vector2d emitter{area(rng), area(rng)};
+        tdoapp::Measurement m;
+        for (const auto &s: receivers) {
+            m.emplace_back(s[0], s[1], (emitter - s).norm() + noise(rng));
+        }
+        measurements.push_back(m);
+    }
+
+    for (auto method: {tdoapp::Method::Linear, tdoapp::Method::Nonlinear}) {
+        auto results = tdoapp::locateGrouped(measurements, method);
+        ASSERT_EQ(results.size(), measurements.size());
+        for (size_t k = 0; k < measurements.size(); k++) {
+            auto solution = tdoapp::locateSolution(measurements[k], method);
+            if (!solution.usable()) {
+                EXPECT_TRUE(std::isnan(results[k][0]));
+                continue;
+            }
+            Eigen::Vector2d expected = solution.position;
+            EXPECT_NEAR(results[k][0], expected[0], 1e-6);
+            EXPECT_NEAR(results[k][1], expected[1], 1e-6);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
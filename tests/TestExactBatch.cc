@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "../include/ExactBatch.hh"
+#include "../include/Receiver.hh"
+#include "../include/TdoaBatch.hh"
+#include "../include/TdoaLocator.hh"
+#include "../include/TdoaSolution.hh"
+
+namespace {
+    std::vector<tdoapp::SimdLevel> availableLevels() {
+        std::vector<tdoapp::SimdLevel> levels{tdoapp::SimdLevel::Scalar};
+        if (tdoapp::simdLevel() != tdoapp::SimdLevel::Scalar) {
+            levels.push_back(tdoapp::SimdLevel::Avx2);
+        }
+        if (tdoapp::simdLevel() == tdoapp::SimdLevel::Avx512) {
+            levels.push_back(tdoapp::SimdLevel::Avx512);
+        }
+        return levels;
+    }
+
+    // Same bits, NaN included
+    bool sameBits(double a, double b) {
+        return std::memcmp(&a, &b, sizeof(double)) == 0 || (std::isnan(a) && std::isnan(b));
+    }
+
+    // Random fixes, noisy enough that every failure status shows up, plus the corner cases
+    std::vector<tdoapp::Measurement> randomFixes(size_t n) {
+        std::mt19937 rng{1234};
+        std::uniform_real_distribution<double> position{-10.0, 10.0};
+        std::normal_distribution<double> noise{0.0, 0.5};
+
+        std::vector<tdoapp::Measurement> fixes;
+        for (size_t i = 0; i < n; i++) {
+            tdoapp::Measurement m;
+            const double x = position(rng), y = position(rng);
+            for (int j = 0; j < 3; j++) {
+                tdoapp::Receiver r{position(rng), position(rng)};
+                r.timestamp = std::hypot(r.x - x, r.y - y) + noise(rng);
+                m.push_back(r);
+            }
+            fixes.push_back(m);
+        }
+
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        fixes.push_back({{0.0, 0.0, 0.0}, {3.0, 1.0, -4.0}, {0.0, 3.0, -2.5}}); // No real solution
+        fixes.push_back({{0.0, 0.0, 0.0}, {3.0, 1.0, 0.0}, {0.0, 3.0, -4.0}});  // Zero TDOA
+        fixes.push_back({{0.0, 0.0, 0.0}, {3.0, 1.0, -3.0}, {0.0, 3.0, 0.0}});  // Ambiguous
+        fixes.push_back({{1.0, 1.0, 2.0}, {1.0, 1.0, 3.0}, {0.0, 3.0, 1.0}});   // Coincident receivers
+        fixes.push_back({{0.0, 0.0, nan}, {3.0, 1.0, 3.0}, {0.0, 3.0, 1.0}});
+        fixes.push_back({{0.0, 0.0, 5.0}, {std::numeric_limits<double>::infinity(), 1.0, 3.0}, {0.0, 3.0, 1.0}});
+        return fixes;
+    }
+
+    void expectMatchesScalar(const std::vector<tdoapp::Measurement> &fixes, bool getPositive) {
+        tdoapp::ExactBatchColumns columns;
+        for (const auto &m: fixes) {
+            columns.push_back(m[0], m[1], m[2]);
+        }
+
+        for (auto level: availableLevels()) {
+            tdoapp::ExactBatchResult result;
+            tdoapp::exactBatch(columns, result, getPositive, level);
+            ASSERT_EQ(result.size(), fixes.size());
+
+            for (size_t i = 0; i < fixes.size(); i++) {
+                const auto reference = tdoapp::exactSolution(fixes[i], getPositive);
+                SCOPED_TRACE(std::string{tdoapp::toString(level)} + " fix " + std::to_string(i));
+
+                EXPECT_EQ(result.status[i], reference.status);
+                EXPECT_TRUE(sameBits(result.x[i], reference.position[0]));
+                EXPECT_TRUE(sameBits(result.y[i], reference.position[1]));
+                EXPECT_TRUE(sameBits(result.xp[i], reference.roots[0][0]));
+                EXPECT_TRUE(sameBits(result.yp[i], reference.roots[0][1]));
+                EXPECT_TRUE(sameBits(result.xm[i], reference.roots[1][0]));
+                EXPECT_TRUE(sameBits(result.ym[i], reference.roots[1][1]));
+            }
+        }
+    }
+}
+
+TEST(TestExactBatch, testBitIdenticalToScalar) {
+    // Odd size: vector body plus a scalar tail at every width
+    auto fixes = randomFixes(1001);
+    expectMatchesScalar(fixes, true);
+    expectMatchesScalar(fixes, false);
+
+    // Every status is exercised
+    tdoapp::ExactBatchColumns columns;
+    for (const auto &m: fixes) {
+        columns.push_back(m[0], m[1], m[2]);
+    }
+    tdoapp::ExactBatchResult result;
+    tdoapp::exactBatch(columns, result);
+    for (auto status: {tdoapp::SolutionStatus::Ok, tdoapp::SolutionStatus::Ambiguous,
+                       tdoapp::SolutionStatus::NoRealSolution, tdoapp::SolutionStatus::NoConsistentRoot,
+                       tdoapp::SolutionStatus::InvalidInput}) {
+        EXPECT_NE(std::find(result.status.begin(), result.status.end(), status), result.status.end())
+                            << tdoapp::toString(status);
+    }
+}
+
+TEST(TestExactBatch, testShortBatches) {
+    auto fixes = randomFixes(0);
+    for (size_t n = 0; n <= fixes.size(); n++) {
+        expectMatchesScalar({fixes.begin(), fixes.begin() + static_cast<long>(n)}, true);
+    }
+}
+
+TEST(TestExactBatch, testLocateGrouped) {
+    auto fixes = randomFixes(37);
+    fixes.push_back({{0.0, 0.0, 5.2}, {3.0, 1.0, 3.1}, {0.0, 3.0, 3.1622776602}, {6.0, 4.0, 2.9}});
+
+    for (auto method: {tdoapp::Method::Linear, tdoapp::Method::Nonlinear}) {
+        auto grouped = tdoapp::locateGrouped(fixes, method);
+        auto reference = tdoapp::locateBatch(fixes, method, 1);
+        ASSERT_EQ(grouped.size(), reference.size());
+        for (size_t i = 0; i < grouped.size(); i++) {
+            EXPECT_TRUE(sameBits(grouped[i][0], reference[i][0])) << i;
+            EXPECT_TRUE(sameBits(grouped[i][1], reference[i][1])) << i;
+        }
+    }
+}
+
+TEST(TestExactBatch, testMismatchedColumns) {
+    tdoapp::ExactBatchColumns columns;
+    columns.push_back({0.0, 0.0, 5.0}, {3.0, 1.0, 3.0}, {0.0, 3.0, 1.0});
+    columns.t2.pop_back();
+
+    tdoapp::ExactBatchResult result;
+    EXPECT_THROW(tdoapp::exactBatch(columns, result), std::invalid_argument);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include <gtest/gtest.h>
+
+#include "../include/Geodetic.hh"
+#include "../include/TdoaLocator.hh"
+
+namespace {
+    // Receivers a few kilometers apart, and TOAs in meters from an emitter among them
+    tdoapp::GeodeticMeasurement deployment(const tdoapp::GeodeticPosition &emitter) {
+        tdoapp::GeodeticMeasurement receivers{{43.2630, -2.9350, 20.0, 0.0}, {43.2900, -2.9000, 45.0, 0.0},
+                                              {43.2400, -2.8800, 10.0, 0.0}, {43.3000, -2.9700, 60.0, 0.0},
+                                              {43.2500, -2.9900, 35.0, 0.0}};
+        const Eigen::Vector3d source = tdoapp::toEcef(emitter);
+        for (auto &r: receivers) {
+            r.timestamp = (tdoapp::toEcef(r.position()) - source).norm() + 1000.0;
+        }
+        return receivers;
+    }
+}
+
+TEST(TestGeodetic, testEcefRoundTrip) {
+    const Eigen::Vector3d equator = tdoapp::toEcef({0.0, 0.0, 0.0});
+    EXPECT_NEAR((equator - Eigen::Vector3d{tdoapp::kWgs84SemiMajorAxis, 0.0, 0.0}).norm(), 0.0, 1e-6);
+    const Eigen::Vector3d pole = tdoapp::toEcef({90.0, 0.0, 0.0});
+    EXPECT_NEAR(pole[2], tdoapp::kWgs84SemiMajorAxis * (1.0 - tdoapp::kWgs84Flattening), 1e-6);
+
+    for (const tdoapp::GeodeticPosition p: {tdoapp::GeodeticPosition{43.263, -2.935, 20.0},
+                                            tdoapp::GeodeticPosition{-33.9, 151.2, 1500.0},
+                                            tdoapp::GeodeticPosition{89.9999, 179.9, -30.0},
+                                            tdoapp::GeodeticPosition{-90.0, 0.0, 8000.0}}) {
+        const auto back = tdoapp::fromEcef(tdoapp::toEcef(p));
+        EXPECT_NEAR(back.latitude, p.latitude, 1e-10);
+        EXPECT_NEAR(back.altitude, p.altitude, 1e-6);
+        if (std::abs(p.latitude) < 90.0) {
+            EXPECT_NEAR(back.longitude, p.longitude, 1e-10);
+        }
+    }
+
+    // East and north of the origin, 1 km away
+    const tdoapp::EnuFrame frame{{43.263, -2.935, 0.0}};
+    const Eigen::Vector3d north = frame.toEnu({43.263 + 1000.0 / 111'000.0, -2.935, 0.0});
+    EXPECT_NEAR(north[0], 0.0, 1e-6);
+    EXPECT_NEAR(north[1], 1000.0, 10.0);
+    const auto east = frame.toGeodetic({1000.0, 0.0, 0.0});
+    EXPECT_GT(east.longitude, -2.935);
+    EXPECT_NEAR(east.latitude, 43.263, 1e-4);
+}
+
+TEST(TestGeodetic, testLocate) {
+    const tdoapp::GeodeticPosition emitter{43.2700, -2.9300, 30.0};
+    const auto receivers = deployment(emitter);
+    const tdoapp::GeodeticProjection projection{receivers};
+    EXPECT_TRUE(projection.matches(receivers));
+
+    // Projected coordinates are centered on the receivers
+    Eigen::Vector2d mean = Eigen::Vector2d::Zero();
+    for (const auto &r: projection.receivers()) {
+        mean += r.position() / static_cast<double>(receivers.size());
+    }
+    EXPECT_LT(mean.norm(), 100.0);
+
+    const auto planar = projection.project(receivers);
+    EXPECT_EQ(planar[2].timestamp, receivers[2].timestamp);
+    const auto position = projection.toGeodetic(tdoapp::locate(planar, tdoapp::Method::Nonlinear));
+
+    // Within a few meters: the plane drops the altitude differences
+    EXPECT_NEAR(position.latitude, emitter.latitude, 5.0 / 111'000.0);
+    EXPECT_NEAR(position.longitude, emitter.longitude, 5.0 / 81'000.0);
+
+    // A position on the plane goes back and forth exactly
+    const Eigen::Vector2d point{1234.5, -678.9};
+    const Eigen::Vector3d enu = projection.frame().toEnu(projection.toGeodetic(point));
+    EXPECT_NEAR((enu.head<2>() - point).norm(), 0.0, 1e-6);
+
+    EXPECT_TRUE(std::isnan(projection.toGeodetic(Eigen::Vector2d::Constant(std::numeric_limits<double>::quiet_NaN())).latitude));
+    auto fewer = receivers;
+    fewer.pop_back();
+    EXPECT_THROW(projection.project(fewer), std::invalid_argument);
+    EXPECT_FALSE(projection.matches(fewer));
+}
+
+TEST(TestGeodetic, testCache) {
+    tdoapp::GeodeticCache cache{2};
+    auto a = deployment({43.27, -2.93, 0.0});
+    auto b = deployment({43.26, -2.91, 0.0});
+    const auto first = cache.projection(a);
+
+    // Only the coordinates count: b has the receivers of a, with other TOAs
+    EXPECT_EQ(tdoapp::geometryHash(a), tdoapp::geometryHash(b));
+    EXPECT_EQ(cache.projection(b), first);
+    EXPECT_EQ(cache.size(), 1u);
+    EXPECT_EQ(cache.misses(), 1u);
+
+    auto moved = a;
+    moved[1].latitude += 1e-7;
+    EXPECT_NE(tdoapp::geometryHash(moved), tdoapp::geometryHash(a));
+    const auto other = cache.projection(moved);
+    EXPECT_NE(other, first);
+    EXPECT_EQ(cache.size(), 2u);
+
+    // The least recently used set is evicted, its projection stays valid
+    auto third = a;
+    third.pop_back();
+    cache.projection(third);
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_TRUE(first->matches(a));
+    const auto misses = cache.misses();
+    cache.projection(a);
+    EXPECT_EQ(cache.misses(), misses + 1);
+
+    a[0].latitude = 91.0;
+    EXPECT_THROW(cache.projection(a), std::invalid_argument);
+    a.erase(a.begin() + 2, a.end());
+    EXPECT_THROW(tdoapp::GeodeticProjection{a}, std::invalid_argument);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
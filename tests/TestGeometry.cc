@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+#include "../include/Receiver.hh"
+#include "../include/TdoaGeometry.hh"
+#include "../include/TdoaLocator.hh"
+
+TEST(TestGeometry, testExact) {
+    auto r = std::vector<tdoapp::Receiver> {{0.0, 0.0}, {3.0, 1.0}, {0.0, 3.0}};
+    auto geometry = tdoapp::TdoaGeometry(r);
+
+    auto result = geometry.exactTDOA(Eigen::Vector3d{5.0, 3.0, std::sqrt(10.0)});
+
+    EXPECT_NEAR(result[0],3.0,1e-5);
+    EXPECT_NEAR(result[1],4.0,1e-5);
+}
+
+TEST(TestGeometry, testLs) {
+    auto r = std::vector<tdoapp::Receiver> {{0.0, 0.0}, {3.0, 1.0}, {0.0, 3.0}, {6.0, 4.0}, {3.0, 14.0}};
+    auto geometry = tdoapp::TdoaGeometry(r);
+
+    Eigen::VectorXd timestamps(5);
+    timestamps << 5.0, 3.0, std::sqrt(10.0), 3.0, 10.0;
+    auto result = geometry.linearTDOA(timestamps);
+
+    EXPECT_NEAR(result[0],3.0,1e-5);
+    EXPECT_NEAR(result[1],4.0,1e-5);
+}
+
+TEST(TestGeometry, testMatchesFreeFunctions) {
+    auto r = std::vector<tdoapp::Receiver> {{0.0, 0.0, 5.2}, {3.0, 1.0, 3.1}, {0.0, 3.0, 3.1622776602},
+                                            {6.0, 4.0, 2.9}, {3.0, 14.0, 10.0}, {-4.0, 7.0, 8.3}};
+    auto geometry = tdoapp::TdoaGeometry(r);
+
+    Eigen::VectorXd timestamps(r.size());
+    for (size_t i = 0; i < r.size(); i++) {
+        timestamps[static_cast<Eigen::Index>(i)] = r[i].timestamp;
+    }
+
+    // Noisy, overdetermined system: both have to agree on the LS solution
+    auto expected = tdoapp::linearTDOA(r);
+    auto result = geometry.linearTDOA(timestamps);
+    EXPECT_NEAR(result[0],expected[0],1e-9);
+    EXPECT_NEAR(result[1],expected[1],1e-9);
+
+    auto nlls = geometry.nonlinearOptimization(timestamps, result);
+    auto expectedNlls = tdoapp::nonlinearOptimization(r, expected);
+    EXPECT_NEAR(nlls[0],expectedNlls[0],1e-5);
+    EXPECT_NEAR(nlls[1],expectedNlls[1],1e-5);
+}
+
+TEST(TestGeometry, testCollinear) {
+    // The geometry columns only have rank 1: y is left undetermined, but x and r0 are not
+    const Eigen::Vector2d emitter{4.0, 5.0};
+    std::vector<tdoapp::Receiver> r;
+    for (const double x: {0.0, 3.0, 7.0, 12.0, -5.0}) {
+        r.emplace_back(x, 0.0, (emitter - Eigen::Vector2d{x, 0.0}).norm() + 1.0);
+    }
+    auto geometry = tdoapp::TdoaGeometry(r);
+
+    Eigen::VectorXd timestamps(r.size());
+    for (size_t i = 0; i < r.size(); i++) {
+        timestamps[static_cast<Eigen::Index>(i)] = r[i].timestamp;
+    }
+
+    auto expected = tdoapp::linearTDOA(r);
+    auto result = geometry.linearTDOA(timestamps);
+    ASSERT_TRUE(result.allFinite());
+    EXPECT_NEAR(result[0],emitter[0],1e-9);
+    EXPECT_NEAR(result[0],expected[0],1e-9);
+    EXPECT_NEAR(result[1],expected[1],1e-9);
+}
+
+TEST(TestGeometry, testWrongSize) {
+    auto r = std::vector<tdoapp::Receiver> {{0.0, 0.0}, {3.0, 1.0}, {0.0, 3.0}, {6.0, 4.0}};
+    auto geometry = tdoapp::TdoaGeometry(r);
+
+    EXPECT_THROW(geometry.linearTDOA(Eigen::Vector3d{5.0, 3.0, 3.0}), std::invalid_argument);
+    EXPECT_THROW(tdoapp::TdoaGeometry(std::vector<tdoapp::Receiver>{{0.0, 0.0}, {1.0, 1.0}}), std::invalid_argument);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#include <cmath>
+#include <limits>
+
+#include <gtest/gtest.h>
+
+#include "../include/GridInitializer.hh"
+#include "../include/Receiver.hh"
+#include "../include/TdoaLocator.hh"
+
+namespace {
+    std::vector<tdoapp::Receiver> scenario(const Eigen::Vector2d &emitter) {
+        std::vector<tdoapp::Receiver> r;
+        for (const Eigen::Vector2d &s: {Eigen::Vector2d{0.0, 0.0}, Eigen::Vector2d{10.0, 1.0},
+                                        Eigen::Vector2d{2.0, 9.0}, Eigen::Vector2d{9.0, 8.0},
+                                        Eigen::Vector2d{-3.0, 5.0}}) {
+            r.emplace_back(s[0], s[1], (emitter - s).norm() + 2.0);
+        }
+        return r;
+    }
+}
+
+TEST(TestGridInitializer, testCandidates) {
+    const Eigen::Vector2d emitter{4.0, 3.0};
+    auto candidates = tdoapp::gridCandidates(scenario(emitter));
+    ASSERT_FALSE(candidates.empty());
+    EXPECT_LE(candidates.size(), 2u);
+
+    // Within the finest grid step of the emitter, on a cost close to zero
+    EXPECT_LT((candidates[0].position - emitter).norm(), 0.05);
+    EXPECT_LT(candidates[0].cost, 1e-2);
+    for (size_t i = 1; i < candidates.size(); i++) {
+        EXPECT_LE(candidates[i - 1].cost, candidates[i].cost);
+    }
+}
+
+TEST(TestGridInitializer, testMultiStart) {
+    const Eigen::Vector2d emitter{4.0, 3.0};
+    auto r = scenario(emitter);
+
+    auto solution = tdoapp::multiStartSolution(r);
+    EXPECT_TRUE(solution.usable());
+    EXPECT_EQ(solution.method, tdoapp::SolutionMethod::NonlinearLeastSquares);
+    EXPECT_NEAR((solution.position - emitter).norm(), 0.0, 1e-4);
+
+    // Without ambiguity a single NLLS start
+    tdoapp::GridOptions options;
+    options.ambiguity = 0.0;
+    options.backend = tdoapp::NlsBackend::LevenbergMarquardt;
+    auto single = tdoapp::multiStartSolution(r, options);
+    auto best = tdoapp::gridCandidates(r, options).front();
+    EXPECT_EQ(single.iterations,
+              tdoapp::nonlinearSolution(r, best.position, tdoapp::NlsBackend::LevenbergMarquardt).iterations);
+
+    EXPECT_NEAR((tdoapp::locate(r, tdoapp::Method::MultiStart) - emitter).norm(), 0.0, 1e-4);
+    auto located = tdoapp::locateSolution(r, tdoapp::Method::MultiStart);
+    EXPECT_TRUE(located.usable());
+    EXPECT_NEAR((located.position - emitter).norm(), 0.0, 1e-4);
+}
+
+TEST(TestGridInitializer, testInvalidInput) {
+    auto r = scenario({1.0, 1.0});
+    r[1].timestamp = std::numeric_limits<double>::quiet_NaN();
+    EXPECT_TRUE(tdoapp::gridCandidates(r).empty());
+    EXPECT_EQ(tdoapp::multiStartSolution(r).status, tdoapp::SolutionStatus::InvalidInput);
+
+    r.erase(r.begin() + 2, r.end());
+    EXPECT_TRUE(tdoapp::gridCandidates(r).empty());
+    EXPECT_EQ(tdoapp::multiStartSolution(r).status, tdoapp::SolutionStatus::NotEnoughReceivers);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
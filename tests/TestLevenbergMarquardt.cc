@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "../include/Receiver.hh"
+#include "../include/LevenbergMarquardt.hh"
+#include "../include/TdoaCostFunction.hh"
+#include "../include/TdoaLocator.hh"
+
+namespace {
+    std::vector<tdoapp::Receiver> noisyScenario(int n, unsigned int seed) {
+        std::mt19937 rng{seed};
+        std::uniform_real_distribution<double> area{-10.0, 10.0};
+        std::normal_distribution<double> noise{0.0, 0.05};
+
+        Eigen::Vector2d emitter{area(rng), area(rng)};
+        std::vector<tdoapp::Receiver> receivers;
+        for (int i = 0; i < n; i++) {
+            Eigen::Vector2d s{area(rng), area(rng)};
+            receivers.emplace_back(s[0], s[1], (emitter - s).norm() + noise(rng));
+        }
+        return receivers;
+    }
+}
+
+TEST(TestLevenbergMarquardt, testCostMatchesPairs) {
+    auto r = noisyScenario(7, 3);
+
+    // Explicit pair residuals from the ceres cost function
+    tdoapp::TdoaCostFunction cost{r};
+    double xy[2] = {1.0, -2.0};
+    const double *parameters[1] = {xy};
+    std::vector<double> residuals(cost.num_residuals());
+    cost.Evaluate(parameters, residuals.data(), nullptr);
+    double expected = 0.0;
+    for (auto residual: residuals) {
+        expected += 0.5 * residual * residual;
+    }
+
+    // Zero iterations returns the cost at the initial guess
+    tdoapp::LevenbergMarquardtOptions options;
+    options.maxIterations = 0;
+    auto summary = tdoapp::levenbergMarquardt(r, Eigen::Vector2d{1.0, -2.0}, options);
+
+    EXPECT_NEAR(summary.cost, expected, 1e-9);
+    EXPECT_EQ(summary.iterations, 0);
+}
+
+TEST(TestLevenbergMarquardt, testFixedMatchesDynamic) {
+    auto r = noisyScenario(8, 7);
+    Eigen::Matrix<double, 2, 8> positions;
+    Eigen::Matrix<double, 8, 1> timestamps;
+    for (int i = 0; i < 8; i++) {
+        positions.col(i) << r[i].x, r[i].y;
+        timestamps[i] = r[i].timestamp;
+    }
+    Eigen::Vector2d init = tdoapp::initialGuess(r);
+
+    auto fixed = tdoapp::TdoaLevenbergMarquardt<8>{}.solve(positions, timestamps, init);
+    auto dynamic = tdoapp::TdoaLevenbergMarquardt<>{}.solve(Eigen::Matrix2Xd{positions},
+                                                             Eigen::VectorXd{timestamps}, init);
+
+    EXPECT_TRUE(fixed.converged);
+    EXPECT_EQ(fixed.iterations, dynamic.iterations);
+    EXPECT_NEAR(fixed.position[0], dynamic.position[0], 1e-12);
+    EXPECT_NEAR(fixed.position[1], dynamic.position[1], 1e-12);
+}
+
+TEST(TestLevenbergMarquardt, testMatchesCeres) {
+    for (int n: {3, 4, 5, 8, 12, 13, 20}) {
+        auto r = noisyScenario(n, 11 + n);
+        Eigen::Vector2d init = tdoapp::initialGuess(r);
+
+        auto expected = tdoapp::nonlinearOptimization(r, init);
+        auto result = tdoapp::nonlinearOptimization(r, init, tdoapp::NlsBackend::LevenbergMarquardt);
+
+        EXPECT_NEAR(result[0], expected[0], 1e-5) << n << " receivers";
+        EXPECT_NEAR(result[1], expected[1], 1e-5) << n << " receivers";
+    }
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
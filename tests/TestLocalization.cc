@@ -4,12 +4,33 @@
 
 
 #include <cmath>
+#include <random>
 
+#include <Eigen/SVD>
 #include <gtest/gtest.h>
 
 #include "../include/Receiver.hh"
 #include "../include/TdoaLocator.hh"
 
+namespace {
+    // Linear TDOA system built explicitly and solved with a dense SVD, independent of the library's factorizations
+    Eigen::Vector2d referenceLinear(const std::vector<tdoapp::Receiver> &r) {
+        const auto m = static_cast<Eigen::Index>(r.size() - 1);
+        Eigen::MatrixXd A(m, 3);
+        Eigen::VectorXd b(m);
+        for (Eigen::Index i = 0; i < m; i++) {
+            const auto &ri = r[static_cast<size_t>(i) + 1];
+            const double tau = r[0].timestamp - ri.timestamp;
+            A(i, 0) = -tau;
+            A(i, 1) = r[0].x - ri.x;
+            A(i, 2) = r[0].y - ri.y;
+            b[i] = 0.5 * (tau * tau + r[0].x * r[0].x + r[0].y * r[0].y - ri.x * ri.x - ri.y * ri.y);
+        }
+        Eigen::Vector3d solution = A.jacobiSvd(Eigen::ComputeThinU | Eigen::ComputeThinV).solve(b);
+        return {solution[1], solution[2]};
+    }
+}
+
 TEST(TestLocalization, testLinear) {
     auto r1 = tdoapp::Receiver{0.0, 0.0, 5.0};
     auto r2 = tdoapp::Receiver{3.0, 1.0, 3.0};
@@ -63,6 +84,74 @@ TEST(TestLocalization, testNLLS) {
     EXPECT_NEAR(result[1],4.0,1e-5);
 }
 
+TEST(TestLocalization, testNLLSAutoDiff) {
+    auto r1 = tdoapp::Receiver{0.0, 0.0, 5.0};
+    auto r2 = tdoapp::Receiver{3.0, 1.0, 3.0};
+    auto r3 = tdoapp::Receiver{0.0, 3.0, std::sqrt(10.0)};
+    auto r4 = tdoapp::Receiver{6.0, 4.0, 3.0};
+    auto r5 = tdoapp::Receiver{3.0, 14.0, 10.0};
+
+    auto r = std::vector<tdoapp::Receiver> {r1,r2,r3,r4,r5};
+    auto result = tdoapp::nonlinearOptimization(r,Eigen::Vector2d {0.0,0.0}, tdoapp::CostModel::AutoDiff);
+
+    EXPECT_NEAR(result[0],3.0,1e-5);
+    EXPECT_NEAR(result[1],4.0,1e-5);
+}
+
+TEST(TestLocalization, testNLLSSummary) {
+    auto r1 = tdoapp::Receiver{0.0, 0.0, 5.0};
+    auto r2 = tdoapp::Receiver{3.0, 1.0, 3.0};
+    auto r3 = tdoapp::Receiver{0.0, 3.0, std::sqrt(10.0)};
+    auto r4 = tdoapp::Receiver{6.0, 4.0, 3.0};
+    auto r5 = tdoapp::Receiver{3.0, 14.0, 10.0};
+
+    auto r = std::vector<tdoapp::Receiver> {r1,r2,r3,r4,r5};
+    ceres::Solver::Summary summary;
+    auto result = tdoapp::nonlinearOptimization(r, Eigen::Vector2d{0.0, 0.0}, tdoapp::CostModel::Analytic, &summary);
+
+    EXPECT_NEAR(result[0], 3.0, 1e-5);
+    EXPECT_NEAR(result[1], 4.0, 1e-5);
+    EXPECT_TRUE(summary.IsSolutionUsable());
+    EXPECT_GT(summary.num_successful_steps, 0);
+    EXPECT_LT(summary.final_cost, summary.initial_cost);
+}
+
+TEST(TestLocalization, testNLLSReferenceTopology) {
+    std::mt19937 rng{3};
+    std::uniform_real_distribution<double> area{-50.0, 50.0};
+    std::normal_distribution<double> noise{0.0, 0.2};
+    const Eigen::Vector2d emitter{7.0, -12.0};
+    std::vector<tdoapp::Receiver> r;
+    for (int i = 0; i < 60; i++) {
+        Eigen::Vector2d s{area(rng), area(rng)};
+        r.emplace_back(s[0], s[1], (emitter - s).norm() + 4.0 + noise(rng));
+    }
+
+    // Same minimum as all the pairs, with 59 residuals instead of 1770
+    const auto start = tdoapp::initialGuess(r);
+    const auto pairs = tdoapp::nonlinearSolution(r, start, tdoapp::CostModel::Analytic);
+    const auto reference = tdoapp::nonlinearSolution(r, start, tdoapp::CostModel::Reference);
+    ASSERT_TRUE(reference.usable());
+    EXPECT_EQ(reference.method, tdoapp::SolutionMethod::NonlinearLeastSquares);
+    EXPECT_NEAR((reference.position - pairs.position).norm(), 0.0, 1e-6);
+    EXPECT_NEAR(reference.residualNorm, pairs.residualNorm, 1e-6);
+    EXPECT_NEAR((reference.position - emitter).norm(), 0.0, 0.2);
+}
+
+TEST(TestLocalization, testNLLSLevenbergMarquardt) {
+    auto r1 = tdoapp::Receiver{0.0, 0.0, 5.0};
+    auto r2 = tdoapp::Receiver{3.0, 1.0, 3.0};
+    auto r3 = tdoapp::Receiver{0.0, 3.0, std::sqrt(10.0)};
+    auto r4 = tdoapp::Receiver{6.0, 4.0, 3.0};
+    auto r5 = tdoapp::Receiver{3.0, 14.0, 10.0};
+
+    auto r = std::vector<tdoapp::Receiver> {r1,r2,r3,r4,r5};
+    auto result = tdoapp::nonlinearOptimization(r,Eigen::Vector2d {0.0,0.0}, tdoapp::NlsBackend::LevenbergMarquardt);
+
+    EXPECT_NEAR(result[0],3.0,1e-5);
+    EXPECT_NEAR(result[1],4.0,1e-5);
+}
+
 TEST(TestLocalization, testFull) {
     auto r1 = tdoapp::Receiver{0.0, 0.0, 5.0};
     auto r2 = tdoapp::Receiver{3.0, 1.0, 3.0};
@@ -84,6 +173,80 @@ TEST(TestLocalization, testFull) {
     EXPECT_NEAR(result[1],4.0,1e-5);
 }
 
+TEST(TestLocalization, testLsTemplated2d) {
+    std::mt19937 rng{17};
+    std::uniform_real_distribution<double> area{-10.0, 10.0};
+    std::normal_distribution<double> noise{0.0, 0.05};
+
+    for (int n: {4, 5, 8, 20}) {
+        Eigen::Vector2d emitter{area(rng), area(rng)};
+        std::vector<tdoapp::Receiver> r;
+        for (int i = 0; i < n; i++) {
+            Eigen::Vector2d s{area(rng), area(rng)};
+            r.emplace_back(s[0], s[1], (emitter - s).norm() + noise(rng));
+        }
+
+        auto expected = referenceLinear(r);
+        auto result = tdoapp::linearTDOA<2>(r);
+        EXPECT_NEAR(result[0], expected[0], 1e-8) << n << " receivers";
+        EXPECT_NEAR(result[1], expected[1], 1e-8) << n << " receivers";
+    }
+}
+
+TEST(TestLocalization, testLinearSolvers) {
+    std::mt19937 rng{29};
+    std::uniform_real_distribution<double> area{-10.0, 10.0};
+    std::normal_distribution<double> noise{0.0, 0.05};
+    const auto solvers = {tdoapp::LinearSolver::Auto, tdoapp::LinearSolver::NormalEquations,
+                          tdoapp::LinearSolver::Givens};
+
+    for (int n: {4, 5, 8, 20}) {
+        Eigen::Vector2d emitter{area(rng), area(rng)};
+        std::vector<tdoapp::Receiver> r;
+        for (int i = 0; i < n; i++) {
+            Eigen::Vector2d s{area(rng), area(rng)};
+            r.emplace_back(s[0], s[1], (emitter - s).norm() + noise(rng));
+        }
+
+        auto reference = tdoapp::linearTDOA(r, tdoapp::LinearSolver::Svd);
+        for (auto solver: solvers) {
+            EXPECT_NEAR((tdoapp::linearTDOA(r, solver) - reference).norm(), 0.0, 1e-8) << n << " receivers";
+        }
+    }
+
+    // Receivers almost on a line: the normal equations lose most digits and Auto switches to the SVD
+    const Eigen::Vector2d emitter{3.0, 4.0};
+    std::vector<tdoapp::Receiver> r;
+    for (int i = 0; i < 6; i++) {
+        Eigen::Vector2d s{2.0 * i, 1e-5 * i * i};
+        r.emplace_back(s[0], s[1], (emitter - s).norm());
+    }
+    auto reference = tdoapp::linearTDOA(r, tdoapp::LinearSolver::Svd);
+    EXPECT_NEAR((reference - emitter).norm(), 0.0, 1e-3);
+    EXPECT_EQ(tdoapp::linearTDOA(r, tdoapp::LinearSolver::Auto), reference);
+    EXPECT_EQ(tdoapp::linearSolution(r, tdoapp::LinearSolver::Svd).position, reference);
+}
+
+TEST(TestLocalization, testFull3d) {
+    const Eigen::Vector3d emitter{3.0, 4.0, 2.5};
+    auto r = std::vector<tdoapp::Receiver3d>{};
+    for (const auto &s: {Eigen::Vector3d{0.0, 0.0, 0.0}, Eigen::Vector3d{10.0, 0.0, 1.0},
+                         Eigen::Vector3d{0.0, 10.0, 0.5}, Eigen::Vector3d{10.0, 10.0, 3.0},
+                         Eigen::Vector3d{5.0, -4.0, 8.0}, Eigen::Vector3d{-3.0, 6.0, 6.0}}) {
+        r.emplace_back(s[0], s[1], s[2], (emitter - s).norm() + 7.0);
+    }
+
+    auto init = tdoapp::linearTDOA(r);
+    EXPECT_NEAR((init - emitter).norm(), 0.0, 1e-6);
+
+    auto result = tdoapp::nonlinearOptimization(r, Eigen::Vector3d{init + Eigen::Vector3d{1.0, -1.0, 0.5}});
+    EXPECT_NEAR((result - emitter).norm(), 0.0, 1e-5);
+
+    // Not enough receivers for the 4 unknowns of the linear problem
+    r.erase(r.begin() + 4, r.end());
+    EXPECT_THROW(tdoapp::linearTDOA(r), std::invalid_argument);
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
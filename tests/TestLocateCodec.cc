@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <gtest/gtest.h>
+
+#include "../include/LocateCodec.hh"
+
+TEST(TestLocateCodec, testRequest) {
+    tdoapp::LocateRequest request;
+    request.method = 2;
+    request.measurements = {{{0.0, 0.0, 1.0}, {100.0, 0.0, 2.0}, {0.0, 100.0, 3.0}},
+                            {{0.0, 0.0, 4.0}, {100.0, 0.0, 5.0}, {0.0, 100.0, 6.0}}};
+    const auto data = tdoapp::encodeLocateRequest(request);
+    EXPECT_EQ(data.size(), 32u + 2 * 3 * 3 * sizeof(double));
+
+    const auto decoded = tdoapp::decodeLocateRequest(data);
+    EXPECT_EQ(decoded.method, 2);
+    EXPECT_EQ(decoded.flags, 0u);
+    ASSERT_EQ(decoded.measurements.size(), 2u);
+    ASSERT_EQ(decoded.measurements[1].size(), 3u);
+    EXPECT_EQ(decoded.measurements[1][1].x, 100.0);
+    EXPECT_EQ(decoded.measurements[1][2].y, 100.0);
+    EXPECT_EQ(decoded.measurements[1][2].timestamp, 6.0);
+
+    tdoapp::LocateRequest geodetic;
+    geodetic.flags = tdoapp::kLocateGeodetic;
+    geodetic.geodetic = {{{43.26, -2.93, 20.0, 1.0}, {43.29, -2.90, 45.0, 2.0}, {43.24, -2.88, 10.0, 3.0}}};
+    const auto g = tdoapp::decodeLocateRequest(tdoapp::encodeLocateRequest(geodetic));
+    ASSERT_EQ(g.geodetic.size(), 1u);
+    EXPECT_EQ(g.geodetic[0][1].longitude, -2.90);
+    EXPECT_EQ(g.geodetic[0][2].timestamp, 3.0);
+    EXPECT_TRUE(g.measurements.empty());
+
+    // The id is padded, so that the TOAs stay 8-byte aligned
+    tdoapp::LocateRequest set;
+    set.method = 3;
+    set.flags = tdoapp::kLocateReceiverSet;
+    set.set = "north";
+    set.toas = tdoapp::ToaMatrix{{1.0, 2.0, 3.0, 4.0}, {5.0, 6.0, 7.0, 8.0}};
+    const auto setData = tdoapp::encodeLocateRequest(set);
+    EXPECT_EQ(setData.size(), 32u + 8 + 8 + 8 * sizeof(double));
+    const auto s = tdoapp::decodeLocateRequest(setData);
+    EXPECT_EQ(s.set, "north");
+    EXPECT_EQ(s.toas, set.toas);
+    EXPECT_EQ(s.method, 3);
+}
+
+TEST(TestLocateCodec, testInvalidRequest) {
+    tdoapp::LocateRequest request;
+    request.measurements = {{{0.0, 0.0, 1.0}, {100.0, 0.0, 2.0}, {0.0, 100.0, 3.0}}};
+    const auto data = tdoapp::encodeLocateRequest(request);
+
+    EXPECT_THROW(tdoapp::decodeLocateRequest(data.substr(0, 16)), std::invalid_argument);
+    EXPECT_THROW(tdoapp::decodeLocateRequest(data.substr(0, data.size() - 8)), std::invalid_argument);
+    EXPECT_THROW(tdoapp::decodeLocateRequest(data + std::string(8, '\0')), std::invalid_argument);
+    EXPECT_THROW(tdoapp::decodeLocateRequest("{\"measurements\": []}"), std::invalid_argument);
+
+    // Sizes that would overflow must not pass for a short payload
+    auto huge = data;
+    const std::uint64_t count = std::numeric_limits<std::uint64_t>::max() / 3 + 1;
+    std::memcpy(&huge[24], &count, sizeof(count));
+    EXPECT_THROW(tdoapp::decodeLocateRequest(huge), std::invalid_argument);
+
+    // Without receivers, the header alone must not make the decoder allocate its measurements
+    auto empty = data.substr(0, 32);
+    const std::uint64_t none = 0;
+    std::memcpy(&empty[16], &none, sizeof(none));
+    for (const std::uint64_t measurements: {std::uint64_t{20'000'000}, std::uint64_t{1} << 62}) {
+        std::memcpy(&empty[24], &measurements, sizeof(measurements));
+        EXPECT_THROW(tdoapp::decodeLocateRequest(empty), std::invalid_argument);
+        empty[12] = static_cast<char>(tdoapp::kLocateGeodetic);
+        EXPECT_THROW(tdoapp::decodeLocateRequest(empty), std::invalid_argument);
+        empty[12] = 0;
+    }
+    const std::uint64_t two = 2;
+    std::memcpy(&empty[16], &two, sizeof(two));
+    EXPECT_THROW(tdoapp::decodeLocateRequest(empty), std::invalid_argument);
+
+    auto nan = data;
+    const double value = std::numeric_limits<double>::quiet_NaN();
+    std::memcpy(&nan[32 + 4 * sizeof(double)], &value, sizeof(value));
+    EXPECT_THROW(tdoapp::decodeLocateRequest(nan), std::invalid_argument);
+
+    auto flags = data;
+    flags[12] = static_cast<char>(tdoapp::kLocateGeodetic | tdoapp::kLocateReceiverSet);
+    EXPECT_THROW(tdoapp::decodeLocateRequest(flags), std::invalid_argument);
+
+    request.measurements.push_back({{0.0, 0.0, 1.0}});
+    EXPECT_THROW(tdoapp::encodeLocateRequest(request), std::invalid_argument);
+    EXPECT_THROW(tdoapp::encodeLocateRequest(tdoapp::LocateRequest{}), std::invalid_argument);
+}
+
+TEST(TestLocateCodec, testResponse) {
+    const std::vector<Eigen::Vector2d> positions{{1.5, -2.5}, {3.0, 4.0}};
+    int method = 0;
+    bool geodetic = true;
+    const auto planar = tdoapp::decodeLocateResponse(tdoapp::encodeLocateResponse(2, positions), &method, &geodetic);
+    EXPECT_EQ(method, 2);
+    EXPECT_FALSE(geodetic);
+    ASSERT_EQ(planar.rows(), 2);
+    ASSERT_EQ(planar.cols(), 2);
+    EXPECT_EQ(planar.col(0), positions[0]);
+    EXPECT_EQ(planar.col(1), positions[1]);
+
+    const std::vector<tdoapp::GeodeticPosition> fixes{{43.27, -2.93, 30.0}};
+    const auto data = tdoapp::encodeLocateResponse(4, fixes);
+    EXPECT_EQ(data.size(), 24u + 3 * sizeof(double));
+    const auto wgs84 = tdoapp::decodeLocateResponse(data, &method, &geodetic);
+    EXPECT_EQ(method, 4);
+    EXPECT_TRUE(geodetic);
+    EXPECT_EQ(wgs84(1, 0), -2.93);
+    EXPECT_EQ(wgs84(2, 0), 30.0);
+
+    EXPECT_EQ(tdoapp::decodeLocateResponse(tdoapp::encodeLocateResponse(1, std::vector<Eigen::Vector2d>{})).cols(), 0);
+    EXPECT_THROW(tdoapp::decodeLocateResponse(data.substr(0, data.size() - 1)), std::invalid_argument);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+
+#include "../include/Receiver.hh"
+#include "../include/TdoaLocator.hh"
+#include "../src/MeasurementStream.hh"
+
+namespace {
+    // 12 receivers around an emitter, keys written in reverse so that neither string nor document order is numeric
+    nlohmann::json twelveReceivers() {
+        std::mt19937 rng{5};
+        std::uniform_real_distribution<double> area{-20.0, 20.0};
+        Eigen::Vector2d emitter{1.5, -2.0};
+
+        std::vector<tdoapp::Receiver> receivers;
+        for (int i = 0; i < 12; i++) {
+            Eigen::Vector2d p{area(rng), area(rng)};
+            receivers.emplace_back(p.x(), p.y(), (p - emitter).norm() / tdoapp::kSPEEDOFLIGHT);
+        }
+
+        std::ostringstream object;
+        object << "{";
+        for (int i = 11; i >= 0; i--) {
+            object << "\"" << i << "\": [" << receivers[i].x << ", " << receivers[i].y << ", "
+                   << receivers[i].timestamp << "]" << (i > 0 ? ", " : "");
+        }
+        object << "}";
+        return nlohmann::json::parse(object.str());
+    }
+}
+
+TEST(TestMeasurementStream, testStreamMatchesDom) {
+    auto measurement = twelveReceivers();
+    nlohmann::json document = {{"measurements", {measurement}}};
+
+    auto dom = tdoapp::toMeasurement(measurement);
+
+    std::vector<tdoapp::Measurement> streamed;
+    std::istringstream is{document.dump()};
+    ASSERT_TRUE(tdoapp::streamMeasurements(is, [&](tdoapp::Measurement &&m) { streamed.push_back(std::move(m)); }));
+    ASSERT_EQ(streamed.size(), 1u);
+    ASSERT_EQ(streamed[0].size(), 12u);
+    ASSERT_EQ(dom.size(), 12u);
+
+    // Receivers in numeric key order on both paths
+    for (size_t i = 0; i < dom.size(); i++) {
+        EXPECT_EQ(dom[i].x, measurement[std::to_string(i)][0].get<double>());
+        EXPECT_EQ(streamed[0][i].x, dom[i].x);
+        EXPECT_EQ(streamed[0][i].y, dom[i].y);
+        EXPECT_EQ(streamed[0][i].timestamp, dom[i].timestamp);
+    }
+
+    for (auto method: {tdoapp::Method::Linear, tdoapp::Method::Nonlinear}) {
+        EXPECT_EQ(tdoapp::locate(streamed[0], method), tdoapp::locate(dom, method));
+    }
+}
+
+TEST(TestMeasurementStream, testRejectsNonNumericValues) {
+    // Only receiver 1 is valid: non-numeric values, a nested array, a scalar and an object are all rejected
+    auto document = nlohmann::json::parse(
+            R"({"measurements": [{"0": [1, "a", 2, 3], "1": [0, 0, 0], "2": [1, null, 2], "3": [1, [2], 3],
+                                  "4": 5, "5": {"a": 1, "b": 2, "c": 3}}]})");
+
+    auto dom = tdoapp::toMeasurement(document["measurements"][0]);
+    ASSERT_EQ(dom.size(), 1u);
+    EXPECT_EQ(dom[0].x, 0.0);
+
+    std::vector<tdoapp::Measurement> streamed;
+    std::istringstream is{document.dump()};
+    ASSERT_TRUE(tdoapp::streamMeasurements(is, [&](tdoapp::Measurement &&m) { streamed.push_back(std::move(m)); }));
+    ASSERT_EQ(streamed.size(), 1u);
+    ASSERT_EQ(streamed[0].size(), 1u);
+    EXPECT_EQ(streamed[0][0].x, 0.0);
+}
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+#include "../include/Receiver.hh"
+#include "../include/NlsContext.hh"
+#include "../include/TdoaLocator.hh"
+
+namespace {
+    const std::vector<tdoapp::Receiver> kReceivers{{0.0, 0.0}, {3.0, 1.0}, {0.0, 3.0}, {6.0, 4.0}, {3.0, 14.0}};
+
+    Eigen::VectorXd timestampsFor(const Eigen::Vector2d &emitter) {
+        Eigen::VectorXd timestamps(kReceivers.size());
+        for (size_t i = 0; i < kReceivers.size(); i++) {
+            timestamps[static_cast<Eigen::Index>(i)] = (emitter - Eigen::Vector2d{kReceivers[i].x, kReceivers[i].y}).norm();
+        }
+        return timestamps;
+    }
+}
+
+TEST(TestNlsContext, testColdStart) {
+    tdoapp::NlsContext context{kReceivers};
+
+    auto result = context.solve(timestampsFor(Eigen::Vector2d{3.0, 4.0}));
+
+    EXPECT_NEAR(result[0],3.0,1e-5);
+    EXPECT_NEAR(result[1],4.0,1e-5);
+    EXPECT_TRUE(context.summary().IsSolutionUsable());
+}
+
+TEST(TestNlsContext, testTrack) {
+    tdoapp::NlsContext context{kReceivers};
+
+    // Emitter moving along a line, each fix warm-started from the previous one
+    for (int k = 0; k < 20; k++) {
+        Eigen::Vector2d emitter{3.0 + 0.1 * k, 4.0 - 0.05 * k};
+        auto result = context.solve(timestampsFor(emitter));
+
+        EXPECT_NEAR(result[0],emitter[0],1e-5);
+        EXPECT_NEAR(result[1],emitter[1],1e-5);
+    }
+
+    // Cold start after reset: same result as the one-shot refinement from the same guess
+    auto timestamps = timestampsFor(Eigen::Vector2d{1.0, 7.0});
+    context.reset();
+    auto result = context.solve(timestamps, Eigen::Vector2d{0.0, 0.0});
+    EXPECT_NEAR(result[0],1.0,1e-5);
+    EXPECT_NEAR(result[1],7.0,1e-5);
+
+    auto receivers = kReceivers;
+    for (size_t i = 0; i < receivers.size(); i++) {
+        receivers[i].timestamp = timestamps[static_cast<Eigen::Index>(i)];
+    }
+    auto oneShot = tdoapp::nonlinearOptimization(receivers, Eigen::Vector2d{0.0, 0.0});
+    EXPECT_NEAR(result[0],oneShot[0],1e-6);
+    EXPECT_NEAR(result[1],oneShot[1],1e-6);
+}
+
+TEST(TestNlsContext, testReferenceTopology) {
+    tdoapp::NlsOptions options;
+    options.topology = tdoapp::ResidualTopology::Reference;
+    tdoapp::NlsContext context{kReceivers, options};
+
+    // The earliest receiver changes along the track
+    for (const Eigen::Vector2d &emitter: {Eigen::Vector2d{1.0, 1.0}, Eigen::Vector2d{5.0, 4.0},
+                                          Eigen::Vector2d{2.0, 12.0}}) {
+        auto result = context.solve(timestampsFor(emitter));
+        EXPECT_NEAR(result[0],emitter[0],1e-5);
+        EXPECT_NEAR(result[1],emitter[1],1e-5);
+    }
+}
+
+TEST(TestNlsContext, testWrongSize) {
+    tdoapp::NlsContext context{kReceivers};
+
+    EXPECT_THROW(context.solve(Eigen::Vector3d{1.0, 2.0, 3.0}), std::invalid_argument);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
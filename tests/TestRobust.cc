@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#include <cmath>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "../include/Receiver.hh"
+#include "../include/RobustLocator.hh"
+#include "../include/TdoaLocator.hh"
+#include "../include/ThreadPool.hh"
+
+namespace {
+    // Receivers on a ring around the emitter, TOAs with small noise and the given receivers delayed by a multipath
+    std::vector<tdoapp::Receiver> scenario(const Eigen::Vector2d &emitter, int n, const std::vector<int> &outliers) {
+        std::mt19937 rng{7};
+        std::normal_distribution<double> noise{0.0, 0.01};
+        std::vector<tdoapp::Receiver> r;
+        for (int i = 0; i < n; i++) {
+            const double angle = 2.0 * M_PI * i / n;
+            Eigen::Vector2d s{20.0 * std::cos(angle), 15.0 * std::sin(angle)};
+            r.emplace_back(s[0], s[1], (emitter - s).norm() + 3.0 + noise(rng));
+        }
+        for (auto i: outliers) {
+            r[i].timestamp += 8.0;
+        }
+        return r;
+    }
+}
+
+TEST(TestRobust, testRejectsOutliers) {
+    const Eigen::Vector2d emitter{3.0, 4.0};
+    auto r = scenario(emitter, 10, {2, 7});
+
+    // A delayed TOA drags the least squares solutions away
+    EXPECT_GT((tdoapp::locate(r, tdoapp::Method::Nonlinear) - emitter).norm(), 0.5);
+
+    auto robust = tdoapp::robustSolution(r);
+    EXPECT_TRUE(robust.solution.usable());
+    EXPECT_EQ(robust.solution.method, tdoapp::SolutionMethod::NonlinearLeastSquares);
+    EXPECT_NEAR((robust.solution.position - emitter).norm(), 0.0, 0.05);
+    EXPECT_FALSE(robust.timedOut);
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(robust.inliers[i], i != 2 && i != 7) << i;
+    }
+
+    // Confidence reached long before the 120 triples
+    EXPECT_LT(robust.hypotheses, 120u);
+
+    EXPECT_NEAR((tdoapp::locate(r, tdoapp::Method::Robust) - emitter).norm(), 0.0, 0.05);
+}
+
+TEST(TestRobust, testParallelMatchesSerial) {
+    const Eigen::Vector2d emitter{-2.0, 1.0};
+    auto r = scenario(emitter, 40, {0, 5, 6, 13, 30});
+
+    tdoapp::RansacOptions options;
+    auto serial = tdoapp::robustSolution(r, options);
+
+    tdoapp::ThreadPool pool{2};
+    options.pool = &pool;
+    auto parallel = tdoapp::robustSolution(r, options);
+
+    EXPECT_NEAR((serial.solution.position - emitter).norm(), 0.0, 0.05);
+    EXPECT_NEAR((parallel.solution.position - emitter).norm(), 0.0, 0.05);
+    EXPECT_EQ(serial.inliers, parallel.inliers);
+    EXPECT_GE(parallel.hypotheses, serial.hypotheses);
+}
+
+TEST(TestRobust, testBudget) {
+    auto r = scenario({1.0, 1.0}, 60, {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20});
+
+    // The budget runs out long before the confidence target
+    tdoapp::RansacOptions options;
+    options.budget = std::chrono::microseconds{1};
+    options.confidence = 0.999999;
+    auto robust = tdoapp::robustSolution(r, options);
+    EXPECT_TRUE(robust.timedOut);
+    EXPECT_NE(robust.solution.status, tdoapp::SolutionStatus::Ok);
+    EXPECT_LT(robust.hypotheses, options.maxHypotheses);
+}
+
+TEST(TestRobust, testBudgetBeforeFirstHypothesis) {
+    auto r = scenario({1.0, 1.0}, 10, {2});
+
+    // Spent before anything is scored: reported as such, with no estimate
+    tdoapp::RansacOptions options;
+    options.budget = std::chrono::nanoseconds{1};
+    auto robust = tdoapp::robustSolution(r, options);
+    EXPECT_TRUE(robust.timedOut);
+    EXPECT_EQ(robust.solution.status, tdoapp::SolutionStatus::TimedOut);
+    if (robust.hypotheses == 0) {
+        EXPECT_FALSE(robust.solution.usable());
+    }
+}
+
+TEST(TestRobust, testSmallSets) {
+    auto three = std::vector<tdoapp::Receiver>{{0.0, 0.0, 5.0}, {3.0, 1.0, 3.0}, {0.0, 3.0, std::sqrt(10.0)}};
+    auto robust = tdoapp::robustSolution(three);
+    EXPECT_TRUE(robust.solution.usable());
+    EXPECT_NEAR(robust.solution.position[0], 3.0, 1e-5);
+    EXPECT_NEAR(robust.solution.position[1], 4.0, 1e-5);
+
+    three.pop_back();
+    EXPECT_EQ(tdoapp::robustSolution(three).solution.status, tdoapp::SolutionStatus::NotEnoughReceivers);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
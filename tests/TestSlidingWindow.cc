@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#include <algorithm>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "../include/Receiver.hh"
+#include "../include/SlidingWindowLocator.hh"
+#include "../include/TdoaGeometry.hh"
+
+namespace {
+    std::vector<tdoapp::Receiver> deployment() {
+        return {{0.0, 0.0}, {3.0, 1.0}, {0.0, 3.0}, {6.0, 4.0}, {3.0, 14.0}};
+    }
+
+    // Noisy TOAs of an emitter at (2, 5), with a few outliers
+    tdoapp::ToaMatrix toaRows(Eigen::Index n) {
+        std::mt19937 rng{3};
+        std::normal_distribution<double> noise{0.0, 0.1};
+        std::uniform_int_distribution<int> outlier{0, 9};
+
+        auto receivers = deployment();
+        tdoapp::ToaMatrix toas(n, receivers.size());
+        for (Eigen::Index k = 0; k < n; k++) {
+            for (size_t i = 0; i < receivers.size(); i++) {
+                toas(k, i) = std::hypot(2.0 - receivers[i].x, 5.0 - receivers[i].y) + noise(rng) +
+                             (outlier(rng) == 0 ? 5.0 : 0.0);
+            }
+        }
+        return toas;
+    }
+
+    // Brute-force statistic of a column window
+    double reference(std::vector<double> values, tdoapp::WindowStatistic statistic, double trimFraction) {
+        std::sort(values.begin(), values.end());
+        const auto n = values.size();
+        switch (statistic) {
+            case tdoapp::WindowStatistic::Median:
+                return n % 2 ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+            case tdoapp::WindowStatistic::TrimmedMean: {
+                auto k = std::min(static_cast<size_t>(trimFraction * static_cast<double>(n)), (n - 1) / 2);
+                double sum = 0.0;
+                for (size_t i = k; i < n - k; i++) {
+                    sum += values[i];
+                }
+                return sum / static_cast<double>(n - 2 * k);
+            }
+            default: {
+                double sum = 0.0;
+                for (auto v: values) {
+                    sum += v;
+                }
+                return sum / static_cast<double>(n);
+            }
+        }
+    }
+}
+
+TEST(TestSlidingWindow, testMatchesBruteForce) {
+    const auto toas = toaRows(200);
+    const tdoapp::TdoaGeometry geometry{deployment()};
+
+    for (auto statistic: {tdoapp::WindowStatistic::Mean, tdoapp::WindowStatistic::Median,
+                          tdoapp::WindowStatistic::TrimmedMean}) {
+        for (size_t W: {1, 4, 7}) {
+            tdoapp::SlidingWindowOptions options;
+            options.windowSize = W;
+            options.statistic = statistic;
+            options.trimFraction = 0.25;
+            tdoapp::SlidingWindowLocator locator{deployment(), options};
+
+            for (Eigen::Index k = 0; k < toas.rows(); k++) {
+                auto fix = locator.push(toas.row(k).transpose());
+                if (static_cast<size_t>(k) + 1 < W) {
+                    EXPECT_FALSE(fix.has_value());
+                    continue;
+                }
+                ASSERT_TRUE(fix.has_value());
+
+                Eigen::VectorXd expected(toas.cols());
+                for (Eigen::Index j = 0; j < toas.cols(); j++) {
+                    std::vector<double> window;
+                    for (Eigen::Index i = k + 1 - static_cast<Eigen::Index>(W); i <= k; i++) {
+                        window.push_back(toas(i, j));
+                    }
+                    expected[j] = reference(window, statistic, options.trimFraction);
+                }
+                ASSERT_LT((locator.windowToas() - expected).norm(), 1e-10);
+
+                auto expectedFix = geometry.initialGuess(expected);
+                EXPECT_NEAR((*fix - expectedFix).norm(), 0.0, 1e-8);
+            }
+        }
+    }
+}
+
+TEST(TestSlidingWindow, testReset) {
+    const auto toas = toaRows(10);
+    tdoapp::SlidingWindowOptions options;
+    options.windowSize = 3;
+    tdoapp::SlidingWindowLocator locator{deployment(), options};
+
+    for (Eigen::Index k = 0; k < 5; k++) {
+        locator.push(toas.row(k).transpose());
+    }
+    EXPECT_TRUE(locator.full());
+
+    locator.reset();
+    EXPECT_FALSE(locator.full());
+    EXPECT_FALSE(locator.push(toas.row(5).transpose()).has_value());
+    EXPECT_FALSE(locator.push(toas.row(6).transpose()).has_value());
+    ASSERT_TRUE(locator.push(toas.row(7).transpose()).has_value());
+
+    Eigen::VectorXd expected = toas.middleRows(5, 3).colwise().mean().transpose();
+    EXPECT_LT((locator.windowToas() - expected).norm(), 1e-12);
+}
+
+TEST(TestSlidingWindow, testInvalidInput) {
+    tdoapp::SlidingWindowOptions options;
+    options.windowSize = 0;
+    EXPECT_THROW(tdoapp::SlidingWindowLocator(deployment(), options), std::invalid_argument);
+
+    options.windowSize = 4;
+    for (auto method: {tdoapp::Method::Robust, tdoapp::Method::MultiStart}) {
+        options.method = method;
+        EXPECT_THROW(tdoapp::SlidingWindowLocator(deployment(), options), std::invalid_argument);
+    }
+
+    tdoapp::SlidingWindowLocator locator{deployment()};
+    EXPECT_THROW(locator.push(Eigen::VectorXd::Zero(3)), std::invalid_argument);
+
+    Eigen::VectorXd toas = Eigen::VectorXd::Ones(5);
+    toas[2] = std::numeric_limits<double>::quiet_NaN();
+    EXPECT_THROW(locator.push(toas), std::invalid_argument);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
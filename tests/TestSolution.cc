@@ -0,0 +1,188 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "../include/Receiver.hh"
+#include "../include/TdoaBatch.hh"
+#include "../include/TdoaGeometry.hh"
+#include "../include/TdoaLocator.hh"
+#include "../include/TdoaSolution.hh"
+
+namespace {
+    std::vector<tdoapp::Receiver> triangle(double t0, double t1, double t2) {
+        return {{0.0, 0.0, t0}, {3.0, 1.0, t1}, {0.0, 3.0, t2}};
+    }
+}
+
+TEST(TestSolution, testExact) {
+    auto solution = tdoapp::exactSolution(triangle(5.0, 3.0, std::sqrt(10.0)));
+
+    EXPECT_EQ(solution.status, tdoapp::SolutionStatus::Ok);
+    EXPECT_EQ(solution.method, tdoapp::SolutionMethod::Exact);
+    EXPECT_NEAR(solution.position[0], 3.0, 1e-5);
+    EXPECT_NEAR(solution.position[1], 4.0, 1e-5);
+    EXPECT_NEAR(solution.residualNorm, 0.0, 1e-8);
+    EXPECT_TRUE(solution.roots[0].allFinite());
+    EXPECT_TRUE(solution.roots[1].allFinite());
+}
+
+TEST(TestSolution, testExactFailuresDoNotThrow) {
+    auto noRoot = tdoapp::exactSolution(triangle(0.0, -4.0, -2.5));
+    EXPECT_EQ(noRoot.status, tdoapp::SolutionStatus::NoRealSolution);
+    EXPECT_FALSE(noRoot.usable());
+    EXPECT_TRUE(noRoot.position.hasNaN());
+
+    auto inconsistent = tdoapp::exactSolution(triangle(0.0, -4.0, -3.5));
+    EXPECT_EQ(inconsistent.status, tdoapp::SolutionStatus::NoConsistentRoot);
+    EXPECT_FALSE(inconsistent.usable());
+
+    auto invalid = tdoapp::exactSolution(triangle(0.0, 0.0, -4.0));
+    EXPECT_EQ(invalid.status, tdoapp::SolutionStatus::InvalidInput);
+
+    auto tooFew = tdoapp::exactSolution({{0.0, 0.0, 1.0}, {3.0, 1.0, 2.0}});
+    EXPECT_EQ(tooFew.status, tdoapp::SolutionStatus::NotEnoughReceivers);
+
+    // The legacy interface keeps throwing
+    EXPECT_THROW(tdoapp::exactTDOA(triangle(0.0, -4.0, -2.5)), std::runtime_error);
+}
+
+TEST(TestSolution, testExactAmbiguous) {
+    auto positive = tdoapp::exactSolution(triangle(0.0, -3.0, 0.0), true);
+    auto negative = tdoapp::exactSolution(triangle(0.0, -3.0, 0.0), false);
+
+    EXPECT_EQ(positive.status, tdoapp::SolutionStatus::Ambiguous);
+    EXPECT_TRUE(positive.usable());
+    EXPECT_EQ(positive.position, positive.roots[0]);
+    EXPECT_EQ(negative.position, negative.roots[1]);
+}
+
+TEST(TestSolution, testLinearAndNonlinear) {
+    auto r = std::vector<tdoapp::Receiver>{{0.0, 0.0, 5.2}, {3.0, 1.0, 3.1}, {0.0, 3.0, 3.1622776602},
+                                           {6.0, 4.0, 2.9}, {3.0, 14.0, 10.0}, {-4.0, 7.0, 8.3}};
+
+    auto linear = tdoapp::linearSolution(r);
+    EXPECT_EQ(linear.status, tdoapp::SolutionStatus::Ok);
+    EXPECT_EQ(linear.method, tdoapp::SolutionMethod::LinearLeastSquares);
+    EXPECT_EQ(linear.position, tdoapp::linearTDOA(r));
+    EXPECT_EQ(linear.iterations, 0);
+
+    for (auto backend: {tdoapp::NlsBackend::Ceres, tdoapp::NlsBackend::LevenbergMarquardt}) {
+        auto nlls = tdoapp::nonlinearSolution(r, linear.position, backend);
+        EXPECT_TRUE(nlls.usable());
+        EXPECT_EQ(nlls.method, tdoapp::SolutionMethod::NonlinearLeastSquares);
+        EXPECT_GT(nlls.iterations, 0);
+        EXPECT_LE(nlls.residualNorm, linear.residualNorm);
+        EXPECT_NEAR(nlls.residualNorm, tdoapp::residualNorm(r, nlls.position), 1e-12);
+    }
+
+    auto located = tdoapp::locateSolution(r, tdoapp::Method::Nonlinear);
+    EXPECT_EQ(located.method, tdoapp::SolutionMethod::NonlinearLeastSquares);
+    EXPECT_NEAR((located.position - tdoapp::locate(r, tdoapp::Method::Nonlinear)).norm(), 0.0, 1e-9);
+
+    r.erase(r.begin() + 3, r.end());
+    EXPECT_EQ(tdoapp::linearSolution(r).status, tdoapp::SolutionStatus::NotEnoughReceivers);
+
+    r[1].timestamp = std::numeric_limits<double>::quiet_NaN();
+    EXPECT_EQ(tdoapp::nonlinearSolution(r, Eigen::Vector2d::Zero()).status, tdoapp::SolutionStatus::InvalidInput);
+}
+
+TEST(TestSolution, testGeometry) {
+    auto r = std::vector<tdoapp::Receiver>{{0.0, 0.0}, {3.0, 1.0}, {0.0, 3.0}, {6.0, 4.0}, {3.0, 14.0}};
+    auto geometry = tdoapp::TdoaGeometry(r);
+
+    Eigen::VectorXd timestamps(5);
+    timestamps << 5.0, 3.0, std::sqrt(10.0), 3.0, 10.0;
+
+    auto initial = geometry.initialSolution(timestamps);
+    EXPECT_EQ(initial.status, tdoapp::SolutionStatus::Ok);
+    EXPECT_EQ(initial.position, geometry.initialGuess(timestamps));
+
+    auto exact = geometry.exactSolution(timestamps);
+    EXPECT_EQ(exact.status, tdoapp::SolutionStatus::Ok);
+    EXPECT_NEAR(exact.position[0], 3.0, 1e-5);
+
+    auto nlls = geometry.nonlinearSolution(timestamps, initial.position, tdoapp::NlsBackend::LevenbergMarquardt);
+    EXPECT_EQ(nlls.status, tdoapp::SolutionStatus::Ok);
+    EXPECT_NEAR(nlls.position[0], 3.0, 1e-6);
+    EXPECT_NEAR(nlls.position[1], 4.0, 1e-6);
+    EXPECT_NEAR(nlls.residualNorm, 0.0, 1e-6);
+
+    // Wrong sizes are reported instead of thrown
+    EXPECT_EQ(geometry.linearSolution(Eigen::Vector3d{5.0, 3.0, 3.0}).status, tdoapp::SolutionStatus::InvalidInput);
+    EXPECT_EQ(geometry.nonlinearSolution(Eigen::Vector3d{5.0, 3.0, 3.0}, initial.position).status,
+              tdoapp::SolutionStatus::InvalidInput);
+}
+
+TEST(TestSolution, testCovariance) {
+    // Centered emitter in a square: sum u u^T = 2 I with zero mean, so the covariance is I / 2
+    std::vector<tdoapp::Receiver> square{{-1.0, -1.0, 1.0}, {1.0, -1.0, 1.0}, {1.0, 1.0, 1.0}, {-1.0, 1.0, 1.0}};
+    auto covariance = tdoapp::positionCovariance(square, Eigen::Vector2d::Zero());
+    EXPECT_NEAR((covariance - 0.5 * Eigen::Matrix2d::Identity()).norm(), 0.0, 1e-12);
+
+    const Eigen::Vector2d emitter{3.0, 4.0};
+    std::vector<tdoapp::Receiver> r{{0.0, 0.0}, {3.0, 1.0}, {0.0, 3.0}, {6.0, 4.0}, {3.0, 14.0}, {-4.0, 7.0}};
+    for (auto &receiver: r) {
+        receiver.timestamp = (emitter - receiver.position()).norm() + 1.5;
+    }
+    const auto expected = tdoapp::positionCovariance(r, emitter);
+    EXPECT_NEAR(expected(0, 1), expected(1, 0), 1e-12);
+    EXPECT_GT(expected.determinant(), 0.0);
+
+    // Not computed unless asked for
+    EXPECT_TRUE(tdoapp::linearSolution(r).covariance.hasNaN());
+    EXPECT_TRUE(std::isnan(tdoapp::locateSolution(r, tdoapp::Method::Nonlinear).gdop()));
+
+    auto linear = tdoapp::linearSolution(r, tdoapp::LinearSolver::Auto, true);
+    EXPECT_NEAR((linear.covariance - expected).norm(), 0.0, 1e-6);
+    for (auto backend: {tdoapp::NlsBackend::Ceres, tdoapp::NlsBackend::LevenbergMarquardt}) {
+        auto nlls = tdoapp::nonlinearSolution(r, linear.position, backend, nullptr, true);
+        EXPECT_NEAR((nlls.covariance - expected).norm(), 0.0, 1e-6);
+        EXPECT_NEAR(nlls.gdop(), std::sqrt(expected.trace()), 1e-6);
+    }
+    auto located = tdoapp::locateSolution(r, tdoapp::Method::Robust, true);
+    EXPECT_NEAR((located.covariance - expected).norm(), 0.0, 1e-6);
+
+    // Against the spread of noisy fixes
+    std::mt19937 rng{3};
+    std::normal_distribution<double> noise{0.0, 1e-3};
+    Eigen::Matrix2d spread = Eigen::Matrix2d::Zero();
+    const int fixes = 2000;
+    for (int k = 0; k < fixes; k++) {
+        auto noisy = r;
+        for (auto &receiver: noisy) {
+            receiver.timestamp += noise(rng);
+        }
+        const Eigen::Vector2d error = tdoapp::nonlinearSolution(noisy, emitter, tdoapp::NlsBackend::LevenbergMarquardt)
+                .position - emitter;
+        spread += error * error.transpose() / (fixes * 1e-6);
+    }
+    EXPECT_NEAR(spread(0, 0), expected(0, 0), 0.1 * expected(0, 0));
+    EXPECT_NEAR(spread(1, 1), expected(1, 1), 0.1 * expected(1, 1));
+    EXPECT_NEAR(spread(0, 1), expected(0, 1), 0.1 * std::sqrt(expected(0, 0) * expected(1, 1)));
+
+    // Collinear receivers do not fix the position across their line
+    std::vector<tdoapp::Receiver> line{{0.0, 0.0}, {1.0, 0.0}, {2.0, 0.0}, {3.0, 0.0}};
+    EXPECT_TRUE(std::isinf(tdoapp::positionCovariance(line, Eigen::Vector2d{5.0, 0.0}).trace()));
+}
+
+TEST(TestSolution, testBatchReportsFailuresAsNan) {
+    std::vector<tdoapp::Measurement> measurements{triangle(5.0, 3.0, std::sqrt(10.0)), triangle(0.0, -4.0, -3.5),
+                                                  triangle(0.0, -4.0, -2.5)};
+    auto results = tdoapp::locateBatch(measurements, tdoapp::Method::Linear, 2);
+
+    EXPECT_NEAR(results[0][0], 3.0, 1e-5);
+    EXPECT_TRUE(results[1].hasNaN());
+    EXPECT_TRUE(results[2].hasNaN());
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -3,9 +3,12 @@
 // Copyright 2023 Yago Lizarribar
 
 
+#include <stdexcept>
+
 #include <gtest/gtest.h>
 #include "../include/Receiver.hh"
 #include "../include/TdoaError.hh"
+#include "../include/TdoaCostFunction.hh"
 
 TEST(TestTdoaError, testTdoaError) {
 auto r1 = tdoapp::Receiver{1.0, 1.0, 4.0};
@@ -21,6 +24,106 @@ err(&x, &y, &residual);
 EXPECT_NEAR(residual, -0.9420776074, 1e-5); // 1e-5 is the allowed error
 }
 
+TEST(TestTdoaError, testAnalyticMatchesAutoDiff) {
+auto r = std::vector<tdoapp::Receiver>{{1.0, 1.0, 4.0}, {2.0, 4.0, 8.0}, {-3.0, 2.0, 5.5}, {6.0, -1.0, 7.0}};
+
+auto cost = tdoapp::TdoaCostFunction{r};
+ASSERT_EQ(cost.num_residuals(), 6);
+
+double xy[2] = {0.5, -2.0};
+const double *parameters[1] = {xy};
+double residuals[6];
+double jacobian[12];
+double *jacobians[1] = {jacobian};
+ASSERT_TRUE(cost.Evaluate(parameters, residuals, jacobians));
+
+int k = 0;
+for (size_t i = 0; i < r.size() - 1; i++) {
+    for (size_t j = i + 1; j < r.size(); j++) {
+        ceres::AutoDiffCostFunction<tdoapp::TdoaError, 1, 1, 1> reference{new tdoapp::TdoaError{r[i], r[j]}};
+        const double *p[2] = {&xy[0], &xy[1]};
+        double res, dx, dy;
+        double *J[2] = {&dx, &dy};
+        reference.Evaluate(p, &res, J);
+
+        EXPECT_NEAR(residuals[k], res, 1e-12);
+        EXPECT_NEAR(jacobian[2 * k], dx, 1e-12);
+        EXPECT_NEAR(jacobian[2 * k + 1], dy, 1e-12);
+        k++;
+    }
+}
+}
+
+TEST(TestTdoaError, testReferenceTopology) {
+auto r = std::vector<tdoapp::Receiver>{{1.0, 1.0, 4.0}, {2.0, 4.0, 8.0}, {-3.0, 2.0, 5.5}, {6.0, -1.0, 7.0},
+                                       {0.0, 5.0, 6.2}};
+
+auto pairs = tdoapp::TdoaCostFunction{r};
+double xy[2] = {0.5, -2.0};
+const double *parameters[1] = {xy};
+double pairResiduals[10];
+ASSERT_TRUE(pairs.Evaluate(parameters, pairResiduals, nullptr));
+double pairCost = 0.0;
+for (double v: pairResiduals) {
+    pairCost += v * v;
+}
+
+// Whitened: the all-pairs cost, whatever the reference
+for (int reference: {tdoapp::kAutoReference, 0, 3}) {
+    auto cost = tdoapp::TdoaCostFunction{r, tdoapp::ResidualTopology::Reference, reference};
+    ASSERT_EQ(cost.num_residuals(), 4);
+
+    double residuals[4];
+    double jacobian[8];
+    double *jacobians[1] = {jacobian};
+    ASSERT_TRUE(cost.Evaluate(parameters, residuals, jacobians));
+    double squared = 0.0;
+    for (double v: residuals) {
+        squared += v * v;
+    }
+    EXPECT_NEAR(squared, pairCost, 1e-11) << reference;
+
+    // Central differences
+    for (int c = 0; c < 2; c++) {
+        const double h = 1e-6;
+        double plus[2] = {xy[0], xy[1]}, minus[2] = {xy[0], xy[1]};
+        plus[c] += h;
+        minus[c] -= h;
+        double rp[4], rm[4];
+        const double *pp[1] = {plus}, *pm[1] = {minus};
+        cost.Evaluate(pp, rp, nullptr);
+        cost.Evaluate(pm, rm, nullptr);
+        for (int k = 0; k < 4; k++) {
+            EXPECT_NEAR(jacobian[2 * k + c], (rp[k] - rm[k]) / (2 * h), 1e-8);
+        }
+    }
+}
+
+EXPECT_THROW((tdoapp::TdoaCostFunction{r, tdoapp::ResidualTopology::Reference, 5}), std::invalid_argument);
+}
+
+TEST(TestTdoaError, testTdoaError3d) {
+auto r1 = tdoapp::Receiver3d{1.0, 1.0, 2.0, 4.0};
+auto r2 = tdoapp::Receiver3d{2.0, 4.0, -1.0, 8.0};
+
+auto err = tdoapp::TdoaError3d{r1, r2};
+double position[3] = {0.5, -1.0, 3.0};
+double residual = 0.0;
+err(position, &residual);
+
+Eigen::Vector3d p{position[0], position[1], position[2]};
+double expected = (4.0 - 8.0) - ((r1.position() - p).norm() - (r2.position() - p).norm());
+EXPECT_NEAR(residual, expected, 1e-7);
+
+// Single 2-D block agrees with the separate x and y blocks
+auto err2d = tdoapp::TdoaError{tdoapp::Receiver{1.0, 1.0, 4.0}, tdoapp::Receiver{2.0, 4.0, 8.0}};
+double xy[2] = {0.0, 0.0};
+double split = 0.0, block = 0.0;
+err2d(&xy[0], &xy[1], &split);
+err2d(xy, &block);
+EXPECT_NEAR(split, block, 1e-12);
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "../include/Receiver.hh"
+#include "../include/TdoaBatch.hh"
+#include "../include/TdoaGeometry.hh"
+#include "../include/TdoaIndex.hh"
+#include "../include/ThreadPool.hh"
+
+namespace {
+    std::string tempPath(const std::string &name) {
+        return ::testing::TempDir() + name;
+    }
+
+    std::vector<tdoapp::Receiver> deployment() {
+        return {{0.0, 0.0}, {10.0, 1.0}, {2.0, 9.0}, {9.0, 8.0}, {-3.0, 5.0}, {4.0, -2.0}};
+    }
+
+    // One row of TOAs per emitter, with an arbitrary emission time
+    tdoapp::ToaMatrix toasOf(const std::vector<tdoapp::Receiver> &receivers,
+                             const std::vector<Eigen::Vector2d> &emitters) {
+        tdoapp::ToaMatrix toas(static_cast<Eigen::Index>(emitters.size()),
+                               static_cast<Eigen::Index>(receivers.size()));
+        for (size_t k = 0; k < emitters.size(); k++) {
+            for (size_t i = 0; i < receivers.size(); i++) {
+                toas(k, i) = (emitters[k] - receivers[i].position()).norm() + 0.5 * k;
+            }
+        }
+        return toas;
+    }
+
+    std::vector<Eigen::Vector2d> emitters(size_t n) {
+        std::mt19937 rng{5};
+        std::uniform_real_distribution<double> area{-2.0, 11.0};
+        std::vector<Eigen::Vector2d> result;
+        for (size_t k = 0; k < n; k++) {
+            result.emplace_back(area(rng), area(rng));
+        }
+        return result;
+    }
+}
+
+TEST(TestTdoaIndex, testWarmStart) {
+    const auto receivers = deployment();
+    tdoapp::TdoaIndexOptions options;
+    options.resolution = 64;
+    const tdoapp::TdoaIndex index{receivers, options};
+    EXPECT_EQ(index.size(), 64u * 64u);
+    EXPECT_GT(index.memoryBytes(), index.size() * receivers.size() * sizeof(double));
+    EXPECT_TRUE(index.matches(receivers));
+
+    // The 13 x 11 bounding box grown by half of it per side
+    const double step = 13.0 * 2.0 / 63.0;
+    const auto points = emitters(200);
+    const auto toas = toasOf(receivers, points);
+    for (size_t k = 0; k < points.size(); k++) {
+        const Eigen::Vector2d start = index.warmStart(toas.row(static_cast<Eigen::Index>(k)).transpose());
+        // Closest in TDOAs, which is not always the closest grid point
+        EXPECT_LT((start - points[k]).norm(), 2.0 * step) << k;
+    }
+
+    // Noisy TDOAs lie off the tabulated surface; the start is still the exact nearest grid point
+    std::mt19937 rng{7};
+    std::normal_distribution<double> noise{0.0, 0.3};
+    for (size_t k = 0; k < 40; k++) {
+        Eigen::VectorXd timestamps = toas.row(static_cast<Eigen::Index>(k)).transpose();
+        for (Eigen::Index i = 0; i < timestamps.size(); i++) {
+            timestamps[i] += noise(rng);
+        }
+        auto distance = [&](const Eigen::Vector2d &p) {
+            double sum = 0.0;
+            for (size_t i = 1; i < receivers.size(); i++) {
+                const double expected = (p - receivers[i].position()).norm() - (p - receivers[0].position()).norm();
+                sum += std::pow(timestamps[static_cast<Eigen::Index>(i)] - timestamps[0] - expected, 2);
+            }
+            return sum;
+        };
+        double nearest = std::numeric_limits<double>::infinity();
+        for (int j = 0; j < 64; j++) {
+            for (int i = 0; i < 64; i++) {
+                nearest = std::min(nearest, distance(Eigen::Vector2d{-9.5 + step * i, -9.5 + step * j}));
+            }
+        }
+        EXPECT_NEAR(distance(index.warmStart(timestamps)), nearest, 1e-9) << k;
+    }
+
+    Eigen::VectorXd invalid = toas.row(0).transpose();
+    invalid[2] = std::numeric_limits<double>::quiet_NaN();
+    EXPECT_FALSE(index.warmStart(invalid).allFinite());
+    EXPECT_FALSE(index.warmStart(Eigen::VectorXd::Zero(3)).allFinite());
+
+    auto moved = receivers;
+    moved[3].x += 1e-3;
+    EXPECT_FALSE(index.matches(moved));
+    moved.pop_back();
+    EXPECT_FALSE(index.matches(moved));
+}
+
+TEST(TestTdoaIndex, testSaveLoad) {
+    const auto receivers = deployment();
+    tdoapp::TdoaIndexOptions options;
+    options.resolution = 32;
+    const tdoapp::TdoaIndex index{receivers, options};
+
+    const auto path = tempPath("index.tdix");
+    index.save(path);
+    const auto loaded = tdoapp::TdoaIndex::load(path);
+    EXPECT_EQ(loaded.size(), index.size());
+    EXPECT_EQ(loaded.memoryBytes(), index.memoryBytes());
+    EXPECT_TRUE(loaded.matches(receivers));
+
+    const auto toas = toasOf(receivers, emitters(50));
+    for (Eigen::Index k = 0; k < toas.rows(); k++) {
+        EXPECT_EQ(loaded.warmStart(toas.row(k).transpose()), index.warmStart(toas.row(k).transpose()));
+    }
+
+    // Truncated
+    {
+        std::ifstream ifs(path, std::ios::binary);
+        std::string data{std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+        std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+        ofs.write(data.data(), static_cast<std::streamsize>(data.size() - 4));
+    }
+    EXPECT_THROW(tdoapp::TdoaIndex::load(path), std::runtime_error);
+    std::remove(path.c_str());
+    EXPECT_THROW(tdoapp::TdoaIndex::load(path), std::runtime_error);
+}
+
+TEST(TestTdoaIndex, testLocateBatch) {
+    const auto receivers = deployment();
+    const tdoapp::TdoaGeometry geometry{receivers};
+    const tdoapp::TdoaIndex index{receivers};
+    const auto points = emitters(40);
+    const auto toas = toasOf(receivers, points);
+
+    tdoapp::ThreadPool pool{2};
+    const auto indexed = tdoapp::locateBatch(geometry, toas, tdoapp::Method::Nonlinear, pool, &index);
+    const auto guessed = tdoapp::locateBatch(geometry, toas, tdoapp::Method::Nonlinear, pool);
+    for (size_t k = 0; k < points.size(); k++) {
+        EXPECT_NEAR((indexed[k] - points[k]).norm(), 0.0, 1e-4) << k;
+        EXPECT_NEAR((indexed[k] - guessed[k]).norm(), 0.0, 1e-4) << k;
+    }
+
+    auto other = receivers;
+    other[0].y = 1.0;
+    EXPECT_THROW(tdoapp::locateBatch(tdoapp::TdoaGeometry{other}, toas, tdoapp::Method::Nonlinear, pool, &index),
+                 std::invalid_argument);
+}
+
+TEST(TestTdoaIndex, testInvalidDeployment) {
+    auto receivers = deployment();
+    tdoapp::TdoaIndexOptions options;
+    options.resolution = 1;
+    EXPECT_THROW(tdoapp::TdoaIndex(receivers, options), std::invalid_argument);
+
+    receivers[1].x = std::numeric_limits<double>::infinity();
+    EXPECT_THROW(tdoapp::TdoaIndex{receivers}, std::invalid_argument);
+
+    receivers.erase(receivers.begin() + 2, receivers.end());
+    EXPECT_THROW(tdoapp::TdoaIndex{receivers}, std::invalid_argument);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
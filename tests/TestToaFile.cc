@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "../include/Receiver.hh"
+#include "../include/TdoaBatch.hh"
+#include "../include/TdoaGeometry.hh"
+#include "../include/ToaFile.hh"
+
+namespace {
+    std::string tempPath(const std::string &name) {
+        return ::testing::TempDir() + name;
+    }
+
+    std::vector<tdoapp::Receiver> deployment() {
+        return {{0.0, 0.0}, {3.0, 1.0}, {0.0, 3.0}, {6.0, 4.0}, {3.0, 14.0}};
+    }
+}
+
+TEST(TestToaFile, testRoundTrip) {
+    auto receivers = deployment();
+    tdoapp::ToaMatrix toas(7, receivers.size());
+    toas.setRandom();
+
+    const auto path = tempPath("roundtrip.tdoa");
+    tdoapp::writeToaFile(path, receivers, toas);
+    ASSERT_TRUE(tdoapp::isToaFile(path));
+
+    tdoapp::ToaFile file{path};
+    EXPECT_EQ(file.receiverCount(), receivers.size());
+    EXPECT_EQ(file.measurementCount(), 7u);
+    EXPECT_EQ(file.toas(), toas);
+    for (size_t i = 0; i < receivers.size(); i++) {
+        EXPECT_EQ(file.positions()(0, i), receivers[i].x);
+        EXPECT_EQ(file.positions()(1, i), receivers[i].y);
+    }
+
+    // Moving keeps the mapping alive
+    tdoapp::ToaFile moved{std::move(file)};
+    EXPECT_EQ(moved.toas(), toas);
+    std::remove(path.c_str());
+}
+
+TEST(TestToaFile, testSolveFromMapping) {
+    auto receivers = deployment();
+    std::mt19937 rng{11};
+    std::uniform_real_distribution<double> area{-2.0, 8.0};
+
+    tdoapp::ToaMatrix toas(50, receivers.size());
+    for (Eigen::Index k = 0; k < toas.rows(); k++) {
+        Eigen::Vector2d emitter{area(rng), area(rng)};
+        for (size_t i = 0; i < receivers.size(); i++) {
+            toas(k, i) = (emitter - Eigen::Vector2d{receivers[i].x, receivers[i].y}).norm();
+        }
+    }
+
+    const auto path = tempPath("solve.tdoa");
+    tdoapp::writeToaFile(path, receivers, toas);
+    tdoapp::ToaFile file{path};
+    const tdoapp::TdoaGeometry geometry{file.receivers()};
+
+    tdoapp::ThreadPool pool{2};
+    auto results = tdoapp::locateBatch(geometry, file.toas(), tdoapp::Method::Linear, pool);
+    ASSERT_EQ(results.size(), 50u);
+    for (Eigen::Index k = 0; k < toas.rows(); k++) {
+        auto expected = geometry.initialGuess(toas.row(k).transpose());
+        EXPECT_EQ(results[k], expected);
+    }
+    std::remove(path.c_str());
+}
+
+TEST(TestToaFile, testRejectsInvalidFiles) {
+    const auto path = tempPath("invalid.tdoa");
+    {
+        std::ofstream ofs(path, std::ios::binary);
+        ofs << "{\"measurements\": []}";
+    }
+    EXPECT_FALSE(tdoapp::isToaFile(path));
+    EXPECT_THROW(tdoapp::ToaFile{path}, std::runtime_error);
+
+    // Valid header whose matrix has been cut short
+    auto receivers = deployment();
+    tdoapp::ToaMatrix toas = tdoapp::ToaMatrix::Zero(4, receivers.size());
+    tdoapp::writeToaFile(path, receivers, toas);
+    {
+        std::ifstream ifs(path, std::ios::binary);
+        std::string contents((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+        ofs.write(contents.data(), static_cast<std::streamsize>(contents.size() - 8));
+    }
+    EXPECT_TRUE(tdoapp::isToaFile(path));
+    EXPECT_THROW(tdoapp::ToaFile{path}, std::runtime_error);
+
+    EXPECT_THROW(tdoapp::ToaFile{tempPath("missing.tdoa")}, std::runtime_error);
+    std::remove(path.c_str());
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
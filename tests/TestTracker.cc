@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// Copyright 2023 Yago Lizarribar
+
+
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "../include/Receiver.hh"
+#include "../include/TdoaGeometry.hh"
+#include "../include/TdoaTracker.hh"
+
+namespace {
+    std::vector<tdoapp::Receiver> deployment() {
+        return {{0.0, 0.0}, {100.0, 0.0}, {0.0, 100.0}, {100.0, 100.0}, {50.0, -20.0}};
+    }
+
+    Eigen::VectorXd toasAt(const Eigen::Vector2d &emitter, std::mt19937 &rng, double sigma) {
+        std::normal_distribution<double> noise{0.0, sigma};
+        auto receivers = deployment();
+        Eigen::VectorXd toas(receivers.size());
+        for (size_t i = 0; i < receivers.size(); i++) {
+            toas[i] = (emitter - Eigen::Vector2d{receivers[i].x, receivers[i].y}).norm() + 30.0 + noise(rng);
+        }
+        return toas;
+    }
+}
+
+TEST(TestTracker, testSmoothTrackSkipsRefinement) {
+    std::mt19937 rng{21};
+    const double sigma = 0.5;
+    tdoapp::TrackerOptions options;
+    options.measurementSigma = sigma;
+    options.processNoise = 0.01;
+    tdoapp::TdoaTracker tracker{deployment(), options};
+    const tdoapp::TdoaGeometry geometry{deployment()};
+
+    const Eigen::Vector2d velocity{1.5, 0.8};
+    int refined = 0;
+    double trackError = 0.0, coldError = 0.0;
+    for (int k = 0; k < 60; k++) {
+        Eigen::Vector2d emitter = Eigen::Vector2d{20.0, 30.0} + k * velocity;
+        auto toas = toasAt(emitter, rng, sigma);
+        auto update = tracker.update(1.0, toas);
+        refined += update.refined;
+
+        // After the track has settled
+        if (k >= 10) {
+            trackError += (update.position - emitter).norm();
+            coldError += (geometry.nonlinearOptimization(toas, geometry.initialGuess(toas)) - emitter).norm();
+        }
+    }
+
+    EXPECT_TRUE(tracker.initialized());
+    EXPECT_LT(refined, 10);
+    EXPECT_LT(trackError, coldError);
+    EXPECT_NEAR(tracker.state()[2], velocity[0], 0.3);
+    EXPECT_NEAR(tracker.state()[3], velocity[1], 0.3);
+}
+
+TEST(TestTracker, testJumpTriggersRefinement) {
+    std::mt19937 rng{22};
+    tdoapp::TrackerOptions options;
+    options.measurementSigma = 0.1;
+    options.processNoise = 0.01;
+    tdoapp::TdoaTracker tracker{deployment(), options};
+
+    for (int k = 0; k < 10; k++) {
+        tracker.update(1.0, toasAt(Eigen::Vector2d{40.0 + k, 50.0}, rng, 0.1));
+    }
+
+    // The emitter shows up somewhere else
+    const Eigen::Vector2d jump{80.0, 10.0};
+    auto update = tracker.update(1.0, toasAt(jump, rng, 0.1));
+    EXPECT_TRUE(update.refined);
+    EXPECT_GT(update.nis, options.gate);
+    EXPECT_LT((update.position - jump).norm(), 1.0);
+}
+
+TEST(TestTracker, testInvalidInput) {
+    tdoapp::TdoaTracker tracker{deployment()};
+    std::mt19937 rng{23};
+    EXPECT_THROW(tracker.update(1.0, Eigen::VectorXd::Zero(3)), std::invalid_argument);
+
+    tracker.update(1.0, toasAt(Eigen::Vector2d{10.0, 10.0}, rng, 0.1));
+    EXPECT_THROW(tracker.update(-1.0, toasAt(Eigen::Vector2d{10.0, 10.0}, rng, 0.1)), std::invalid_argument);
+
+    tracker.reset();
+    EXPECT_FALSE(tracker.initialized());
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}